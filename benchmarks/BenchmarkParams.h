@@ -0,0 +1,61 @@
+#pragma once
+
+#include "ForwardRayTracing.h"
+
+#include <vector>
+
+// Inputs shared by the benchmarks: the source and observer of the sweep tutorial, rays spread over its parameter space
+// and its sweep grid.
+
+template <typename Real>
+ForwardRayTracingParams<Real> tutorial_params() {
+  ForwardRayTracingParams<Real> params;
+  const auto &pi = boost::math::constants::pi<Real>();
+  params.a = boost::lexical_cast<Real>("0.8");
+  params.r_s = 10;
+  params.theta_s = 85 * pi / 180;
+  params.r_o = 1000;
+  params.nu_r = Sign::NEGATIVE;
+  params.nu_theta = Sign::NEGATIVE;
+  params.d_sign = Sign::POSITIVE;
+  params.print_args_error = false;
+  return params;
+}
+
+// rays spread over both signs of nu_r, nu_theta and d and over log_abs_d in [-12, 2]
+template <typename Real>
+std::vector<ForwardRayTracingParams<Real>> ray_params(int rc_count, int d_count) {
+  ForwardRayTracingParams<Real> params = tutorial_params<Real>();
+  auto [rc_down, rc_up] = get_rc_range(params.a);
+  std::vector<ForwardRayTracingParams<Real>> result;
+  for (int sign = 0; sign < 4; ++sign) {
+    for (int i = 0; i < d_count; ++i) {
+      for (int j = 0; j < rc_count; ++j) {
+        params.nu_r = (sign & 1) ? Sign::POSITIVE : Sign::NEGATIVE;
+        params.nu_theta = (sign & 2) ? Sign::POSITIVE : Sign::NEGATIVE;
+        params.d_sign = (i & 1) ? Sign::POSITIVE : Sign::NEGATIVE;
+        params.rc = rc_down + (rc_up - rc_down) * (j + 1) / (rc_count + 2);
+        params.log_abs_d = Real(-12) + Real(14 * i) / d_count;
+        params.rc_d_to_lambda_q();
+        result.push_back(params);
+      }
+    }
+  }
+  return result;
+}
+
+// the axes of the tutorial sweep: rc_size nodes over the rc range less 0.05 at either end, lgd_size over [-10, 2]
+template <typename Real>
+void tutorial_grid(size_t rc_size, size_t lgd_size, std::vector<Real> &rc_list, std::vector<Real> &lgd_list) {
+  auto [rc_down, rc_up] = get_rc_range(tutorial_params<Real>().a);
+  rc_down += Real(0.05);
+  rc_up -= Real(0.05);
+  rc_list.resize(rc_size);
+  lgd_list.resize(lgd_size);
+  for (size_t i = 0; i < rc_size; i++) {
+    rc_list[i] = rc_down + (rc_up - rc_down) * i / (rc_size - 1);
+  }
+  for (size_t i = 0; i < lgd_size; i++) {
+    lgd_list[i] = Real(-10) + Real(12 * i) / (lgd_size - 1);
+  }
+}
@@ -0,0 +1,110 @@
+#include "BenchmarkParams.h"
+#include "ForwardRayTracing.h"
+#include "Utils.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <new>
+
+// Heap allocations per traced ray and per sweep cell for every precision. operator new catches std containers and
+// Boost temporaries, with ENABLE_MPFR the GMP memory functions are hooked too, which is where mpfr limbs come from.
+
+static std::atomic<size_t> new_count{0};
+static std::atomic<size_t> gmp_count{0};
+
+void *operator new(size_t size) {
+  new_count.fetch_add(1, std::memory_order_relaxed);
+  if (void *ptr = std::malloc(size == 0 ? 1 : size)) {
+    return ptr;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+
+void operator delete(void *ptr, size_t) noexcept { std::free(ptr); }
+
+#ifdef ENABLE_MPFR
+static void *gmp_allocate(size_t size) {
+  gmp_count.fetch_add(1, std::memory_order_relaxed);
+  return std::malloc(size);
+}
+
+static void *gmp_reallocate(void *ptr, size_t, size_t size) {
+  gmp_count.fetch_add(1, std::memory_order_relaxed);
+  return std::realloc(ptr, size);
+}
+
+static void gmp_free(void *ptr, size_t) { std::free(ptr); }
+#endif
+
+template <typename Real, typename Complex>
+void run(int rc_count, int d_count) {
+  auto params = ray_params<Real>(rc_count, d_count);
+  for (auto &p : params) {
+    p.calc_t_f = true;
+  }
+  auto ray = ForwardRayTracing<Real, Complex>::get_from_cache();
+  // warm up, the first ray allocates the kernels and Boost.Math constants
+  ray->calc_ray(params.front());
+
+  size_t new_begin = new_count.load();
+  size_t gmp_begin = gmp_count.load();
+  auto begin = std::chrono::steady_clock::now();
+  for (const auto &p : params) {
+    ray->calc_ray(p);
+  }
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+  double rays = static_cast<double>(params.size());
+  fmt::println("{:>24} sequential: {:10.1f} new/ray {:10.1f} gmp/ray {:10.2f} us/ray", TypeName<Real>::Get(),
+               (new_count.load() - new_begin) / rays, (gmp_count.load() - gmp_begin) / rays, seconds * 1e6 / rays);
+
+  new_begin = new_count.load();
+  gmp_begin = gmp_count.load();
+  begin = std::chrono::steady_clock::now();
+  auto results = ForwardRayTracingUtils<Real, Complex>::calc_ray_batch(params);
+  seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+  fmt::println("{:>24} batch:      {:10.1f} new/ray {:10.1f} gmp/ray {:10.2f} us/ray", TypeName<Real>::Get(),
+               (new_count.load() - new_begin) / rays, (gmp_count.load() - gmp_begin) / rays, seconds * 1e6 / rays);
+}
+
+template <typename Real, typename Complex>
+void run_sweep(int rc_count, int d_count) {
+  ForwardRayTracingParams<Real> params = tutorial_params<Real>();
+  const auto &pi = boost::math::constants::pi<Real>();
+  Real theta_o = 17 * pi / 180;
+  Real phi_o = pi / 4;
+  std::vector<Real> rc_list, lgd_list;
+  tutorial_grid<Real>(std::max(rc_count, 2), std::max(d_count, 2), rc_list, lgd_list);
+  // warm up, the first sweep fills the per-thread scratch of the pooled ray tracers
+  ForwardRayTracingUtils<Real, Complex>::sweep_rc_d(params, theta_o, phi_o, rc_list, lgd_list, 50, Real(1e-6));
+
+  size_t new_begin = new_count.load();
+  size_t gmp_begin = gmp_count.load();
+  auto begin = std::chrono::steady_clock::now();
+  auto result =
+      ForwardRayTracingUtils<Real, Complex>::sweep_rc_d(params, theta_o, phi_o, rc_list, lgd_list, 50, Real(1e-6));
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+  double cells = static_cast<double>(rc_list.size() * lgd_list.size());
+  fmt::println("{:>24} sweep:      {:10.1f} new/cell {:9.1f} gmp/cell {:9.2f} us/cell, {} roots",
+               TypeName<Real>::Get(), (new_count.load() - new_begin) / cells, (gmp_count.load() - gmp_begin) / cells,
+               seconds * 1e6 / cells, result.results.size());
+}
+
+int main(int argc, char *argv[]) {
+#ifdef ENABLE_MPFR
+  mp_set_memory_functions(gmp_allocate, gmp_reallocate, gmp_free);
+#endif
+  int rc_count = argc > 1 ? std::atoi(argv[1]) : 10;
+  int d_count = argc > 2 ? std::atoi(argv[2]) : 10;
+
+  run<double, std::complex<double>>(rc_count, d_count);
+  run<DoubleDouble, ComplexDoubleDouble>(rc_count, d_count);
+  run<Float128, Complex128>(rc_count, d_count);
+  run<Float256, Complex256>(rc_count, d_count);
+  run_sweep<double, std::complex<double>>(rc_count, d_count);
+  run_sweep<DoubleDouble, ComplexDoubleDouble>(rc_count, d_count);
+  run_sweep<Float128, Complex128>(rc_count, d_count);
+  run_sweep<Float256, Complex256>(rc_count, d_count);
+}
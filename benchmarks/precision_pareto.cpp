@@ -0,0 +1,441 @@
+#include "ForwardRayTracing.h"
+#include "Utils.h"
+#include "FloatExpansion.h"
+#include "ReferenceData.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+
+// Accuracy against cost of every precision type, binned by log_abs_d and radial case, and the cheapest precision that
+// meets a tolerance in every bin.
+//
+// The rays come either from a region of (rc, log_abs_d) around a fixed source and observer, traced in Float256 for the
+// reference, or from a directory with the pp/pm/mp/mm.csv files the tests read (a, r_s, theta_s, r_o, lambda, eta,
+// t_f, theta_f, phi_f), in which case the file values are the reference. The files are read by ReferenceData of the
+// tests, and a file ray is binned by log10 of its distance from the critical curve, which is its log_abs_d. Rays
+// outside [lgd-min, lgd-max) are left out. Every ray is traced single threaded in every precision and timed on its
+// own, so the cost of a bin does not depend on the rest of the region.
+//
+// usage: bench_precision_pareto [--csv DIR] [--a A] [--r_s R] [--theta_s DEG] [--r_o R] [--lgd-min X] [--lgd-max X]
+//                               [--lgd-bins N] [--rays-per-bin N] [--tol TOL] [--json FILE]
+
+struct ParetoOptions {
+  std::string csv_path;
+  std::string a = "0.8";
+  std::string r_s = "10";
+  std::string theta_s_deg = "85";
+  std::string r_o = "1000";
+  double lgd_min = -12;
+  double lgd_max = 2;
+  size_t lgd_bins = 7;
+  size_t rays_per_bin = 64;
+  double tol = 1e-10;
+  std::string json_path;
+};
+
+struct RayInput {
+  // region rays
+  double rc = 0;
+  double log_abs_d = 0;
+  Sign d_sign = Sign::POSITIVE;
+  // csv rays: a row of the reference data
+  const ReferenceRows *reference_rows = nullptr;
+  size_t reference_row = 0;
+
+  Sign nu_r;
+  Sign nu_theta;
+  size_t lgd_bin = 0;
+};
+
+// A reference value split into three doubles, hi + mid + lo. Subtracting the parts one by one in the precision under
+// test keeps about 150 bits of the reference without converting between multiprecision types.
+using SplitValue = std::array<double, 3>;
+
+template <typename Real>
+SplitValue split_value(const Real &x) {
+  return to_double_expansion<3>(x);
+}
+
+template <typename Real>
+double abs_error(const Real &value, const SplitValue &reference) {
+  Real error = value;
+  for (double part : reference) {
+    error -= part;
+  }
+  return std::abs(static_cast<double>(error));
+}
+
+struct Reference {
+  RayStatus status = RayStatus::NORMAL;
+  RadialCase radial_case = RadialCase::NONE;
+  // theta_f, phi_f, t_f
+  std::array<SplitValue, 3> values{};
+};
+
+constexpr std::array<const char *, 3> VALUE_NAMES = {"theta_f", "phi_f", "t_f"};
+constexpr std::array<const char *, RADIAL_CASE_COUNT> RADIAL_CASE_NAMES = {"NONE", "I2_PLUS", "I2_MINUS", "I3"};
+
+struct ErrorStats {
+  double median = 0;
+  double p90 = 0;
+  double p99 = 0;
+  double max = 0;
+
+  static ErrorStats from(std::vector<double> errors) {
+    ErrorStats stats;
+    if (errors.empty()) {
+      return stats;
+    }
+    std::sort(errors.begin(), errors.end());
+    auto quantile = [&](double q) { return errors[static_cast<size_t>(q * (errors.size() - 1))]; };
+    stats.median = quantile(0.5);
+    stats.p90 = quantile(0.9);
+    stats.p99 = quantile(0.99);
+    stats.max = errors.back();
+    return stats;
+  }
+};
+
+// one precision in one bin
+struct BinResult {
+  size_t rays = 0;
+  // rays that are NORMAL in the reference but not in this precision
+  size_t failures = 0;
+  double seconds = 0;
+  std::array<ErrorStats, 3> errors;
+
+  double rays_per_second() const { return seconds == 0 ? 0 : rays / seconds; }
+
+  double max_error() const { return std::max({errors[0].max, errors[1].max, errors[2].max}); }
+};
+
+using BinKey = std::pair<size_t, RadialCase>;
+
+struct PrecisionResult {
+  std::string name;
+  std::map<BinKey, BinResult> bins;
+};
+
+template <typename Real>
+ForwardRayTracingParams<Real> make_params(const RayInput &input, const ParetoOptions &options) {
+  ForwardRayTracingParams<Real> params;
+  params.nu_r = input.nu_r;
+  params.nu_theta = input.nu_theta;
+  params.calc_t_f = true;
+  params.print_args_error = false;
+  if (input.reference_rows) {
+    const ReferenceRows &rows = *input.reference_rows;
+    params.a = rows.get<Real>(input.reference_row, ReferenceField::A);
+    params.r_s = rows.get<Real>(input.reference_row, ReferenceField::R_S);
+    params.theta_s = rows.get<Real>(input.reference_row, ReferenceField::THETA_S);
+    params.r_o = rows.get<Real>(input.reference_row, ReferenceField::R_O);
+    params.lambda = rows.get<Real>(input.reference_row, ReferenceField::LAMBDA);
+    params.q = sqrt(rows.get<Real>(input.reference_row, ReferenceField::ETA));
+    return params;
+  }
+  const auto &pi = boost::math::constants::pi<Real>();
+  params.a = boost::lexical_cast<Real>(options.a);
+  params.r_s = boost::lexical_cast<Real>(options.r_s);
+  params.theta_s = boost::lexical_cast<Real>(options.theta_s_deg) * pi / 180;
+  params.r_o = boost::lexical_cast<Real>(options.r_o);
+  params.rc = input.rc;
+  params.log_abs_d = input.log_abs_d;
+  params.d_sign = input.d_sign;
+  params.rc_d_to_lambda_q();
+  return params;
+}
+
+std::vector<RayInput> region_rays(const ParetoOptions &options) {
+  ForwardRayTracingParams<double> params;
+  params.a = boost::lexical_cast<double>(options.a);
+  auto [rc_down, rc_up] = get_rc_range(params.a);
+  std::vector<RayInput> rays;
+  double bin_width = (options.lgd_max - options.lgd_min) / options.lgd_bins;
+  for (size_t bin = 0; bin < options.lgd_bins; ++bin) {
+    for (size_t k = 0; k < options.rays_per_bin; ++k) {
+      RayInput input;
+      // spread the rays of a bin over rc, log_abs_d and the eight sign combinations
+      input.nu_r = (k & 1) ? Sign::POSITIVE : Sign::NEGATIVE;
+      input.nu_theta = (k & 2) ? Sign::POSITIVE : Sign::NEGATIVE;
+      input.d_sign = (k & 4) ? Sign::POSITIVE : Sign::NEGATIVE;
+      double u = (k + 0.5) / options.rays_per_bin;
+      input.rc = rc_down + (rc_up - rc_down) * (0.02 + 0.96 * std::fmod(u * 7.31, 1.0));
+      input.log_abs_d = options.lgd_min + bin_width * (bin + u);
+      input.lgd_bin = bin;
+      rays.push_back(input);
+    }
+  }
+  return rays;
+}
+
+// log10 of the distance of (lambda, q) from the critical curve of spin a, the log_abs_d of the ray. d moves (lambda, q)
+// along the unit normal of the curve, so this is the distance to the closest point of the curve: the closest node of a
+// scan over rc, refined by a golden-section search between its neighbours.
+double critical_curve_log_abs_d(double a, double lambda, double q) {
+  KerrBackground<double> background(a);
+  auto distance = [&](double rc) {
+    CriticalCurvePoint<double> point(background, rc);
+    return std::hypot(lambda - point.lambda_c, q - point.qc);
+  };
+  constexpr size_t scan_size = 1024;
+  double step = (background.rc_up - background.rc_down) / scan_size;
+  size_t closest = 0;
+  for (size_t k = 1; k <= scan_size; ++k) {
+    if (distance(background.rc_down + step * k) < distance(background.rc_down + step * closest)) {
+      closest = k;
+    }
+  }
+  double low = background.rc_down + step * (closest == 0 ? 0 : closest - 1);
+  double high = background.rc_down + step * std::min(closest + 1, scan_size);
+  const double ratio = (std::sqrt(5.) - 1) / 2;
+  for (int iteration = 0; iteration < 60; ++iteration) {
+    double left = high - ratio * (high - low);
+    double right = low + ratio * (high - low);
+    if (distance(left) < distance(right)) {
+      high = right;
+    } else {
+      low = left;
+    }
+  }
+  return std::log10(distance((low + high) / 2));
+}
+
+std::vector<RayInput> csv_rays(const ReferenceData &reference_data, const ParetoOptions &options) {
+  std::vector<RayInput> rays;
+  size_t outside = 0;
+  double bin_width = (options.lgd_max - options.lgd_min) / options.lgd_bins;
+  for (Sign nu_r : {Sign::POSITIVE, Sign::NEGATIVE}) {
+    for (Sign nu_theta : {Sign::POSITIVE, Sign::NEGATIVE}) {
+      const ReferenceRows &rows = reference_data.rows(nu_r, nu_theta);
+      for (size_t row = 0; row < rows.size(); ++row) {
+        double log_abs_d = critical_curve_log_abs_d(rows.get<double>(row, ReferenceField::A),
+                                                    rows.get<double>(row, ReferenceField::LAMBDA),
+                                                    std::sqrt(rows.get<double>(row, ReferenceField::ETA)));
+        // NaN for a negative eta fails both comparisons
+        if (!(log_abs_d >= options.lgd_min && log_abs_d < options.lgd_max)) {
+          outside++;
+          continue;
+        }
+        RayInput input;
+        input.reference_rows = &rows;
+        input.reference_row = row;
+        input.nu_r = nu_r;
+        input.nu_theta = nu_theta;
+        input.log_abs_d = log_abs_d;
+        input.lgd_bin = std::min(static_cast<size_t>((log_abs_d - options.lgd_min) / bin_width), options.lgd_bins - 1);
+        rays.push_back(input);
+      }
+    }
+  }
+  if (outside > 0) {
+    fmt::println(stderr, "{} rays outside log_abs_d [{}, {}) left out", outside, options.lgd_min, options.lgd_max);
+  }
+  return rays;
+}
+
+// the reference in Float256, for csv rays only the radial case is traced and the values come from the file
+std::vector<Reference> compute_reference(const std::vector<RayInput> &rays, const ParetoOptions &options) {
+  std::vector<Reference> references(rays.size());
+  auto ray_tracing = ForwardRayTracing<Float256, Complex256>::get_from_cache();
+  for (size_t i = 0; i < rays.size(); ++i) {
+    auto params = make_params<Float256>(rays[i], options);
+    Reference &reference = references[i];
+    ray_tracing->prepare_ray(params);
+    reference.radial_case = ray_tracing->get_radial_case();
+    if (const ReferenceRows *rows = rays[i].reference_rows) {
+      size_t row = rays[i].reference_row;
+      reference.status = RayStatus::NORMAL;
+      reference.values = {split_value(rows->get<Float256>(row, ReferenceField::THETA_F)),
+                          split_value(rows->get<Float256>(row, ReferenceField::PHI_F)),
+                          split_value(rows->get<Float256>(row, ReferenceField::T_F))};
+      continue;
+    }
+    ray_tracing->finish_ray(reference.radial_case);
+    reference.status = ray_tracing->ray_status;
+    reference.values = {split_value(ray_tracing->theta_f), split_value(ray_tracing->phi_f),
+                        split_value(ray_tracing->t_f)};
+  }
+  return references;
+}
+
+template <typename Real, typename Complex>
+PrecisionResult evaluate(const std::vector<RayInput> &rays, const std::vector<Reference> &references,
+                         const ParetoOptions &options) {
+  PrecisionResult result;
+  result.name = TypeName<Real>::Get();
+  std::map<BinKey, std::array<std::vector<double>, 3>> errors;
+  auto ray_tracing = ForwardRayTracing<Real, Complex>::get_from_cache();
+
+  for (size_t i = 0; i < rays.size(); ++i) {
+    const Reference &reference = references[i];
+    if (reference.status != RayStatus::NORMAL) {
+      continue;
+    }
+    BinKey key{rays[i].lgd_bin, reference.radial_case};
+    BinResult &bin = result.bins[key];
+    auto params = make_params<Real>(rays[i], options);
+
+    auto begin = std::chrono::steady_clock::now();
+    ray_tracing->calc_ray(params);
+    bin.seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    bin.rays++;
+
+    if (ray_tracing->ray_status != RayStatus::NORMAL) {
+      bin.failures++;
+      continue;
+    }
+    const std::array<const Real *, 3> values = {&ray_tracing->theta_f, &ray_tracing->phi_f, &ray_tracing->t_f};
+    for (size_t k = 0; k < 3; ++k) {
+      // t_f is infinite for an observer at infinity
+      if (std::isfinite(reference.values[k][0])) {
+        errors[key][k].push_back(abs_error(*values[k], reference.values[k]));
+      }
+    }
+  }
+
+  for (auto &[key, bin] : result.bins) {
+    for (size_t k = 0; k < 3; ++k) {
+      bin.errors[k] = ErrorStats::from(std::move(errors[key][k]));
+    }
+  }
+  fmt::println(stderr, "evaluated {}", result.name);
+  return result;
+}
+
+// JSON has no NaN or infinity, an error or rate without a finite value is written as null
+std::string json_number(double value) { return std::isfinite(value) ? fmt::format("{}", value) : "null"; }
+
+std::string bin_label(size_t bin, const ParetoOptions &options) {
+  double width = (options.lgd_max - options.lgd_min) / options.lgd_bins;
+  return fmt::format("[{:.2f}, {:.2f})", options.lgd_min + width * bin, options.lgd_min + width * (bin + 1));
+}
+
+// the fastest precision without failures whose largest error is below the tolerance, the reference precision if
+// none qualifies
+std::string recommend(const std::vector<PrecisionResult> &precisions, const BinKey &key, double tol) {
+  std::string best = TypeName<Float256>::Get();
+  double best_speed = 0;
+  for (const auto &precision : precisions) {
+    auto it = precision.bins.find(key);
+    if (it == precision.bins.end()) {
+      continue;
+    }
+    const BinResult &bin = it->second;
+    if (bin.failures == 0 && bin.max_error() <= tol && bin.rays_per_second() > best_speed) {
+      best = precision.name;
+      best_speed = bin.rays_per_second();
+    }
+  }
+  return best;
+}
+
+void report(const std::vector<PrecisionResult> &precisions, const ParetoOptions &options) {
+  std::vector<BinKey> keys;
+  for (const auto &[key, bin] : precisions.front().bins) {
+    keys.push_back(key);
+  }
+
+  for (const auto &key : keys) {
+    fmt::println("log_abs_d {} {} ({} rays)", bin_label(key.first, options),
+                 RADIAL_CASE_NAMES[static_cast<size_t>(key.second)], precisions.front().bins.at(key).rays);
+    for (const auto &precision : precisions) {
+      const BinResult &bin = precision.bins.at(key);
+      fmt::println("  {:>16} {:12.1f} rays/s  failures {:4}  theta_f {:9.2e} / {:9.2e}  phi_f {:9.2e} / {:9.2e}  "
+                   "t_f {:9.2e} / {:9.2e}",
+                   precision.name, bin.rays_per_second(), bin.failures, bin.errors[0].median, bin.errors[0].max,
+                   bin.errors[1].median, bin.errors[1].max, bin.errors[2].median, bin.errors[2].max);
+    }
+    fmt::println("  recommended: {}", recommend(precisions, key, options.tol));
+  }
+
+  if (options.json_path.empty()) {
+    return;
+  }
+  std::ofstream file(options.json_path);
+  if (!file) {
+    throw std::runtime_error(fmt::format("cannot open {}", options.json_path));
+  }
+  file << fmt::format(R"({{"tol":{},"bins":[)", json_number(options.tol));
+  for (size_t i = 0; i < keys.size(); ++i) {
+    const BinKey &key = keys[i];
+    file << (i == 0 ? "\n" : ",\n");
+    file << fmt::format(R"({{"log_abs_d":"{}","radial_case":"{}","recommended":"{}","precisions":[)",
+                        bin_label(key.first, options), RADIAL_CASE_NAMES[static_cast<size_t>(key.second)],
+                        recommend(precisions, key, options.tol));
+    for (size_t j = 0; j < precisions.size(); ++j) {
+      const BinResult &bin = precisions[j].bins.at(key);
+      file << fmt::format(R"({}{{"name":"{}","rays":{},"failures":{},"rays_per_second":{})", j == 0 ? "" : ",",
+                          precisions[j].name, bin.rays, bin.failures, json_number(bin.rays_per_second()));
+      for (size_t k = 0; k < 3; ++k) {
+        const ErrorStats &stats = bin.errors[k];
+        file << fmt::format(R"(,"{}":{{"median":{},"p90":{},"p99":{},"max":{}}})", VALUE_NAMES[k],
+                            json_number(stats.median), json_number(stats.p90), json_number(stats.p99),
+                            json_number(stats.max));
+      }
+      file << "}";
+    }
+    file << "]}";
+  }
+  file << "\n]}\n";
+}
+
+int main(int argc, char *argv[]) {
+  ParetoOptions options;
+  for (int i = 1; i < argc; ++i) {
+    auto value = [&]() -> std::string {
+      if (i + 1 >= argc) {
+        fmt::println(stderr, "missing value for {}", argv[i]);
+        std::exit(1);
+      }
+      return argv[++i];
+    };
+    std::string arg = argv[i];
+    if (arg == "--csv") {
+      options.csv_path = value();
+    } else if (arg == "--a") {
+      options.a = value();
+    } else if (arg == "--r_s") {
+      options.r_s = value();
+    } else if (arg == "--theta_s") {
+      options.theta_s_deg = value();
+    } else if (arg == "--r_o") {
+      options.r_o = value();
+    } else if (arg == "--lgd-min") {
+      options.lgd_min = std::stod(value());
+    } else if (arg == "--lgd-max") {
+      options.lgd_max = std::stod(value());
+    } else if (arg == "--lgd-bins") {
+      options.lgd_bins = std::stoul(value());
+    } else if (arg == "--rays-per-bin") {
+      options.rays_per_bin = std::stoul(value());
+    } else if (arg == "--tol") {
+      options.tol = std::stod(value());
+    } else if (arg == "--json") {
+      options.json_path = value();
+    } else {
+      fmt::println(stderr, "unknown argument {}", arg);
+      return 1;
+    }
+  }
+
+  ReferenceData reference_data;
+  if (!options.csv_path.empty()) {
+    reference_data.load_csv_directory(options.csv_path);
+  }
+  auto rays = options.csv_path.empty() ? region_rays(options) : csv_rays(reference_data, options);
+  if (rays.empty()) {
+    fmt::println(stderr, "no rays");
+    return 1;
+  }
+  auto references = compute_reference(rays, options);
+
+  std::vector<PrecisionResult> precisions;
+  precisions.push_back(evaluate<double, std::complex<double>>(rays, references, options));
+  precisions.push_back(evaluate<long double, std::complex<long double>>(rays, references, options));
+  precisions.push_back(evaluate<DoubleDouble, ComplexDoubleDouble>(rays, references, options));
+  precisions.push_back(evaluate<Float128, Complex128>(rays, references, options));
+  report(precisions, options);
+}
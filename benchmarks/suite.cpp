@@ -0,0 +1,327 @@
+#include "BenchmarkParams.h"
+#include "ForwardRayTracing.h"
+#include "Utils.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+
+#include <oneapi/tbb/global_control.h>
+#include <oneapi/tbb/info.h>
+
+// Throughput of the kernels, batches, sweeps and root solves for every precision. Each benchmark is repeated until
+// --min-time has passed and reports seconds per item, so results of different grid sizes stay comparable. With
+// --json the results are written as machine-readable JSON for tracking regressions between releases.
+//
+// usage: bench_suite [--json FILE] [--filter SUBSTRING] [--min-time SECONDS] [--sweep-scale SCALE]
+
+struct BenchmarkResult {
+  std::string name;
+  std::string precision;
+  size_t iterations;
+  size_t items;
+  double seconds;
+  std::map<std::string, double> counters;
+};
+
+struct BenchmarkOptions {
+  std::string json_path;
+  std::string filter;
+  double min_time = 0.5;
+  // fraction of the 1000 x 2000 grid of the sweep tutorial
+  double sweep_scale = 0.1;
+};
+
+// JSON has no NaN or infinity, a counter without a finite value is written as null
+std::string json_number(double value) { return std::isfinite(value) ? fmt::format("{}", value) : "null"; }
+
+class BenchmarkSuite {
+private:
+  BenchmarkOptions options;
+  std::vector<BenchmarkResult> results;
+
+public:
+  explicit BenchmarkSuite(BenchmarkOptions options_) : options(std::move(options_)) {}
+
+  bool selected(const std::string &name, const std::string &precision) const {
+    return options.filter.empty() || (precision + "/" + name).find(options.filter) != std::string::npos;
+  }
+
+  const BenchmarkOptions &get_options() const { return options; }
+
+  // Repeat fn() until min_time has passed. fn returns the number of items it processed and may fill counters, which
+  // are averaged over the repetitions.
+  template <typename Fn>
+  void run(const std::string &name, const std::string &precision, Fn &&fn) {
+    if (!selected(name, precision)) {
+      return;
+    }
+    BenchmarkResult result{name, precision, 0, 0, 0, {}};
+    std::map<std::string, double> counters;
+    auto begin = std::chrono::steady_clock::now();
+    do {
+      result.items += fn(counters);
+      result.iterations++;
+      result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    } while (result.seconds < options.min_time);
+    for (auto &[key, value] : counters) {
+      result.counters[key] = value / result.iterations;
+    }
+    fmt::print("{:>16} {:<36} {:12.3f} us/item {:14.1f} items/s", precision, name,
+               result.items == 0 ? 0 : result.seconds * 1e6 / result.items,
+               result.seconds == 0 ? 0 : result.items / result.seconds);
+    for (auto &[key, value] : result.counters) {
+      fmt::print(" {}={:.4g}", key, value);
+    }
+    fmt::println("");
+    results.push_back(std::move(result));
+  }
+
+  void write_json() const {
+    if (options.json_path.empty()) {
+      return;
+    }
+    std::ofstream file(options.json_path);
+    if (!file) {
+      throw std::runtime_error(fmt::format("cannot open {}", options.json_path));
+    }
+#ifdef ENABLE_MPFR
+    constexpr bool mpfr = true;
+#else
+    constexpr bool mpfr = false;
+#endif
+    file << fmt::format(R"({{"context":{{"threads":{},"mpfr":{},"min_time":{},"sweep_scale":{}}},"benchmarks":[)",
+                        oneapi::tbb::info::default_concurrency(), mpfr, options.min_time, options.sweep_scale);
+    for (size_t i = 0; i < results.size(); i++) {
+      const auto &result = results[i];
+      file << (i == 0 ? "\n" : ",\n");
+      file << fmt::format(
+          R"({{"name":"{}","precision":"{}","iterations":{},"items":{},"seconds":{},)"
+          R"("seconds_per_item":{},"items_per_second":{})",
+          result.name, result.precision, result.iterations, result.items, json_number(result.seconds),
+          json_number(result.items == 0 ? 0 : result.seconds / result.items),
+          json_number(result.seconds == 0 ? 0 : result.items / result.seconds));
+      file << R"(,"counters":{)";
+      bool first = true;
+      for (auto &[key, value] : result.counters) {
+        file << fmt::format(R"({}"{}":{})", first ? "" : ",", key, json_number(value));
+        first = false;
+      }
+      file << "}}";
+    }
+    file << "\n]}\n";
+  }
+};
+
+// keeps the results of the primitive benchmarks alive
+static volatile double sink;
+
+template <typename Real>
+void bench_primitives(BenchmarkSuite &suite, const std::string &precision) {
+  // arguments in the ranges the radial and angular integrals use
+  std::vector<std::array<Real, 4>> args;
+  for (int i = 1; i <= 64; ++i) {
+    Real x = Real(i) / 64;
+    args.push_back({x, 1 - x / 2, 1 + x, Real(0.9) * x});
+  }
+  auto run = [&](const char *name, auto fn) {
+    suite.run(name, precision, [&](std::map<std::string, double> &) {
+      Real sum = 0;
+      for (const auto &arg : args) {
+        sum += fn(arg);
+      }
+      sink = static_cast<double>(sum);
+      return args.size();
+    });
+  };
+  run("ellint_rf", [](const auto &x) { return ellint_rf(x[0], x[1], x[2]); });
+  run("ellint_rd", [](const auto &x) { return ellint_rd(x[0], x[1], x[2]); });
+  run("ellint_rj", [](const auto &x) { return ellint_rj(x[0], x[1], x[2], x[3]); });
+  run("ellint_rc", [](const auto &x) { return ellint_rc(x[0], x[2]); });
+  run("ellint_1", [](const auto &x) { return ellint_1(x[3], x[1]); });
+  run("ellint_2", [](const auto &x) { return ellint_2(x[3], x[1]); });
+  run("ellint_3", [](const auto &x) { return ellint_3(x[3], x[0] / 2, x[1]); });
+  run("jacobi_sd", [](const auto &x) { return jacobi_sd(x[3], x[2]); });
+}
+
+template <typename Real, typename Complex>
+void bench_calc_ray(BenchmarkSuite &suite, const std::string &precision) {
+  auto params = ray_params<Real>(20, 20);
+  auto ray = ForwardRayTracing<Real, Complex>::get_from_cache();
+
+  // bin the rays by the radial integrals they need
+  std::array<std::vector<ForwardRayTracingParams<Real>>, RADIAL_CASE_COUNT> bins;
+  for (const auto &p : params) {
+    ray->prepare_ray(p);
+    bins[static_cast<size_t>(ray->get_radial_case())].push_back(p);
+  }
+
+  const std::array<const char *, RADIAL_CASE_COUNT> case_names = {"NONE", "I2_PLUS", "I2_MINUS", "I3"};
+  for (size_t k = 1; k < RADIAL_CASE_COUNT; ++k) {
+    for (bool calc_t_f : {false, true}) {
+      auto &bin = bins[k];
+      if (bin.empty()) {
+        continue;
+      }
+      for (auto &p : bin) {
+        p.calc_t_f = calc_t_f;
+      }
+      suite.run(fmt::format("calc_ray/{}/{}", case_names[k], calc_t_f ? "t_f" : "no_t_f"), precision,
+                [&](std::map<std::string, double> &counters) {
+                  size_t normal = 0;
+                  for (const auto &p : bin) {
+                    ray->calc_ray(p);
+                    normal += ray->ray_status == RayStatus::NORMAL;
+                  }
+                  counters["normal_fraction"] += static_cast<double>(normal) / bin.size();
+                  return bin.size();
+                });
+    }
+  }
+}
+
+template <typename Real, typename Complex>
+void bench_batch(BenchmarkSuite &suite, const std::string &precision) {
+  auto params = ray_params<Real>(20, 20);
+  int max_threads = oneapi::tbb::info::default_concurrency();
+  for (int threads = 1;; threads = std::min(threads * 2, max_threads)) {
+    oneapi::tbb::global_control control(oneapi::tbb::global_control::max_allowed_parallelism, threads);
+    suite.run(fmt::format("calc_ray_batch/threads:{}", threads), precision, [&](std::map<std::string, double> &) {
+      auto results = ForwardRayTracingUtils<Real, Complex>::calc_ray_batch(params);
+      return results.size();
+    });
+    if (threads == max_threads) {
+      break;
+    }
+  }
+}
+
+template <typename Real, typename Complex>
+void bench_sweep(BenchmarkSuite &suite, const std::string &precision) {
+  std::string name = fmt::format("sweep_rc_d/scale:{}", suite.get_options().sweep_scale);
+  if (!suite.selected(name, precision)) {
+    return;
+  }
+  ForwardRayTracingParams<Real> params = tutorial_params<Real>();
+  const auto &pi = boost::math::constants::pi<Real>();
+  size_t rc_size = std::max<size_t>(2, static_cast<size_t>(1000 * suite.get_options().sweep_scale));
+  size_t lgd_size = std::max<size_t>(2, static_cast<size_t>(2000 * suite.get_options().sweep_scale));
+  std::vector<Real> rc_list, lgd_list;
+  tutorial_grid<Real>(rc_size, lgd_size, rc_list, lgd_list);
+  Real theta_o = 17 * pi / 180;
+  Real phi_o = pi / 4;
+
+  suite.run(name, precision, [&](std::map<std::string, double> &counters) {
+    auto result = ForwardRayTracingUtils<Real, Complex>::sweep_rc_d(params, theta_o, phi_o, rc_list, lgd_list, 50,
+                                                                    Real(1e-6));
+    counters["images"] += result.results.size();
+    return rc_size * lgd_size;
+  });
+}
+
+using Images = std::vector<ForwardRayTracingResult<double, std::complex<double>>>;
+
+// Images of the sweep tutorial, found once in double and used as seeds for every precision.
+const Images &tutorial_images(double sweep_scale) {
+  static std::optional<Images> images;
+  if (images) {
+    return *images;
+  }
+  ForwardRayTracingParams<double> params = tutorial_params<double>();
+  const double pi = boost::math::constants::pi<double>();
+  size_t rc_size = std::max<size_t>(2, static_cast<size_t>(1000 * sweep_scale));
+  size_t lgd_size = std::max<size_t>(2, static_cast<size_t>(2000 * sweep_scale));
+  std::vector<double> rc_list, lgd_list;
+  tutorial_grid<double>(rc_size, lgd_size, rc_list, lgd_list);
+  images = ForwardRayTracingUtils<double, std::complex<double>>::sweep_rc_d(params, 17 * pi / 180, pi / 4, rc_list,
+                                                                            lgd_list, 50, 1e-6)
+               .results;
+  return *images;
+}
+
+template <typename Real, typename Complex>
+void bench_find_root(BenchmarkSuite &suite, const std::string &precision) {
+  if (!suite.selected("find_root_period", precision)) {
+    return;
+  }
+  const Images &images = tutorial_images(suite.get_options().sweep_scale);
+  if (images.empty()) {
+    return;
+  }
+  ForwardRayTracingParams<Real> params = tutorial_params<Real>();
+  const auto &pi = boost::math::constants::pi<Real>();
+  Real theta_o = 17 * pi / 180;
+  Real phi_o = pi / 4;
+  Real two_pi = boost::math::constants::two_pi<Real>();
+
+  suite.run("find_root_period", precision, [&](std::map<std::string, double> &counters) {
+    size_t iterations = 0;
+    size_t success = 0;
+    for (const auto &image : images) {
+      ForwardRayTracingParams<Real> seed(params);
+      // start a grid cell away from the image, as the sweep does
+      seed.rc = Real(image.rc) * Real(1.001);
+      seed.log_abs_d = Real(image.log_abs_d) + Real(0.01);
+      seed.d_sign = image.d_sign;
+      seed.rc_d_to_lambda_q();
+      int period;
+      if (!floor_to_int(Real(Real(image.phi_f) / two_pi), period)) {
+        // an image without a finite phi_f has no period to solve for, it counts as a failed solve
+        continue;
+      }
+      auto result = ForwardRayTracingUtils<Real, Complex>::find_root_period(seed, period, theta_o, phi_o, Real(1e-6));
+      iterations += result.iterations;
+      success += result.success;
+    }
+    counters["iterations"] += static_cast<double>(iterations) / images.size();
+    counters["success_fraction"] += static_cast<double>(success) / images.size();
+    return images.size();
+  });
+}
+
+template <typename Real, typename Complex>
+void bench_precision(BenchmarkSuite &suite) {
+  std::string precision = TypeName<Real>::Get();
+  bench_primitives<Real>(suite, precision);
+  bench_calc_ray<Real, Complex>(suite, precision);
+  bench_batch<Real, Complex>(suite, precision);
+  bench_sweep<Real, Complex>(suite, precision);
+  bench_find_root<Real, Complex>(suite, precision);
+}
+
+int main(int argc, char *argv[]) {
+  BenchmarkOptions options;
+  for (int i = 1; i < argc; ++i) {
+    auto value = [&]() -> std::string {
+      if (i + 1 >= argc) {
+        fmt::println(stderr, "missing value for {}", argv[i]);
+        std::exit(1);
+      }
+      return argv[++i];
+    };
+    if (std::strcmp(argv[i], "--json") == 0) {
+      options.json_path = value();
+    } else if (std::strcmp(argv[i], "--filter") == 0) {
+      options.filter = value();
+    } else if (std::strcmp(argv[i], "--min-time") == 0) {
+      options.min_time = std::stod(value());
+    } else if (std::strcmp(argv[i], "--sweep-scale") == 0) {
+      options.sweep_scale = std::stod(value());
+    } else {
+      fmt::println(stderr, "usage: {} [--json FILE] [--filter SUBSTRING] [--min-time SECONDS] [--sweep-scale SCALE]",
+                   argv[0]);
+      return 1;
+    }
+  }
+
+  BenchmarkSuite suite(options);
+  bench_precision<double, std::complex<double>>(suite);
+  bench_precision<long double, std::complex<long double>>(suite);
+  bench_precision<DoubleDouble, ComplexDoubleDouble>(suite);
+  bench_precision<Float128, Complex128>(suite);
+  bench_precision<Float256, Complex256>(suite);
+
+  suite.write_json();
+}
@@ -25,6 +25,7 @@
 #pragma once
 
 #include "Common.h"
+#include "Instrumentation.h"
 
 #include <iostream>
 #include <Eigen/Dense>
@@ -133,7 +134,7 @@ struct AlgoParams {
 	Real opt_fn_value;      // will be returned by the optimization algorithm
 	Vector opt_root_fn_values; // will be returned by the root-finding method
 
-	size_t opt_iter;
+	size_t opt_iter = 0;
 	Real opt_error_value;
 
 	// Broyden
@@ -185,6 +186,7 @@ private:
 
 		while (iter < max_iter) {
 			++iter;
+			INSTRUMENT_COUNT(line_search_backtracks);
 			lambda *= beta; // lambda_i = beta^i;
 
 			Fx_p = BMO_MATOPS_L2NORM(opt_objfn(x_vals + lambda * direc));
@@ -301,6 +303,7 @@ private:
 
 		while (rel_objfn_change > rel_objfn_change_tol && rel_sol_change > rel_sol_change_tol && iter < iter_max) {
 			++iter;
+			INSTRUMENT_COUNT(broyden_iterations);
 
 			// d = arma::solve(B,-objfn_vec);
 			d = -B * objfn_vec;
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "ForwardRayTracing.h"
+
+#include <array>
+#include <vector>
+
+// Two-phase execution of a tile of rays. Phase one prepares every ray (roots, turning points and early exits) and bins
+// it by its RadialCase. Phase two runs the bins one after another, so each radial kernel is fed a homogeneous stream of
+// rays instead of neighbouring cells alternating between IIntegral2, IIntegral3 and early exits.
+template <typename Real, typename Complex>
+class CaseBinnedExecutor
+{
+private:
+    // prepared rays are kept between tiles to reuse their storage
+    std::vector<PreparedRay<Real, Complex>> prepared;
+    std::vector<size_t> ray_index;
+    size_t prepared_count = 0;
+
+    std::array<std::vector<size_t>, RADIAL_CASE_COUNT> bins;
+
+public:
+    void clear()
+    {
+        prepared_count = 0;
+        for (auto &bin : bins)
+        {
+            bin.clear();
+        }
+    }
+
+    size_t bin_size(RadialCase radial_case) const
+    {
+        return bins[static_cast<size_t>(radial_case)].size();
+    }
+
+    // Phase one: prepare the ray with the given index. Rays that need radial integrals are queued and NORMAL is
+    // returned, otherwise the final status is returned and ray_tracing still holds the state of the ray.
+    RayStatus prepare(ForwardRayTracing<Real, Complex> &ray_tracing, size_t index,
+                      const ForwardRayTracingParams<Real> &params)
+    {
+        ray_tracing.prepare_ray(params);
+        RadialCase radial_case = ray_tracing.get_radial_case();
+        if (radial_case == RadialCase::NONE)
+        {
+            INSTRUMENT_RAY(ray_tracing.ray_status);
+            return ray_tracing.ray_status;
+        }
+
+        if (prepared_count == prepared.size())
+        {
+            prepared.emplace_back();
+            ray_index.emplace_back();
+        }
+        ray_tracing.save_prepared(prepared[prepared_count]);
+        ray_index[prepared_count] = index;
+        bins[static_cast<size_t>(radial_case)].push_back(prepared_count);
+        prepared_count++;
+        return RayStatus::NORMAL;
+    }
+
+    // Phase two: run the queued rays bin by bin, sink(index, ray_tracing) is called once the integrals of a ray are done
+    template <typename Sink>
+    void execute(ForwardRayTracing<Real, Complex> &ray_tracing, Sink &&sink)
+    {
+        for (RadialCase radial_case : {RadialCase::I2_PLUS, RadialCase::I2_MINUS, RadialCase::I3})
+        {
+            for (size_t k : bins[static_cast<size_t>(radial_case)])
+            {
+                ray_tracing.load_prepared(prepared[k]);
+                ray_tracing.finish_ray(radial_case);
+                INSTRUMENT_RAY(ray_tracing.ray_status);
+                sink(ray_index[k], ray_tracing);
+            }
+        }
+        clear();
+    }
+};
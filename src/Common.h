@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cerrno>
 #include <cmath>
 #include <array>
 #include <complex>
@@ -12,12 +13,14 @@
 #include <boost/math/special_functions/ellint_2.hpp>
 #include <boost/math/special_functions/ellint_3.hpp>
 #include <boost/math/special_functions/jacobi_elliptic.hpp>
+#include <boost/math/special_functions/ellint_rc.hpp>
+#include <boost/math/special_functions/ellint_rd.hpp>
+#include <boost/math/special_functions/ellint_rf.hpp>
+#include <boost/math/special_functions/ellint_rj.hpp>
+#include <boost/math/policies/policy.hpp>
 
-#include <boost/numeric/conversion/converter.hpp>
+#include "DoubleDouble.h"
 
-using boost::math::ellint_1;
-using boost::math::ellint_2;
-using boost::math::ellint_3;
 using boost::math::constants::half;
 using boost::math::constants::third;
 using boost::math::constants::sixth;
@@ -34,6 +37,8 @@ enum class RayStatus {
     UNKOWN_ERROR,
 };
 
+constexpr size_t RAY_STATUS_COUNT = static_cast<size_t>(RayStatus::UNKOWN_ERROR) + 1;
+
 constexpr const char *ray_status_to_str(RayStatus status) {
     switch (status) {
         case RayStatus::NORMAL:
@@ -71,8 +76,56 @@ constexpr auto GET_SIGN(E e) -> typename std::underlying_type<E>::type {
     return static_cast<typename std::underlying_type<E>::type>(e);
 }
 
+// floor x into an int without throwing, false if x is not finite or does not fit
 template<typename Real>
-using MY_FLOOR = boost::numeric::converter<int, Real, boost::numeric::conversion_traits<int, Real>, boost::numeric::def_overflow_handler, boost::numeric::Floor<Real>>;
+bool floor_to_int(const Real &x, int &result) {
+    using std::floor;
+    Real x_floor = floor(x);
+    if (!(x_floor >= std::numeric_limits<int>::min() && x_floor <= std::numeric_limits<int>::max())) {
+        return false;
+    }
+    result = static_cast<int>(x_floor);
+    return true;
+}
+
+// Special functions report errors through errno and return NaN or inf instead of throwing. The ray then ends up as
+// INTERNAL_ERROR, while an exception inside the tbb::parallel_for of a sweep would abort the whole sweep.
+//
+// A non-finite result does not catch every error: an evaluation error (a series that did not converge) returns its
+// last finite estimate and only sets errno to EDOM. The wrappers below clear errno before each call and count the calls
+// that leave EDOM in special_function_errors of the calling thread, which finish_ray compares around a ray. ERANGE is
+// not counted: libm also sets it on harmless underflow, and an overflow already returns inf.
+using SpecialFunctionPolicy = boost::math::policies::policy<
+        boost::math::policies::domain_error<boost::math::policies::errno_on_error>,
+        boost::math::policies::pole_error<boost::math::policies::errno_on_error>,
+        boost::math::policies::overflow_error<boost::math::policies::errno_on_error>,
+        boost::math::policies::evaluation_error<boost::math::policies::errno_on_error>,
+        boost::math::policies::rounding_error<boost::math::policies::errno_on_error>,
+        boost::math::policies::indeterminate_result_error<boost::math::policies::errno_on_error>>;
+
+inline thread_local size_t special_function_errors = 0;
+
+#define DEFINE_SPECIAL_FUNCTION(NAME)                                           \
+    template<typename... Args>                                                  \
+    inline auto NAME(const Args &...args) {                                     \
+        errno = 0;                                                              \
+        auto result = boost::math::NAME(args..., SpecialFunctionPolicy());      \
+        if (errno == EDOM) {                                                    \
+            special_function_errors++;                                          \
+        }                                                                       \
+        return result;                                                          \
+    }
+
+DEFINE_SPECIAL_FUNCTION(ellint_1)
+DEFINE_SPECIAL_FUNCTION(ellint_2)
+DEFINE_SPECIAL_FUNCTION(ellint_3)
+DEFINE_SPECIAL_FUNCTION(ellint_rc)
+DEFINE_SPECIAL_FUNCTION(ellint_rd)
+DEFINE_SPECIAL_FUNCTION(ellint_rf)
+DEFINE_SPECIAL_FUNCTION(ellint_rj)
+DEFINE_SPECIAL_FUNCTION(jacobi_sd)
+
+#undef DEFINE_SPECIAL_FUNCTION
 
 template<typename Real, typename Complex>
 class ForwardRayTracing;
@@ -80,6 +133,7 @@ class ForwardRayTracing;
 using std::real;
 using std::isinf;
 using std::isnan;
+using std::isfinite;
 
 template<typename T>
 struct TypeName {
@@ -102,6 +156,34 @@ struct TypeName<std::complex<double>> {
     }
 };
 
+template<>
+struct TypeName<long double> {
+    static std::string Get() {
+        return "long double";
+    }
+};
+
+template<>
+struct TypeName<std::complex<long double>> {
+    static std::string Get() {
+        return "complex<long double>";
+    }
+};
+
+template<>
+struct TypeName<DoubleDouble> {
+    static std::string Get() {
+        return "double_double";
+    }
+};
+
+template<>
+struct TypeName<ComplexDoubleDouble> {
+    static std::string Get() {
+        return "complex_double_double";
+    }
+};
+
 #ifdef FLOAT128_NATIVE
 #include <boost/multiprecision/float128.hpp>
 #include <boost/multiprecision/complex128.hpp>
@@ -154,14 +236,19 @@ struct TypeName<boost::multiprecision::cpp_complex_quad> {
 #include <boost/multiprecision/mpfr.hpp>
 #include <boost/multiprecision/mpc.hpp>
 
+#ifdef MPFR_STACK_ALLOCATION
+// limbs live inside the number itself, temporaries in the kernels and in Boost.Math never touch the heap
+using mpfr_float_oct = boost::multiprecision::number<boost::multiprecision::mpfr_float_backend<71, boost::multiprecision::allocate_stack>>;
+#else
 using mpfr_float_oct = boost::multiprecision::number<boost::multiprecision::mpfr_float_backend<71>>;
+#endif
 using mpc_complex_oct = boost::multiprecision::number<boost::multiprecision::mpc_complex_backend<71>>;
 
 using Float256 = mpfr_float_oct;
 using Complex256 = mpc_complex_oct;
 
 template <>
-struct TypeName<boost::multiprecision::number<boost::multiprecision::mpfr_float_backend<71>>>
+struct TypeName<mpfr_float_oct>
 {
     static std::string Get()
     {
@@ -204,6 +291,20 @@ struct TypeName<boost::multiprecision::cpp_complex_oct> {
 using boost::multiprecision::real;
 using boost::multiprecision::isinf;
 using boost::multiprecision::isnan;
+using boost::multiprecision::isfinite;
+
+// assign NaN in place, multiprecision numbers keep their storage instead of copying a freshly built NaN
+template<typename Real>
+inline void set_nan(Real &x) {
+    x = std::numeric_limits<Real>::quiet_NaN();
+}
+
+#ifdef ENABLE_MPFR
+template<unsigned digits10, boost::multiprecision::mpfr_allocation_type allocation, boost::multiprecision::expression_template_option et>
+inline void set_nan(boost::multiprecision::number<boost::multiprecision::mpfr_float_backend<digits10, allocation>, et> &x) {
+    mpfr_set_nan(x.backend().data());
+}
+#endif
 
 template<typename T>
 struct fmt::formatter<boost::multiprecision::number<T>> : fmt::ostream_formatter {
@@ -213,6 +314,10 @@ template<>
 struct fmt::formatter<Float128> : fmt::ostream_formatter {
 };
 
+template<>
+struct fmt::formatter<DoubleDouble> : fmt::ostream_formatter {
+};
+
 // helper return higher precision type
 
 template<typename T>
@@ -222,11 +327,21 @@ struct HigherPrecision {
 
 template<>
 struct HigherPrecision<double> {
-    using Type = Float128;
+    using Type = DoubleDouble;
 };
 
 template<>
 struct HigherPrecision<std::complex<double>> {
+    using Type = ComplexDoubleDouble;
+};
+
+template<>
+struct HigherPrecision<DoubleDouble> {
+    using Type = Float128;
+};
+
+template<>
+struct HigherPrecision<ComplexDoubleDouble> {
     using Type = Complex128;
 };
 
@@ -251,9 +366,9 @@ struct HigherPrecision<Complex128> {
 };
 
 #ifdef ENABLE_MPFR
-template <unsigned digits10>
-struct HigherPrecision<boost::multiprecision::number<boost::multiprecision::mpfr_float_backend<digits10>>> {
-    using Type = boost::multiprecision::number<boost::multiprecision::mpfr_float_backend<digits10 + 20>>;
+template <unsigned digits10, boost::multiprecision::mpfr_allocation_type allocation>
+struct HigherPrecision<boost::multiprecision::number<boost::multiprecision::mpfr_float_backend<digits10, allocation>>> {
+    using Type = boost::multiprecision::number<boost::multiprecision::mpfr_float_backend<digits10 + 20, allocation>>;
 };
 
 template <unsigned digits10>
@@ -261,8 +376,8 @@ struct HigherPrecision<boost::multiprecision::number<boost::multiprecision::mpc_
     using Type = boost::multiprecision::number<boost::multiprecision::mpc_complex_backend<digits10 + 20>>;
 };
 
-template <unsigned digits10>
-struct TypeName<boost::multiprecision::number<boost::multiprecision::mpfr_float_backend<digits10>>>
+template <unsigned digits10, boost::multiprecision::mpfr_allocation_type allocation>
+struct TypeName<boost::multiprecision::number<boost::multiprecision::mpfr_float_backend<digits10, allocation>>>
 {
     static std::string Get()
     {
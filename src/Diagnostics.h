@@ -0,0 +1,148 @@
+#pragma once
+
+#include "Common.h"
+
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+#include <oneapi/tbb/enumerable_thread_specific.h>
+
+// Where a diagnostic was raised. source and variable must be string literals, the counters keep the pointers and
+// order keys by content: comparing pointers into unrelated literals with < is unspecified.
+struct DiagnosticKey
+{
+    RayStatus status;
+    const char *source;
+    const char *variable;
+
+    bool operator<(const DiagnosticKey &other) const
+    {
+        return std::make_tuple(status, std::string_view(source), std::string_view(variable)) <
+               std::make_tuple(other.status, std::string_view(other.source), std::string_view(other.variable));
+    }
+};
+
+struct DiagnosticCount
+{
+    RayStatus status;
+    std::string source;
+    std::string variable;
+    size_t count;
+};
+
+struct DiagnosticRecord
+{
+    RayStatus status;
+    std::string source;
+    std::string variable;
+    std::string detail;
+};
+
+struct DiagnosticsReport
+{
+    std::vector<DiagnosticCount> counts;
+    std::vector<DiagnosticRecord> records;
+
+    size_t total(RayStatus status) const
+    {
+        size_t sum = 0;
+        for (const auto &count : counts)
+        {
+            if (count.status == status)
+            {
+                sum += count.count;
+            }
+        }
+        return sum;
+    }
+};
+
+// Counters of everything that used to be printed from the hot paths (out-of-range variables in the integrals,
+// argument errors, failed root solves). Every thread writes to its own counters without locking; collect() merges
+// them and should be called after a batch or a sweep has finished. A detail record is only formatted for sampled
+// occurrences, so the formatting cost is not paid for every failing ray.
+class Diagnostics
+{
+private:
+    struct Local
+    {
+        std::map<DiagnosticKey, size_t> counts;
+        std::vector<DiagnosticRecord> records;
+    };
+
+    inline static oneapi::tbb::enumerable_thread_specific<Local> locals;
+
+    // keep a detail record for every sample_every-th occurrence of a key, 0 disables sampling
+    inline static std::atomic<size_t> sample_every{0};
+    // maximum number of detail records per thread
+    inline static std::atomic<size_t> max_records{64};
+
+public:
+    static void set_sampling(size_t every, size_t max_records_per_thread)
+    {
+        sample_every.store(every, std::memory_order_relaxed);
+        max_records.store(max_records_per_thread, std::memory_order_relaxed);
+    }
+
+    // Count one occurrence. detail() returns a std::string and is only called if the occurrence is sampled, or always
+    // if force_record is set (still bounded by the number of records per thread).
+    template <typename DetailFn>
+    static void report(RayStatus status, const char *source, const char *variable, DetailFn &&detail,
+                       bool force_record = false)
+    {
+        Local &local = locals.local();
+        size_t count = ++local.counts[DiagnosticKey{status, source, variable}];
+
+        if (local.records.size() >= max_records.load(std::memory_order_relaxed))
+        {
+            return;
+        }
+        size_t every = sample_every.load(std::memory_order_relaxed);
+        if (force_record || (every > 0 && (count - 1) % every == 0))
+        {
+            local.records.push_back(DiagnosticRecord{status, source, variable, detail()});
+        }
+    }
+
+    static void report(RayStatus status, const char *source, const char *variable)
+    {
+        report(status, source, variable, []
+               { return std::string(); });
+    }
+
+    static DiagnosticsReport collect()
+    {
+        std::map<std::tuple<RayStatus, std::string, std::string>, size_t> merged;
+        DiagnosticsReport report;
+        for (const Local &local : locals)
+        {
+            for (const auto &[key, count] : local.counts)
+            {
+                merged[{key.status, key.source, key.variable}] += count;
+            }
+            report.records.insert(report.records.end(), local.records.begin(), local.records.end());
+        }
+        report.counts.reserve(merged.size());
+        for (const auto &[key, count] : merged)
+        {
+            report.counts.push_back(DiagnosticCount{std::get<0>(key), std::get<1>(key), std::get<2>(key), count});
+        }
+        std::sort(report.counts.begin(), report.counts.end(), [](const DiagnosticCount &x, const DiagnosticCount &y)
+                  { return x.count > y.count; });
+        return report;
+    }
+
+    static void clear()
+    {
+        for (Local &local : locals)
+        {
+            local.counts.clear();
+            local.records.clear();
+        }
+    }
+};
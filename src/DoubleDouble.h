@@ -0,0 +1,808 @@
+#pragma once
+
+#include <cmath>
+#include <limits>
+#include <string>
+#include <tuple>
+#include <type_traits>
+
+#include <boost/multiprecision/number.hpp>
+#include <boost/multiprecision/complex_adaptor.hpp>
+#include <boost/multiprecision/cpp_bin_float.hpp>
+
+// Double-double arithmetic: a value is the unevaluated sum hi + lo of two doubles with |lo| <= ulp(hi) / 2, which gives
+// 106 bits (about 32 digits) of precision using only hardware double operations. It sits between double and Float128,
+// whose software implementations are much slower.
+//
+// The type is a Boost.Multiprecision backend, so number<DoubleDoubleBackend> works everywhere Float128 does
+// (Boost.Math special functions, convert_to, str/assign, fmt) and complex_adaptor gives the complex type. The
+// algorithms follow the QD library by Hida, Li and Bailey.
+
+namespace double_double_detail
+{
+    // s + err = a + b exactly
+    inline void two_sum(double a, double b, double &s, double &err)
+    {
+        s = a + b;
+        double bb = s - a;
+        err = (a - (s - bb)) + (b - bb);
+    }
+
+    // s + err = a + b exactly, requires |a| >= |b|
+    inline void quick_two_sum(double a, double b, double &s, double &err)
+    {
+        s = a + b;
+        err = b - (s - a);
+    }
+
+    // p + err = a * b exactly
+    inline void two_prod(double a, double b, double &p, double &err)
+    {
+        p = a * b;
+        err = std::fma(a, b, -p);
+    }
+
+    // string conversions go through a binary float with more digits than double-double
+    using StringType = boost::multiprecision::cpp_bin_float_50;
+} // namespace double_double_detail
+
+struct DoubleDoubleBackend
+{
+    using signed_types = std::tuple<long long>;
+    using unsigned_types = std::tuple<unsigned long long>;
+    using float_types = std::tuple<double, long double>;
+    using exponent_type = int;
+
+    double hi = 0;
+    double lo = 0;
+
+    DoubleDoubleBackend() = default;
+
+    DoubleDoubleBackend(double hi_, double lo_) : hi(hi_), lo(lo_)
+    {
+    }
+
+    // implicit only from the built-in types, other floating point types (__float128) are not converted through double
+    template <typename T, typename = std::enable_if_t<std::is_integral_v<T> || std::is_same_v<T, float> ||
+                                                      std::is_same_v<T, double> || std::is_same_v<T, long double>>>
+    DoubleDoubleBackend(const T &value)
+    {
+        if constexpr (std::is_same_v<T, long double>)
+        {
+            *this = value;
+        }
+        else if constexpr (std::is_floating_point_v<T>)
+        {
+            *this = static_cast<double>(value);
+        }
+        else if constexpr (std::is_signed_v<T>)
+        {
+            *this = static_cast<long long>(value);
+        }
+        else
+        {
+            *this = static_cast<unsigned long long>(value);
+        }
+    }
+
+    DoubleDoubleBackend &operator=(double value)
+    {
+        hi = value;
+        lo = 0;
+        return *this;
+    }
+
+    DoubleDoubleBackend &operator=(long double value)
+    {
+        hi = static_cast<double>(value);
+        lo = std::isfinite(hi) ? static_cast<double>(value - hi) : 0;
+        return *this;
+    }
+
+    DoubleDoubleBackend &operator=(long long value)
+    {
+        hi = static_cast<double>(value);
+        // |hi| = 2^63 does not fit into long long, the remainder is then below the precision anyway
+        lo = std::abs(hi) < 0x1p63 ? static_cast<double>(value - static_cast<long long>(hi)) : 0;
+        return *this;
+    }
+
+    DoubleDoubleBackend &operator=(unsigned long long value)
+    {
+        hi = static_cast<double>(value);
+        lo = hi < 0x1p64 ? static_cast<double>(static_cast<long long>(value - static_cast<unsigned long long>(hi))) : 0;
+        return *this;
+    }
+
+    DoubleDoubleBackend &operator=(const char *s)
+    {
+        double_double_detail::StringType value(s);
+        hi = value.convert_to<double>();
+        lo = std::isfinite(hi) ? static_cast<double_double_detail::StringType>(value - hi).convert_to<double>() : 0;
+        return *this;
+    }
+
+    void swap(DoubleDoubleBackend &o) noexcept
+    {
+        std::swap(hi, o.hi);
+        std::swap(lo, o.lo);
+    }
+
+    std::string str(std::streamsize digits, std::ios_base::fmtflags f) const
+    {
+        double_double_detail::StringType value(hi);
+        value += lo;
+        return value.str(digits, f);
+    }
+
+    void negate()
+    {
+        hi = -hi;
+        lo = -lo;
+    }
+
+    int compare(const DoubleDoubleBackend &o) const
+    {
+        if (hi < o.hi || (hi == o.hi && lo < o.lo))
+        {
+            return -1;
+        }
+        if (hi > o.hi || (hi == o.hi && lo > o.lo))
+        {
+            return 1;
+        }
+        return 0;
+    }
+
+    template <typename T, typename = std::enable_if_t<std::is_arithmetic_v<T>>>
+    int compare(const T &value) const
+    {
+        DoubleDoubleBackend o;
+        o = value;
+        return compare(o);
+    }
+};
+
+namespace boost::multiprecision
+{
+    template <>
+    struct number_category<DoubleDoubleBackend> : public std::integral_constant<int, number_kind_floating_point>
+    {
+    };
+} // namespace boost::multiprecision
+
+using DoubleDouble = boost::multiprecision::number<DoubleDoubleBackend, boost::multiprecision::et_off>;
+using ComplexDoubleDouble =
+    boost::multiprecision::number<boost::multiprecision::complex_adaptor<DoubleDoubleBackend>,
+                                  boost::multiprecision::et_off>;
+
+namespace double_double_detail
+{
+    inline DoubleDoubleBackend add(const DoubleDoubleBackend &a, const DoubleDoubleBackend &b)
+    {
+        double s1, s2, t1, t2;
+        two_sum(a.hi, b.hi, s1, s2);
+        if (!std::isfinite(s1))
+        {
+            return {s1, 0};
+        }
+        two_sum(a.lo, b.lo, t1, t2);
+        s2 += t1;
+        quick_two_sum(s1, s2, s1, s2);
+        s2 += t2;
+        quick_two_sum(s1, s2, s1, s2);
+        return {s1, s2};
+    }
+
+    inline DoubleDoubleBackend add(const DoubleDoubleBackend &a, double b)
+    {
+        double s1, s2;
+        two_sum(a.hi, b, s1, s2);
+        if (!std::isfinite(s1))
+        {
+            return {s1, 0};
+        }
+        s2 += a.lo;
+        quick_two_sum(s1, s2, s1, s2);
+        return {s1, s2};
+    }
+
+    inline DoubleDoubleBackend mul(const DoubleDoubleBackend &a, const DoubleDoubleBackend &b)
+    {
+        double p1, p2;
+        two_prod(a.hi, b.hi, p1, p2);
+        if (!std::isfinite(p1))
+        {
+            return {p1, 0};
+        }
+        p2 += a.hi * b.lo + a.lo * b.hi;
+        quick_two_sum(p1, p2, p1, p2);
+        return {p1, p2};
+    }
+
+    inline DoubleDoubleBackend mul(const DoubleDoubleBackend &a, double b)
+    {
+        double p1, p2;
+        two_prod(a.hi, b, p1, p2);
+        if (!std::isfinite(p1))
+        {
+            return {p1, 0};
+        }
+        p2 += a.lo * b;
+        quick_two_sum(p1, p2, p1, p2);
+        return {p1, p2};
+    }
+
+    inline DoubleDoubleBackend div(const DoubleDoubleBackend &a, const DoubleDoubleBackend &b)
+    {
+        double q1 = a.hi / b.hi;
+        if (!std::isfinite(q1) || q1 == 0)
+        {
+            return {q1, 0};
+        }
+        DoubleDoubleBackend r = add(a, mul(b, -q1));
+        double q2 = r.hi / b.hi;
+        r = add(r, mul(b, -q2));
+        double q3 = r.hi / b.hi;
+        quick_two_sum(q1, q2, q1, q2);
+        return add(DoubleDoubleBackend{q1, q2}, q3);
+    }
+
+    inline DoubleDoubleBackend div(const DoubleDoubleBackend &a, double b)
+    {
+        double q1 = a.hi / b;
+        if (!std::isfinite(q1) || q1 == 0)
+        {
+            return {q1, 0};
+        }
+        double p1, p2, s, e;
+        two_prod(q1, b, p1, p2);
+        two_sum(a.hi, -p1, s, e);
+        e -= p2;
+        e += a.lo;
+        double q2 = (s + e) / b;
+        quick_two_sum(q1, q2, q1, q2);
+        return {q1, q2};
+    }
+
+    inline DoubleDoubleBackend sqr(const DoubleDoubleBackend &a)
+    {
+        return mul(a, a);
+    }
+
+    inline DoubleDoubleBackend ldexp(const DoubleDoubleBackend &a, int exp)
+    {
+        return {std::ldexp(a.hi, exp), std::ldexp(a.lo, exp)};
+    }
+
+    // constants
+    inline const DoubleDoubleBackend pi{3.141592653589793116e+00, 1.224646799147353207e-16};
+    inline const DoubleDoubleBackend two_pi{6.283185307179586232e+00, 2.449293598294706414e-16};
+    inline const DoubleDoubleBackend half_pi{1.570796326794896558e+00, 6.123233995736766036e-17};
+    inline const DoubleDoubleBackend ln2{6.931471805599452862e-01, 2.319046813846299558e-17};
+
+    // Taylor series of sin and cos, |a| <= pi / 4
+    inline void sin_cos_taylor(const DoubleDoubleBackend &a, DoubleDoubleBackend &sin_a, DoubleDoubleBackend &cos_a)
+    {
+        constexpr double threshold = 0x1p-108;
+        DoubleDoubleBackend a2 = sqr(a);
+        a2.negate();
+
+        DoubleDoubleBackend term = a;
+        sin_a = a;
+        for (int k = 2; std::abs(term.hi) > threshold * std::abs(sin_a.hi); k += 2)
+        {
+            term = div(mul(term, a2), static_cast<double>(k * (k + 1)));
+            sin_a = add(sin_a, term);
+        }
+
+        term = 1.0;
+        cos_a = 1.0;
+        for (int k = 1; std::abs(term.hi) > threshold; k += 2)
+        {
+            term = div(mul(term, a2), static_cast<double>(k * (k + 1)));
+            cos_a = add(cos_a, term);
+        }
+    }
+
+    // a = t + j * pi / 2 with |t| <= pi / 4, returns j mod 4
+    inline int reduce_half_pi(const DoubleDoubleBackend &a, DoubleDoubleBackend &t)
+    {
+        double z = std::nearbyint(a.hi / two_pi.hi);
+        DoubleDoubleBackend r = add(a, mul(two_pi, -z));
+        double j = std::nearbyint(r.hi / half_pi.hi);
+        t = add(r, mul(half_pi, -j));
+        return (static_cast<int>(j) % 4 + 4) % 4;
+    }
+
+    inline void sin_cos(const DoubleDoubleBackend &a, DoubleDoubleBackend &sin_a, DoubleDoubleBackend &cos_a)
+    {
+        if (!std::isfinite(a.hi))
+        {
+            sin_a = cos_a = std::numeric_limits<double>::quiet_NaN();
+            return;
+        }
+        DoubleDoubleBackend t, s, c;
+        int j = reduce_half_pi(a, t);
+        sin_cos_taylor(t, s, c);
+        switch (j)
+        {
+        case 0:
+            sin_a = s;
+            cos_a = c;
+            break;
+        case 1:
+            sin_a = c;
+            cos_a = s;
+            cos_a.negate();
+            break;
+        case 2:
+            sin_a = s;
+            sin_a.negate();
+            cos_a = c;
+            cos_a.negate();
+            break;
+        default:
+            sin_a = c;
+            sin_a.negate();
+            cos_a = s;
+            break;
+        }
+    }
+
+    inline DoubleDoubleBackend exp(const DoubleDoubleBackend &a)
+    {
+        if (a.hi > 709.79)
+        {
+            return DoubleDoubleBackend{std::numeric_limits<double>::infinity()};
+        }
+        if (a.hi < -745.2)
+        {
+            return DoubleDoubleBackend{0.0};
+        }
+        if (std::isnan(a.hi))
+        {
+            return a;
+        }
+
+        // exp(a) = 2^m * (1 + s)^512 with r = (a - m ln2) / 512 and s = exp(r) - 1
+        constexpr double threshold = 0x1p-108;
+        double m = std::floor(a.hi / ln2.hi + 0.5);
+        DoubleDoubleBackend r = ldexp(add(a, mul(ln2, -m)), -9);
+
+        DoubleDoubleBackend term = r;
+        DoubleDoubleBackend s = r;
+        for (int k = 2; std::abs(term.hi) > threshold * std::abs(s.hi); ++k)
+        {
+            term = div(mul(term, r), static_cast<double>(k));
+            s = add(s, term);
+        }
+
+        // (1 + s)^2 - 1 = 2 s + s^2
+        for (int i = 0; i < 9; ++i)
+        {
+            s = add(ldexp(s, 1), sqr(s));
+        }
+        return ldexp(add(s, 1.0), static_cast<int>(m));
+    }
+
+    inline DoubleDoubleBackend log(const DoubleDoubleBackend &a)
+    {
+        if (a.hi <= 0 || !std::isfinite(a.hi))
+        {
+            return DoubleDoubleBackend{a.hi == 0 ? -std::numeric_limits<double>::infinity() : std::log(a.hi)};
+        }
+        // one Newton step on exp(x) = a doubles the precision of the double estimate: x + a exp(-x) - 1
+        DoubleDoubleBackend x{std::log(a.hi)};
+        DoubleDoubleBackend minus_x = x;
+        minus_x.negate();
+        return add(add(x, mul(a, exp(minus_x))), -1.0);
+    }
+} // namespace double_double_detail
+
+// backend operations, found by ADL from boost::multiprecision::number
+
+inline void eval_add(DoubleDoubleBackend &result, const DoubleDoubleBackend &a)
+{
+    result = double_double_detail::add(result, a);
+}
+
+inline void eval_add(DoubleDoubleBackend &result, double a)
+{
+    result = double_double_detail::add(result, a);
+}
+
+inline void eval_add(DoubleDoubleBackend &result, const DoubleDoubleBackend &a, const DoubleDoubleBackend &b)
+{
+    result = double_double_detail::add(a, b);
+}
+
+inline void eval_add(DoubleDoubleBackend &result, const DoubleDoubleBackend &a, double b)
+{
+    result = double_double_detail::add(a, b);
+}
+
+inline void eval_subtract(DoubleDoubleBackend &result, const DoubleDoubleBackend &a)
+{
+    result = double_double_detail::add(result, DoubleDoubleBackend{-a.hi, -a.lo});
+}
+
+inline void eval_subtract(DoubleDoubleBackend &result, double a)
+{
+    result = double_double_detail::add(result, -a);
+}
+
+inline void eval_subtract(DoubleDoubleBackend &result, const DoubleDoubleBackend &a, const DoubleDoubleBackend &b)
+{
+    result = double_double_detail::add(a, DoubleDoubleBackend{-b.hi, -b.lo});
+}
+
+inline void eval_subtract(DoubleDoubleBackend &result, const DoubleDoubleBackend &a, double b)
+{
+    result = double_double_detail::add(a, -b);
+}
+
+inline void eval_multiply(DoubleDoubleBackend &result, const DoubleDoubleBackend &a)
+{
+    result = double_double_detail::mul(result, a);
+}
+
+inline void eval_multiply(DoubleDoubleBackend &result, double a)
+{
+    result = double_double_detail::mul(result, a);
+}
+
+inline void eval_multiply(DoubleDoubleBackend &result, const DoubleDoubleBackend &a, const DoubleDoubleBackend &b)
+{
+    result = double_double_detail::mul(a, b);
+}
+
+inline void eval_multiply(DoubleDoubleBackend &result, const DoubleDoubleBackend &a, double b)
+{
+    result = double_double_detail::mul(a, b);
+}
+
+inline void eval_divide(DoubleDoubleBackend &result, const DoubleDoubleBackend &a)
+{
+    result = double_double_detail::div(result, a);
+}
+
+inline void eval_divide(DoubleDoubleBackend &result, double a)
+{
+    result = double_double_detail::div(result, a);
+}
+
+inline void eval_divide(DoubleDoubleBackend &result, const DoubleDoubleBackend &a, const DoubleDoubleBackend &b)
+{
+    result = double_double_detail::div(a, b);
+}
+
+inline void eval_divide(DoubleDoubleBackend &result, const DoubleDoubleBackend &a, double b)
+{
+    result = double_double_detail::div(a, b);
+}
+
+inline bool eval_eq(const DoubleDoubleBackend &a, const DoubleDoubleBackend &b)
+{
+    return a.hi == b.hi && a.lo == b.lo;
+}
+
+inline bool eval_lt(const DoubleDoubleBackend &a, const DoubleDoubleBackend &b)
+{
+    return a.hi < b.hi || (a.hi == b.hi && a.lo < b.lo);
+}
+
+inline bool eval_gt(const DoubleDoubleBackend &a, const DoubleDoubleBackend &b)
+{
+    return a.hi > b.hi || (a.hi == b.hi && a.lo > b.lo);
+}
+
+inline bool eval_is_zero(const DoubleDoubleBackend &a)
+{
+    return a.hi == 0;
+}
+
+inline int eval_get_sign(const DoubleDoubleBackend &a)
+{
+    return a.hi > 0 ? 1 : (a.hi < 0 ? -1 : 0);
+}
+
+inline int eval_fpclassify(const DoubleDoubleBackend &a)
+{
+    return std::fpclassify(a.hi);
+}
+
+inline int eval_signbit(const DoubleDoubleBackend &a)
+{
+    return std::signbit(a.hi);
+}
+
+template <typename R>
+inline void eval_convert_to(R *result, const DoubleDoubleBackend &a)
+{
+    if constexpr (std::is_integral_v<R>)
+    {
+        // truncation of hi + lo, lo only matters when hi is an integer
+        if (std::trunc(a.hi) != a.hi)
+        {
+            *result = static_cast<R>(a.hi);
+        }
+        else
+        {
+            *result = static_cast<R>(a.hi) + static_cast<R>(a.hi >= 0 ? std::floor(a.lo) : std::ceil(a.lo));
+        }
+    }
+    else
+    {
+        *result = static_cast<R>(a.hi) + static_cast<R>(a.lo);
+    }
+}
+
+inline void eval_convert_to(double *result, const DoubleDoubleBackend &a)
+{
+    *result = a.hi;
+}
+
+inline void eval_frexp(DoubleDoubleBackend &result, const DoubleDoubleBackend &a, int *exp)
+{
+    result.hi = std::frexp(a.hi, exp);
+    result.lo = std::ldexp(a.lo, -*exp);
+    // hi = 0.5 with a negative lo is below 0.5
+    if (std::abs(result.hi) == 0.5 && result.lo != 0 && std::signbit(result.hi) != std::signbit(result.lo))
+    {
+        result.hi *= 2;
+        result.lo *= 2;
+        --*exp;
+    }
+}
+
+inline void eval_ldexp(DoubleDoubleBackend &result, const DoubleDoubleBackend &a, int exp)
+{
+    result = double_double_detail::ldexp(a, exp);
+}
+
+inline void eval_floor(DoubleDoubleBackend &result, const DoubleDoubleBackend &a)
+{
+    double hi = std::floor(a.hi);
+    double lo = 0;
+    if (hi == a.hi)
+    {
+        lo = std::floor(a.lo);
+        double_double_detail::quick_two_sum(hi, lo, hi, lo);
+    }
+    result = {hi, lo};
+}
+
+inline void eval_ceil(DoubleDoubleBackend &result, const DoubleDoubleBackend &a)
+{
+    double hi = std::ceil(a.hi);
+    double lo = 0;
+    if (hi == a.hi)
+    {
+        lo = std::ceil(a.lo);
+        double_double_detail::quick_two_sum(hi, lo, hi, lo);
+    }
+    result = {hi, lo};
+}
+
+inline void eval_trunc(DoubleDoubleBackend &result, const DoubleDoubleBackend &a)
+{
+    if (a.hi >= 0)
+    {
+        eval_floor(result, a);
+    }
+    else
+    {
+        eval_ceil(result, a);
+    }
+}
+
+inline void eval_abs(DoubleDoubleBackend &result, const DoubleDoubleBackend &a)
+{
+    result = a;
+    if (a.hi < 0)
+    {
+        result.negate();
+    }
+}
+
+inline void eval_fabs(DoubleDoubleBackend &result, const DoubleDoubleBackend &a)
+{
+    eval_abs(result, a);
+}
+
+inline void eval_sqrt(DoubleDoubleBackend &result, const DoubleDoubleBackend &a)
+{
+    if (a.hi <= 0 || !std::isfinite(a.hi))
+    {
+        result = std::sqrt(a.hi);
+        return;
+    }
+    // Karp's trick: sqrt(a) = a x + (a - (a x)^2) x / 2 with x = 1 / sqrt(a)
+    double x = 1 / std::sqrt(a.hi);
+    double ax = a.hi * x;
+    DoubleDoubleBackend ax2 = double_double_detail::sqr(DoubleDoubleBackend{ax});
+    double correction = double_double_detail::add(a, DoubleDoubleBackend{-ax2.hi, -ax2.lo}).hi * (x * 0.5);
+    result = double_double_detail::add(DoubleDoubleBackend{ax}, correction);
+}
+
+inline void eval_exp(DoubleDoubleBackend &result, const DoubleDoubleBackend &a)
+{
+    result = double_double_detail::exp(a);
+}
+
+inline void eval_log(DoubleDoubleBackend &result, const DoubleDoubleBackend &a)
+{
+    result = double_double_detail::log(a);
+}
+
+inline void eval_sin(DoubleDoubleBackend &result, const DoubleDoubleBackend &a)
+{
+    DoubleDoubleBackend cos_a;
+    double_double_detail::sin_cos(a, result, cos_a);
+}
+
+inline void eval_cos(DoubleDoubleBackend &result, const DoubleDoubleBackend &a)
+{
+    DoubleDoubleBackend sin_a;
+    double_double_detail::sin_cos(a, sin_a, result);
+}
+
+inline void eval_tan(DoubleDoubleBackend &result, const DoubleDoubleBackend &a)
+{
+    DoubleDoubleBackend sin_a, cos_a;
+    double_double_detail::sin_cos(a, sin_a, cos_a);
+    result = double_double_detail::div(sin_a, cos_a);
+}
+
+inline void eval_atan2(DoubleDoubleBackend &result, const DoubleDoubleBackend &y, const DoubleDoubleBackend &x)
+{
+    double z = std::atan2(y.hi, x.hi);
+    if ((x.hi == 0 && y.hi == 0) || !std::isfinite(x.hi) || !std::isfinite(y.hi))
+    {
+        result = z;
+        return;
+    }
+    // one Newton step on (cos z, sin z) = (x, y) / r, using the larger of the two components
+    DoubleDoubleBackend r;
+    eval_sqrt(r, double_double_detail::add(double_double_detail::sqr(x), double_double_detail::sqr(y)));
+    DoubleDoubleBackend xx = double_double_detail::div(x, r);
+    DoubleDoubleBackend yy = double_double_detail::div(y, r);
+
+    DoubleDoubleBackend sin_z, cos_z;
+    double_double_detail::sin_cos(DoubleDoubleBackend{z}, sin_z, cos_z);
+    if (std::abs(xx.hi) > std::abs(yy.hi))
+    {
+        sin_z.negate();
+        result = double_double_detail::add(DoubleDoubleBackend{z},
+                                           double_double_detail::div(double_double_detail::add(yy, sin_z), cos_z));
+    }
+    else
+    {
+        cos_z.negate();
+        DoubleDoubleBackend step = double_double_detail::div(double_double_detail::add(xx, cos_z), sin_z);
+        step.negate();
+        result = double_double_detail::add(DoubleDoubleBackend{z}, step);
+    }
+}
+
+inline void eval_atan(DoubleDoubleBackend &result, const DoubleDoubleBackend &a)
+{
+    eval_atan2(result, a, DoubleDoubleBackend{1.0});
+}
+
+namespace double_double_detail
+{
+    // sqrt(1 - a^2) = sqrt((1 - a) (1 + a)), NaN outside of [-1, 1]
+    inline DoubleDoubleBackend complement(const DoubleDoubleBackend &a)
+    {
+        DoubleDoubleBackend one_minus_a = add(DoubleDoubleBackend{-a.hi, -a.lo}, 1.0);
+        DoubleDoubleBackend one_plus_a = add(a, 1.0);
+        DoubleDoubleBackend result;
+        eval_sqrt(result, mul(one_minus_a, one_plus_a));
+        return result;
+    }
+} // namespace double_double_detail
+
+inline void eval_asin(DoubleDoubleBackend &result, const DoubleDoubleBackend &a)
+{
+    eval_atan2(result, a, double_double_detail::complement(a));
+}
+
+inline void eval_acos(DoubleDoubleBackend &result, const DoubleDoubleBackend &a)
+{
+    eval_atan2(result, double_double_detail::complement(a), a);
+}
+
+// The generic boost::multiprecision::cbrt goes through boost::math::cbrt, one Newton step from the double estimate is
+// enough here
+inline DoubleDouble cbrt(const DoubleDouble &a)
+{
+    const DoubleDoubleBackend &x = a.backend();
+    double y = std::cbrt(x.hi);
+    if (y == 0 || !std::isfinite(y))
+    {
+        return y;
+    }
+    // y + (x - y^3) / (3 y^2)
+    DoubleDoubleBackend y2 = double_double_detail::sqr(DoubleDoubleBackend{y});
+    DoubleDoubleBackend y3 = double_double_detail::mul(y2, y);
+    y3.negate();
+    DoubleDoubleBackend step = double_double_detail::div(double_double_detail::add(x, y3), double_double_detail::mul(y2, 3.0));
+    DoubleDouble result;
+    result.backend() = double_double_detail::add(step, y);
+    return result;
+}
+
+namespace std
+{
+    template <boost::multiprecision::expression_template_option ExpressionTemplates>
+    class numeric_limits<boost::multiprecision::number<DoubleDoubleBackend, ExpressionTemplates>>
+    {
+        using number_type = boost::multiprecision::number<DoubleDoubleBackend, ExpressionTemplates>;
+
+    public:
+        static constexpr bool is_specialized = true;
+        static number_type(min)() noexcept
+        {
+            // lo of the smallest normal value has to be normal as well
+            return number_type(0x1p-969);
+        }
+        static number_type(max)() noexcept
+        {
+            number_type result;
+            result.backend() = DoubleDoubleBackend{std::numeric_limits<double>::max(), 0x1.fffffffffffffp969};
+            return result;
+        }
+        static number_type lowest() noexcept
+        {
+            return -(max)();
+        }
+        static constexpr int digits = 106;
+        static constexpr int digits10 = 31;
+        static constexpr int max_digits10 = 33;
+        static constexpr bool is_signed = true;
+        static constexpr bool is_integer = false;
+        static constexpr bool is_exact = false;
+        static constexpr int radix = 2;
+        static number_type epsilon() noexcept
+        {
+            return number_type(0x1p-104);
+        }
+        static number_type round_error() noexcept
+        {
+            return number_type(0.5);
+        }
+        static constexpr int min_exponent = -968;
+        static constexpr int min_exponent10 = -291;
+        static constexpr int max_exponent = 1024;
+        static constexpr int max_exponent10 = 308;
+        static constexpr bool has_infinity = true;
+        static constexpr bool has_quiet_NaN = true;
+        static constexpr bool has_signaling_NaN = false;
+        static constexpr float_denorm_style has_denorm = denorm_absent;
+        static constexpr bool has_denorm_loss = false;
+        static number_type infinity() noexcept
+        {
+            return number_type(std::numeric_limits<double>::infinity());
+        }
+        static number_type quiet_NaN() noexcept
+        {
+            return number_type(std::numeric_limits<double>::quiet_NaN());
+        }
+        static number_type signaling_NaN() noexcept
+        {
+            return number_type(0);
+        }
+        static number_type denorm_min() noexcept
+        {
+            return (min)();
+        }
+        static constexpr bool is_iec559 = false;
+        static constexpr bool is_bounded = true;
+        static constexpr bool is_modulo = false;
+        static constexpr bool traps = false;
+        static constexpr bool tinyness_before = false;
+        static constexpr float_round_style round_style = round_to_nearest;
+    };
+} // namespace std
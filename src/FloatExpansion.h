@@ -0,0 +1,337 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cfloat>
+#include <climits>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#ifdef FLOAT128_NATIVE
+#include <boost/multiprecision/float128.hpp>
+#endif
+
+// A floating point value stored as an unevaluated sum of doubles, hi + mid + ... Every part is the rounded remainder
+// of the previous ones, so N parts hold about 53 * N bits as long as the exponents stay in the range of double. This
+// moves values between precisions without going through decimal strings or converting one multiprecision backend into
+// another: each precision rebuilds its value with its own additions.
+
+// number of parts that hold every bit of Real
+template <typename Real>
+constexpr size_t double_expansion_size = (std::numeric_limits<Real>::digits + 52) / 53;
+
+template <size_t N, typename Real>
+std::array<double, N> to_double_expansion(Real x)
+{
+    std::array<double, N> parts{};
+    for (double &part : parts)
+    {
+        part = static_cast<double>(x);
+        if (!std::isfinite(part) || part == 0)
+        {
+            break;
+        }
+        x -= part;
+    }
+    return parts;
+}
+
+template <typename Real, size_t N>
+Real from_double_expansion(const double *parts)
+{
+    if constexpr (std::is_same_v<Real, double>)
+    {
+        return parts[0];
+    }
+    else
+    {
+        // zeros, infinities and NaN have no lower parts, and summing would lose the sign of -0
+        if (parts[0] == 0 || !std::isfinite(parts[0]))
+        {
+            return Real(parts[0]);
+        }
+        // smallest first, so the small parts are not lost against hi
+        Real x = parts[N - 1];
+        for (size_t i = N - 1; i > 0; i--)
+        {
+            x += parts[i - 1];
+        }
+        return x;
+    }
+}
+
+template <typename Real, size_t N>
+Real from_double_expansion(const std::array<double, N> &parts)
+{
+    return from_double_expansion<Real, N>(parts.data());
+}
+
+// The exact value of a finite expansion as an integer times a power of two, (-1)^negative * magnitude * 2^exponent,
+// with the magnitude in little-endian 64-bit limbs and odd unless it is zero. This is the (man, exp) pair of mpmath.
+struct BinaryFraction
+{
+    bool negative = false;
+    std::vector<uint64_t> magnitude;
+    long exponent = 0;
+};
+
+namespace float_expansion_detail
+{
+inline void trim(std::vector<uint64_t> &limbs)
+{
+    while (!limbs.empty() && limbs.back() == 0)
+    {
+        limbs.pop_back();
+    }
+}
+
+inline size_t bit_length(const std::vector<uint64_t> &limbs)
+{
+    if (limbs.empty())
+    {
+        return 0;
+    }
+    size_t bits = 64 * limbs.size();
+    for (uint64_t top = limbs.back(); (top >> 63) == 0; top <<= 1)
+    {
+        bits--;
+    }
+    return bits;
+}
+
+inline bool bit(const std::vector<uint64_t> &limbs, size_t index)
+{
+    return index / 64 < limbs.size() && ((limbs[index / 64] >> (index % 64)) & 1);
+}
+
+// value * 2^shift
+inline std::vector<uint64_t> shifted(uint64_t value, size_t shift)
+{
+    std::vector<uint64_t> limbs(shift / 64 + 2);
+    limbs[shift / 64] = value << (shift % 64);
+    limbs[shift / 64 + 1] = shift % 64 == 0 ? 0 : value >> (64 - shift % 64);
+    trim(limbs);
+    return limbs;
+}
+
+// the 64 bits of limbs from bit shift on
+inline uint64_t bits_from(const std::vector<uint64_t> &limbs, size_t shift)
+{
+    size_t index = shift / 64;
+    if (index >= limbs.size())
+    {
+        return 0;
+    }
+    uint64_t value = limbs[index] >> (shift % 64);
+    if (shift % 64 != 0 && index + 1 < limbs.size())
+    {
+        value |= limbs[index + 1] << (64 - shift % 64);
+    }
+    return value;
+}
+
+inline int compare(const std::vector<uint64_t> &a, const std::vector<uint64_t> &b)
+{
+    if (a.size() != b.size())
+    {
+        return a.size() < b.size() ? -1 : 1;
+    }
+    for (size_t i = a.size(); i > 0; i--)
+    {
+        if (a[i - 1] != b[i - 1])
+        {
+            return a[i - 1] < b[i - 1] ? -1 : 1;
+        }
+    }
+    return 0;
+}
+
+inline void add(std::vector<uint64_t> &a, const std::vector<uint64_t> &b)
+{
+    a.resize(std::max(a.size(), b.size()) + 1);
+    uint64_t carry = 0;
+    for (size_t i = 0; i < a.size(); i++)
+    {
+        uint64_t term = i < b.size() ? b[i] : 0;
+        uint64_t sum = a[i] + term;
+        uint64_t next_carry = sum < term;
+        a[i] = sum + carry;
+        carry = next_carry | (a[i] < carry);
+    }
+    trim(a);
+}
+
+// a -= b, a must not be less than b
+inline void subtract(std::vector<uint64_t> &a, const std::vector<uint64_t> &b)
+{
+    uint64_t borrow = 0;
+    for (size_t i = 0; i < a.size(); i++)
+    {
+        uint64_t term = i < b.size() ? b[i] : 0;
+        uint64_t difference = a[i] - term;
+        uint64_t next_borrow = a[i] < term;
+        next_borrow |= difference < borrow;
+        a[i] = difference - borrow;
+        borrow = next_borrow;
+    }
+    trim(a);
+}
+} // namespace float_expansion_detail
+
+// Exact fraction of an expansion with a finite, nonzero hi part
+template <size_t N>
+BinaryFraction to_binary_fraction(const std::array<double, N> &parts)
+{
+    using namespace float_expansion_detail;
+    BinaryFraction fraction;
+    fraction.negative = parts[0] < 0;
+    // every part is an odd integer of at most 53 bits times a power of two
+    std::array<uint64_t, N> mantissas{};
+    std::array<int, N> exponents{};
+    size_t count = 0;
+    int exponent_min = INT_MAX;
+    for (; count < N && parts[count] != 0; count++)
+    {
+        int exponent;
+        auto mantissa = static_cast<uint64_t>(std::ldexp(std::fabs(std::frexp(parts[count], &exponent)), 53));
+        exponent -= 53;
+        while ((mantissa & 1) == 0)
+        {
+            mantissa >>= 1;
+            exponent++;
+        }
+        mantissas[count] = mantissa;
+        exponents[count] = exponent;
+        exponent_min = std::min(exponent_min, exponent);
+    }
+    // the parts do not overlap, so the lowest one keeps the sum odd. Parts of the sign of hi are added first, which
+    // keeps the magnitude from going below zero.
+    for (bool same_sign : {true, false})
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            if (((parts[i] < 0) == fraction.negative) == same_sign)
+            {
+                auto term = shifted(mantissas[i], static_cast<size_t>(exponents[i] - exponent_min));
+                same_sign ? add(fraction.magnitude, term) : subtract(fraction.magnitude, term);
+            }
+        }
+    }
+    fraction.exponent = count == 0 ? 0 : exponent_min;
+    return fraction;
+}
+
+// Nearest doubles of a fraction from the top, as to_double_expansion splits a value. Values beyond the range of double
+// become inf or zero.
+template <size_t N>
+std::array<double, N> split_binary_fraction(const BinaryFraction &fraction)
+{
+    using namespace float_expansion_detail;
+    std::array<double, N> parts{};
+    auto magnitude = fraction.magnitude;
+    bool negative = fraction.negative;
+    auto total_bits = static_cast<long>(bit_length(magnitude));
+    if (total_bits == 0 || fraction.exponent < DBL_MIN_EXP - DBL_MANT_DIG - total_bits)
+    {
+        parts[0] = negative ? -0.0 : 0.0;
+        return parts;
+    }
+    if (fraction.exponent > DBL_MAX_EXP - total_bits)
+    {
+        parts[0] = negative ? -std::numeric_limits<double>::infinity() : std::numeric_limits<double>::infinity();
+        return parts;
+    }
+    for (double &part : parts)
+    {
+        auto bits = static_cast<long>(bit_length(magnitude));
+        // a subnormal part holds fewer bits, its lowest one is at most 2^-1074
+        long shift = std::max<long>(bits > 53 ? bits - 53 : 0, DBL_MIN_EXP - DBL_MANT_DIG - fraction.exponent);
+        if (bits == 0 || shift > bits)
+        {
+            break;
+        }
+        uint64_t top = bits_from(magnitude, shift) + (shift > 0 && bit(magnitude, shift - 1));
+        if (top == 0)
+        {
+            break;
+        }
+        part = std::ldexp(static_cast<double>(top), static_cast<int>(fraction.exponent + shift));
+        if (negative)
+        {
+            part = -part;
+        }
+        // the remainder changes sign when top was rounded up
+        auto rounded = shifted(top, shift);
+        if (compare(magnitude, rounded) >= 0)
+        {
+            subtract(magnitude, rounded);
+        }
+        else
+        {
+            subtract(rounded, magnitude);
+            magnitude = std::move(rounded);
+            negative = !negative;
+        }
+    }
+    return parts;
+}
+
+template <typename Real>
+BinaryFraction to_binary_fraction(const Real &x)
+{
+    return to_binary_fraction(to_double_expansion<double_expansion_size<Real>>(x));
+}
+
+// a fraction rounded to Real, split into one part more than Real holds so that longer fractions round close to nearest
+template <typename Real>
+Real from_binary_fraction(const BinaryFraction &fraction)
+{
+    constexpr size_t N = double_expansion_size<Real> + 1;
+    return from_double_expansion<Real, N>(split_binary_fraction<N>(fraction));
+}
+
+// magnitudes as little-endian bytes, the form of int.to_bytes(length, "little") and int.from_bytes(bytes, "little")
+inline std::vector<uint64_t> magnitude_from_bytes(const unsigned char *bytes, size_t size)
+{
+    std::vector<uint64_t> limbs((size + 7) / 8);
+    for (size_t i = 0; i < size; i++)
+    {
+        limbs[i / 8] |= static_cast<uint64_t>(bytes[i]) << (8 * (i % 8));
+    }
+    float_expansion_detail::trim(limbs);
+    return limbs;
+}
+
+inline std::string magnitude_to_bytes(const std::vector<uint64_t> &limbs)
+{
+    std::string bytes(8 * limbs.size(), '\0');
+    for (size_t i = 0; i < bytes.size(); i++)
+    {
+        bytes[i] = static_cast<char>((limbs[i / 8] >> (8 * (i % 8))) & 0xff);
+    }
+    return bytes;
+}
+
+#ifdef FLOAT128_NATIVE
+// IEEE binary128 values as raw bytes, the layout of __float128 and numpy.dtype("V16")
+constexpr size_t BINARY128_SIZE = sizeof(__float128);
+
+inline void to_binary128(const boost::multiprecision::float128 &x, char *bytes)
+{
+    __float128 value = x.backend().value();
+    std::memcpy(bytes, &value, sizeof(value));
+}
+
+inline boost::multiprecision::float128 from_binary128(const char *bytes)
+{
+    __float128 value;
+    std::memcpy(&value, bytes, sizeof(value));
+    return value;
+}
+#endif
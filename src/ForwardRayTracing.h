@@ -5,21 +5,51 @@
 #include "IIntegral3.h"
 #include "GIntegral.h"
 #include "ObjectPool.h"
+#include "KerrBackground.h"
+#include "Instrumentation.h"
 
 #define CHECK_STATUS                     \
     if (ray_status != RayStatus::NORMAL) \
         return;
 
 template <typename Real>
-std::pair<Real, Real> get_rc_range(const Real &a)
+Real signed_d(Sign d_sign, const Real &log_abs_d)
 {
-    Real r_up = 2 * cos(acos(a) * third<Real>());
-    Real r_down = 2 * cos(acos(-a) * third<Real>());
-    r_up = MY_SQUARE(r_up);
-    r_down = MY_SQUARE(r_down);
-    return {r_down, r_up};
+    return GET_SIGN(d_sign) * pow(static_cast<Real>(10), log_abs_d);
 }
 
+// Point of the critical curve whose spherical photon orbit has radius rc, together with the direction in which d moves
+// (lambda, q) away from it: lambda = lambda_c + d * lambda_dir, q = qc + d * q_dir.
+template <typename Real>
+struct CriticalCurvePoint
+{
+    Real lambda_c, qc;
+    Real lambda_dir, q_dir;
+
+    CriticalCurvePoint() = default;
+
+    CriticalCurvePoint(const KerrBackground<Real> &bg, const Real &rc)
+    {
+        const Real &a = bg.a;
+        lambda_c = a + (rc * (2 * bg.a2 + (-3 + rc) * rc)) / (a * (1 - rc));
+        Real eta_c = -((MY_CUBE(rc) * (-4 * bg.a2 + MY_SQUARE(-3 + rc) * rc)) /
+                       (bg.a2 * MY_SQUARE(-1 + rc)));
+        qc = sqrt(eta_c);
+
+        Real coeff = sqrt(
+            MY_SQUARE(-3 + rc) / (bg.a2 * MY_SQUARE(-1 + rc)) + eta_c / pow(rc, 4));
+
+        lambda_dir = (3 - rc) / (a * (-1 + rc)) / coeff;
+        q_dir = qc / MY_SQUARE(rc) / coeff;
+    }
+
+    void to_lambda_q(const Real &d, Real &lambda, Real &q) const
+    {
+        lambda = lambda_c + d * lambda_dir;
+        q = qc + d * q_dir;
+    }
+};
+
 template <typename Real>
 struct ForwardRayTracingParams
 {
@@ -38,6 +68,9 @@ struct ForwardRayTracingParams
     bool calc_t_f = false;
     bool print_args_error = true;
 
+    // spin-only constants, shared by copies of the params and rebuilt lazily when a changes
+    std::shared_ptr<const KerrBackground<Real>> background;
+
     ForwardRayTracingParams() = default;
 
     ForwardRayTracingParams(const ForwardRayTracingParams &params)
@@ -55,6 +88,16 @@ struct ForwardRayTracingParams
         q = params.q;
         calc_t_f = params.calc_t_f;
         print_args_error = params.print_args_error;
+        background = params.background;
+    }
+
+    const KerrBackground<Real> &get_background()
+    {
+        if (!background || !background->matches(a))
+        {
+            background = KerrBackground<Real>::create(a);
+        }
+        return *background;
     }
 
     template <typename TH>
@@ -78,41 +121,35 @@ struct ForwardRayTracingParams
 
     bool rc_d_to_lambda_q()
     {
-        auto [r_down, r_up] = get_rc_range(a);
+        const KerrBackground<Real> &bg = get_background();
 
-        if (rc < r_down || rc > r_up)
+        if (rc < bg.rc_down || rc > bg.rc_up)
         {
-            if (print_args_error)
-                fmt::println("rc out of range: rc = {}, r_down: {}, r_up: {}", rc, r_down, r_up);
+            // print_args_error keeps a detail record for every argument error instead of a sampled one
+            Diagnostics::report(RayStatus::ARGUMENT_ERROR, "ForwardRayTracingParams", "rc", [&]
+                                { return fmt::format("rc out of range: rc = {}, r_down: {}, r_up: {}", rc, bg.rc_down, bg.rc_up); },
+                                print_args_error);
             lambda = std::numeric_limits<Real>::quiet_NaN();
             q = std::numeric_limits<Real>::quiet_NaN();
             return false;
         }
 
-        Real lambda_c = a + (rc * (2 * MY_SQUARE(a) + (-3 + rc) * rc)) / (a * (1 - rc));
-        Real eta_c = -((MY_CUBE(rc) * (-4 * MY_SQUARE(a) + MY_SQUARE(-3 + rc) * rc)) /
-                       (MY_SQUARE(a) * MY_SQUARE(-1 + rc)));
-        Real qc = sqrt(eta_c);
-
-        Real coeff = sqrt(
-            MY_SQUARE(-3 + rc) / (MY_SQUARE(a) * MY_SQUARE(-1 + rc)) + eta_c / pow(rc, 4));
-
-        Real d = GET_SIGN(d_sign) * pow(static_cast<Real>(10), log_abs_d);
-        lambda = lambda_c + d * ((3 - rc) / (a * (-1 + rc)) / coeff);
-        q = qc + d * (sqrt(eta_c) / MY_SQUARE(rc) / coeff);
+        CriticalCurvePoint<Real> point(bg, rc);
+        point.to_lambda_q(signed_d(d_sign, log_abs_d), lambda, q);
 
         if (d_sign == Sign::NEGATIVE && q < 0)
         {
-            if (print_args_error)
-                fmt::println("q out of range, which should be positive when d_sign is NEGATIVE: q = {}", q);
+            Diagnostics::report(RayStatus::ARGUMENT_ERROR, "ForwardRayTracingParams", "q", [&]
+                                { return fmt::format("q out of range, which should be positive when d_sign is NEGATIVE: q = {}", q); },
+                                print_args_error);
             lambda = std::numeric_limits<Real>::quiet_NaN();
             q = std::numeric_limits<Real>::quiet_NaN();
             return false;
         }
 #ifdef PRINT_DEBUG
         fmt::println("rc: {}, log_abs_d: {}", rc, log_abs_d);
-        fmt::println("lambda_c: {}, eta_c: {}, qc: {}", lambda_c, eta_c, qc);
-        fmt::println("coeff: {}", coeff);
+        fmt::println("lambda_c: {}, qc: {}", point.lambda_c, point.qc);
+        fmt::println("lambda_dir: {}, q_dir: {}", point.lambda_dir, point.q_dir);
 #endif
         return true;
     }
@@ -166,6 +203,33 @@ ForwardRayTracingResult<LReal, LComplex> get_low_prec(const ForwardRayTracingRes
     return result;
 }
 
+// Radial anti-derivatives needed by a ray. Rays of the same case run through the same kernel.
+enum class RadialCase
+{
+    NONE,     // ray status already decided, no integrals needed
+    I2_PLUS,  // radial turning point, nu_r = NEGATIVE
+    I2_MINUS, // radial turning point, nu_r = POSITIVE
+    I3,       // no radial turning point, nu_r = POSITIVE
+};
+
+constexpr size_t RADIAL_CASE_COUNT = static_cast<size_t>(RadialCase::I3) + 1;
+
+// State of a ray after ForwardRayTracing::prepare_ray, so that ForwardRayTracing::finish_ray can be run later on
+// any ForwardRayTracing object.
+template <typename Real, typename Complex>
+struct PreparedRay
+{
+    std::shared_ptr<const KerrBackground<Real>> background;
+    Real a, rp, rm, r_s, theta_s, r_o;
+    Sign nu_r, nu_theta;
+    Real lambda, q, eta;
+    Real delta_theta, up, um, theta_p, theta_m;
+    Real r1, r2, r3, r4;
+    bool r12_is_real, r34_is_real;
+    Real roots_z, roots_sqrt_12, roots_sqrt_34;
+    bool calc_t_f;
+};
+
 template <typename Real, typename Complex>
 class ForwardRayTracing
 {
@@ -178,27 +242,40 @@ class ForwardRayTracing
 private:
     inline static ObjectPool<ForwardRayTracing<Real, Complex>> pool;
 
+    // scratch of init_radial_potential_roots, kept as members like the kernel intermediates so that multiprecision
+    // numbers reuse their storage across the rays traced by this (per-thread) object
+    Real AA, BB, CC, PP, QQ;
+    Real omega_pm, omega_pm_1, omega_pm_2, omega_pm_abs, omega_pm_arg;
+    Real sqrt_in_1, sqrt_in_2;
+
     void reset_variables()
     {
         ray_status = RayStatus::NORMAL;
-        r1 = r2 = r3 = r4 = tau_o = t_f = theta_f = phi_f = n_half = eta = lambda = q = std::numeric_limits<Real>::quiet_NaN();
-        r1_c = r2_c = r3_c = r4_c = Complex{std::numeric_limits<Real>::quiet_NaN()};
+        for (Real *x : {&r1, &r2, &r3, &r4, &tau_o, &t_f, &theta_f, &phi_f, &n_half, &eta, &lambda, &q,
+                        &roots_z, &roots_sqrt_12, &roots_sqrt_34})
+        {
+            set_nan(*x);
+        }
         m = std::numeric_limits<int>::max();
-        std::fill(radial_integrals.begin(), radial_integrals.end(), std::numeric_limits<Real>::quiet_NaN());
-        std::fill(angular_integrals.begin(), angular_integrals.end(), std::numeric_limits<Real>::quiet_NaN());
+        for (int i = 0; i < 3; ++i)
+        {
+            set_nan(radial_integrals[i]);
+            set_nan(angular_integrals[i]);
+        }
     }
 
     void init_radial_potential_roots()
     {
-        Real AA = a * a - eta - lambda * lambda;
-        Real BB = 2 * (eta + (lambda - a) * (lambda - a));
-        Real CC = -a * a * eta;
-        Real PP = -AA * AA / 12 - CC;
-        Real QQ = (-2 * MY_CUBE(AA) - 27 * MY_SQUARE(BB) + 72 * AA * CC) / 216;
+        INSTRUMENT_STAGE(Stage::ROOTS);
+        AA = a * a - eta - lambda * lambda;
+        BB = 2 * (eta + (lambda - a) * (lambda - a));
+        CC = -a * a * eta;
+        PP = -AA * AA / 12 - CC;
+        QQ = (-2 * MY_CUBE(AA) - 27 * MY_SQUARE(BB) + 72 * AA * CC) / 216;
 
-        Complex omega_pm;
-        Real omega_pm_1 = -QQ * half<Real>();
-        Real omega_pm_2 = MY_CUBE(PP) / 27 + MY_SQUARE(QQ) / 4;
+        // real root of the resolvent cubic, trigonometric form when all three roots are real
+        omega_pm_1 = -QQ * half<Real>();
+        omega_pm_2 = MY_CUBE(PP) / 27 + MY_SQUARE(QQ) / 4;
 
         if (omega_pm_2 > 0)
         {
@@ -207,43 +284,45 @@ private:
         }
         else
         {
-            Complex omega_pm_2_c{omega_pm_2};
-            omega_pm = pow(omega_pm_1 + sqrt(omega_pm_2_c), third<Real>()) +
-                       pow(omega_pm_1 - sqrt(omega_pm_2_c), third<Real>());
+            // (omega_pm_1 +- i sqrt(-omega_pm_2))^(1/3) are complex conjugates, their sum is twice the real part
+            omega_pm_abs = sqrt(MY_SQUARE(omega_pm_1) - omega_pm_2);
+            omega_pm_arg = atan2(sqrt(-omega_pm_2), omega_pm_1);
+            omega_pm = 2 * cbrt(omega_pm_abs) * cos(omega_pm_arg * third<Real>());
         }
 
-        Real z = sqrt((real(omega_pm) - AA * third<Real>()) * half<Real>());
+        roots_z = sqrt((omega_pm - AA * third<Real>()) * half<Real>());
 
-        Complex sqrt_in_1 = -(AA * half<Real>()) - MY_SQUARE(z) + BB / (4 * z);
-        Complex sqrt_in_2 = -(AA * half<Real>()) - MY_SQUARE(z) - BB / (4 * z);
+        sqrt_in_1 = -(AA * half<Real>()) - MY_SQUARE(roots_z) + BB / (4 * roots_z);
+        sqrt_in_2 = -(AA * half<Real>()) - MY_SQUARE(roots_z) - BB / (4 * roots_z);
 
-        r1_c = -z - sqrt(sqrt_in_1);
-        r2_c = -z + sqrt(sqrt_in_1);
-        r3_c = z - sqrt(sqrt_in_2);
-        r4_c = z + sqrt(sqrt_in_2);
-
-        if (real(sqrt_in_1) < 0)
+        if (sqrt_in_1 < 0)
         {
             r12_is_real = false;
-            r1 = r2 = std::numeric_limits<Real>::quiet_NaN();
+            roots_sqrt_12 = sqrt(-sqrt_in_1);
+            set_nan(r1);
+            set_nan(r2);
         }
         else
         {
             r12_is_real = true;
-            r1 = real(r1_c);
-            r2 = real(r2_c);
+            roots_sqrt_12 = sqrt(sqrt_in_1);
+            r1 = -roots_z - roots_sqrt_12;
+            r2 = -roots_z + roots_sqrt_12;
         }
 
-        if (real(sqrt_in_2) < 0)
+        if (sqrt_in_2 < 0)
         {
             r34_is_real = false;
-            r3 = r4 = std::numeric_limits<Real>::quiet_NaN();
+            roots_sqrt_34 = sqrt(-sqrt_in_2);
+            set_nan(r3);
+            set_nan(r4);
         }
         else
         {
             r34_is_real = true;
-            r3 = real(r3_c);
-            r4 = real(r4_c);
+            roots_sqrt_34 = sqrt(sqrt_in_2);
+            r3 = roots_z - roots_sqrt_34;
+            r4 = roots_z + roots_sqrt_34;
         }
 
 #ifdef PRINT_DEBUG
@@ -254,6 +333,7 @@ private:
 
     void init_theta_pm()
     {
+        INSTRUMENT_STAGE(Stage::THETA_PM);
         delta_theta = half<Real>() * (1 - (eta + MY_SQUARE(lambda)) / MY_SQUARE(a));
         up = delta_theta + sqrt(MY_SQUARE(delta_theta) + eta / MY_SQUARE(a));
         um = delta_theta - sqrt(MY_SQUARE(delta_theta) + eta / MY_SQUARE(a));
@@ -276,42 +356,22 @@ private:
 #endif
     }
 
-    void calcI()
+    void calcI(RadialCase radial_case)
     {
-        bool radial_turning = r34_is_real && r4 > rp;
-
-        // if there is a radial turning point (i.e. r4 is a real number)
-        if (radial_turning && r_s <= r4)
-        {
-            ray_status = RayStatus::CONFINED;
-            return;
-        }
-
-        if (radial_turning && r_s > r4 && nu_r == Sign::POSITIVE)
-        {
-            I_integral_2->calc(false);
-            return;
-        }
-
-        if (radial_turning && r_s > r4 && nu_r == Sign::NEGATIVE)
+        switch (radial_case)
         {
+        case RadialCase::I2_PLUS:
             I_integral_2->calc(true);
             return;
-        }
-
-        if (!radial_turning && nu_r == Sign::NEGATIVE)
-        {
-            ray_status = RayStatus::FALLS_IN;
+        case RadialCase::I2_MINUS:
+            I_integral_2->calc(false);
             return;
-        }
-
-        if (!radial_turning && nu_r == Sign::POSITIVE)
-        {
+        case RadialCase::I3:
             I_integral_3->calc(false);
             return;
+        default:
+            ray_status = RayStatus::UNKOWN_ERROR;
         }
-
-        ray_status = RayStatus::UNKOWN_ERROR;
     }
 
 public:
@@ -324,9 +384,11 @@ public:
     // auto initialized
     RayStatus ray_status;
     Real delta_theta, up, um, theta_p, theta_m;
-    Complex r1_c, r2_c, r3_c, r4_c;
     Real r1, r2, r3, r4;
     bool r12_is_real, r34_is_real;
+    // r1, r2 = -roots_z -+ sqrt(x_12) and r3, r4 = roots_z -+ sqrt(x_34), roots_sqrt_* = sqrt(|x_*|) is the imaginary part
+    // of a complex conjugate pair. The complex roots are only formed by get_complex_roots.
+    Real roots_z, roots_sqrt_12, roots_sqrt_34;
 
     // minor time
     Real tau_o;
@@ -364,17 +426,37 @@ public:
     std::shared_ptr<IIntegral3<Real, Complex>> I_integral_3;
     std::shared_ptr<GIntegral<Real, Complex>> G_integral;
 
-    void calc_ray(const ForwardRayTracingParams<Real> &params)
+    // spin-only constants of the last ray, reused as long as the spin does not change
+    std::shared_ptr<const KerrBackground<Real>> background;
+
+    void use_background(const ForwardRayTracingParams<Real> &params)
+    {
+        if (params.background && params.background->matches(params.a))
+        {
+            if (background != params.background)
+            {
+                background = params.background;
+            }
+        }
+        else if (!background || !background->matches(params.a))
+        {
+            background = KerrBackground<Real>::create(params.a);
+        }
+    }
+
+    // roots of the potentials and all checks that do not need elliptic integrals
+    void prepare_ray(const ForwardRayTracingParams<Real> &params)
     {
         reset_variables();
+        use_background(params);
 
         a = params.a;
         r_s = params.r_s;
         theta_s = params.theta_s;
         r_o = params.r_o;
 
-        rp = 1 + sqrt(1 - a * a);
-        rm = 1 - sqrt(1 - a * a);
+        rp = background->rp;
+        rm = background->rm;
 
         calc_t_f = params.calc_t_f;
 
@@ -408,9 +490,59 @@ public:
             ray_status = RayStatus::R_OUT_OF_RANGE;
             return;
         }
+    }
+
+    // radial anti-derivatives needed by a prepared ray, sets the ray status if the ray is confined or falls in
+    RadialCase get_radial_case()
+    {
+        if (ray_status != RayStatus::NORMAL)
+        {
+            return RadialCase::NONE;
+        }
+
+        bool radial_turning = r34_is_real && r4 > rp;
+
+        // if there is a radial turning point (i.e. r4 is a real number)
+        if (radial_turning && r_s <= r4)
+        {
+            ray_status = RayStatus::CONFINED;
+            return RadialCase::NONE;
+        }
+
+        if (radial_turning && r_s > r4 && nu_r == Sign::POSITIVE)
+        {
+            return RadialCase::I2_MINUS;
+        }
+
+        if (radial_turning && r_s > r4 && nu_r == Sign::NEGATIVE)
+        {
+            return RadialCase::I2_PLUS;
+        }
+
+        if (!radial_turning && nu_r == Sign::NEGATIVE)
+        {
+            ray_status = RayStatus::FALLS_IN;
+            return RadialCase::NONE;
+        }
+
+        if (!radial_turning && nu_r == Sign::POSITIVE)
+        {
+            return RadialCase::I3;
+        }
+
+        ray_status = RayStatus::UNKOWN_ERROR;
+        return RadialCase::NONE;
+    }
+
+    // elliptic integrals and final values of a prepared ray
+    void finish_ray(RadialCase radial_case)
+    {
+        CHECK_STATUS
+
+        size_t errors = special_function_errors;
 
         // Radial integrals
-        calcI();
+        calcI(radial_case);
 
         CHECK_STATUS
 
@@ -427,11 +559,117 @@ public:
             t_f = radial_integrals[2] + MY_SQUARE(a) * angular_integrals[2];
         }
 
+        // special functions return NaN, inf or an unconverged estimate instead of throwing, see SpecialFunctionPolicy
+        if (special_function_errors != errors || !isfinite(theta_f) || !isfinite(phi_f) ||
+            (calc_t_f && !isinf(r_o) && !isfinite(t_f)))
+        {
+            ray_status = RayStatus::INTERNAL_ERROR;
+        }
+
 #ifdef PRINT_DEBUG
         fmt::println("theta_f, phi_f, t_f, m, nhalf: {}, {}, {}, {}, {}", theta_f, phi_f, t_f, m, n_half);
 #endif
     }
 
+    void calc_ray(const ForwardRayTracingParams<Real> &params)
+    {
+        prepare_ray(params);
+        finish_ray(get_radial_case());
+        INSTRUMENT_RAY(ray_status);
+    }
+
+    void save_prepared(PreparedRay<Real, Complex> &ray) const
+    {
+        ray.background = background;
+        ray.a = a;
+        ray.rp = rp;
+        ray.rm = rm;
+        ray.r_s = r_s;
+        ray.theta_s = theta_s;
+        ray.r_o = r_o;
+        ray.nu_r = nu_r;
+        ray.nu_theta = nu_theta;
+        ray.lambda = lambda;
+        ray.q = q;
+        ray.eta = eta;
+        ray.delta_theta = delta_theta;
+        ray.up = up;
+        ray.um = um;
+        ray.theta_p = theta_p;
+        ray.theta_m = theta_m;
+        ray.r1 = r1;
+        ray.r2 = r2;
+        ray.r3 = r3;
+        ray.r4 = r4;
+        ray.r12_is_real = r12_is_real;
+        ray.r34_is_real = r34_is_real;
+        ray.roots_z = roots_z;
+        ray.roots_sqrt_12 = roots_sqrt_12;
+        ray.roots_sqrt_34 = roots_sqrt_34;
+        ray.calc_t_f = calc_t_f;
+    }
+
+    void load_prepared(const PreparedRay<Real, Complex> &ray)
+    {
+        reset_variables();
+        background = ray.background;
+        a = ray.a;
+        rp = ray.rp;
+        rm = ray.rm;
+        r_s = ray.r_s;
+        theta_s = ray.theta_s;
+        r_o = ray.r_o;
+        nu_r = ray.nu_r;
+        nu_theta = ray.nu_theta;
+        lambda = ray.lambda;
+        q = ray.q;
+        eta = ray.eta;
+        delta_theta = ray.delta_theta;
+        up = ray.up;
+        um = ray.um;
+        theta_p = ray.theta_p;
+        theta_m = ray.theta_m;
+        r1 = ray.r1;
+        r2 = ray.r2;
+        r3 = ray.r3;
+        r4 = ray.r4;
+        r12_is_real = ray.r12_is_real;
+        r34_is_real = ray.r34_is_real;
+        roots_z = ray.roots_z;
+        roots_sqrt_12 = ray.roots_sqrt_12;
+        roots_sqrt_34 = ray.roots_sqrt_34;
+        calc_t_f = ray.calc_t_f;
+    }
+
+    void get_complex_roots(Complex &r1_c, Complex &r2_c, Complex &r3_c, Complex &r4_c) const
+    {
+        if (isnan(roots_z))
+        {
+            r1_c = r2_c = r3_c = r4_c = Complex{std::numeric_limits<Real>::quiet_NaN()};
+            return;
+        }
+        if (r12_is_real)
+        {
+            r1_c = Complex{r1};
+            r2_c = Complex{r2};
+        }
+        else
+        {
+            r1_c = Complex{-roots_z, -roots_sqrt_12};
+            r2_c = Complex{-roots_z, roots_sqrt_12};
+        }
+        if (r34_is_real)
+        {
+            r3_c = Complex{r3};
+            r4_c = Complex{r4};
+        }
+        else
+        {
+            r3_c = Complex{roots_z, -roots_sqrt_34};
+            r4_c = Complex{roots_z, roots_sqrt_34};
+        }
+    }
+
     ForwardRayTracingResult<Real, Complex> to_result()
     {
         ForwardRayTracingResult<Real, Complex> result;
@@ -445,10 +683,7 @@ public:
         result.r2 = r2;
         result.r3 = r3;
         result.r4 = r4;
-        result.r1_c = r1_c;
-        result.r2_c = r2_c;
-        result.r3_c = r3_c;
-        result.r4_c = r4_c;
+        get_complex_roots(result.r1_c, result.r2_c, result.r3_c, result.r4_c);
         result.t_f = t_f;
         result.theta_f = theta_f;
         result.phi_f = phi_f;
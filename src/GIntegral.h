@@ -37,14 +37,14 @@ private:
         ellint_cos_theta = sqrt(ellint_cos_theta2);
 
         ellint_y = 1 - ellint_kappa2 * ellint_sin_theta2;
-        // ellint_1_phi = boost::math::ellint_1(ellint_kappa, ellint_theta);
-        ellint_1_phi = ellint_sin_theta * boost::math::ellint_rf(ellint_cos_theta2, ellint_y, 1);
-        // ellint_2_phi = boost::math::ellint_2(ellint_kappa, ellint_theta);
+        // ellint_1_phi = ellint_1(ellint_kappa, ellint_theta);
+        ellint_1_phi = ellint_sin_theta * ellint_rf(ellint_cos_theta2, ellint_y, 1);
+        // ellint_2_phi = ellint_2(ellint_kappa, ellint_theta);
         ellint_2_phi = ellint_1_phi - third<Real>() * ellint_kappa2 * ellint_sin_theta2 * ellint_sin_theta *
-                                      boost::math::ellint_rd(ellint_cos_theta2, ellint_y, 1);
-        // ellint_3_phi = boost::math::ellint_3(ellint_kappa, ellint_alpha1_2, ellint_theta);
+                                      ellint_rd(ellint_cos_theta2, ellint_y, 1);
+        // ellint_3_phi = ellint_3(ellint_kappa, ellint_alpha1_2, ellint_theta);
         ellint_3_phi = ellint_1_phi + third<Real>() * ellint_alpha1_2 * ellint_sin_theta2 * ellint_sin_theta *
-                                      boost::math::ellint_rj(ellint_cos_theta2, ellint_y, 1,
+                                      ellint_rj(ellint_cos_theta2, ellint_y, 1,
                                                              1 - ellint_alpha1_2 * ellint_sin_theta2);
         G_arr[0] = -one_over_umaa_sqrt * ellint_kappa_prime * ellint_1_phi;
         G_arr[1] = -one_over_umaa_sqrt * ellint_kappa_prime / ellint_alpha1_2 *
@@ -60,10 +60,12 @@ private:
 
 public:
     explicit GIntegral(ForwardRayTracing<Real, Complex> &data_) : Integral<Real, Complex>(data_,
+                                                                                          "GIntegral",
                                                                                           TypeName<GIntegral<Real, Complex>>::Get()) {
     }
 
     void calc() {
+        INSTRUMENT_STAGE(Stage::G_INTEGRAL);
         const Real &a = this->data.a;
         const Real &up = this->data.up;
         const Real &um = this->data.um;
@@ -86,15 +88,15 @@ public:
         one_over_sqrt_up = 1 / sqrt(up);
         one_over_umaa_sqrt = 1 / sqrt(-um * a * a);
 
-        G_theta_p[0] = ellint_kappa_prime * boost::math::ellint_1(ellint_kappa) * one_over_umaa_sqrt;
+        G_theta_p[0] = ellint_kappa_prime * ellint_1(ellint_kappa) * one_over_umaa_sqrt;
         G_theta_p[1] =
-                (ellint_kappa_prime / (1 - up)) * boost::math::ellint_3(ellint_kappa, ellint3_n) * one_over_umaa_sqrt;
+                (ellint_kappa_prime / (1 - up)) * ellint_3(ellint_kappa, ellint3_n) * one_over_umaa_sqrt;
         if (this->data.calc_t_f) {
             G_theta_p[2] =
-                    um * (-ellint_one_over_kappa_prime * boost::math::ellint_2(ellint_kappa) * one_over_umaa_sqrt +
+                    um * (-ellint_one_over_kappa_prime * ellint_2(ellint_kappa) * one_over_umaa_sqrt +
                           G_theta_p[0]);
         } else {
-            G_theta_p[2] = std::numeric_limits<Real>::quiet_NaN();
+            set_nan(G_theta_p[2]);
         }
 
         G_theta_phi_t(G_theta_s, theta_s);
@@ -109,7 +111,7 @@ public:
         jacobi_sn_k1 = ellint_k * jacobi_sn_k1_prime;
         this->data.theta_f = acos(-sqrt(up) * GET_SIGN(nu_theta) *
                                   jacobi_sn_k1_prime *
-                                  boost::math::jacobi_sd(jacobi_sn_k1,
+                                  jacobi_sd(jacobi_sn_k1,
                                                          (tau_o + GET_SIGN(nu_theta) * G_theta_theta_s) /
                                                          (one_over_umaa_sqrt * jacobi_sn_k1_prime)));
 
@@ -118,7 +120,8 @@ public:
                                      (2 * G_theta_theta_p)));
 
         // floor
-        this->data.m = MY_FLOOR<Real>::convert(m_Real);
+        bool m_in_range = floor_to_int(m_Real, this->data.m);
+        CHECK_VAR(m_Real, m_in_range);
 
         // Number of half-orbits
         this->data.n_half = tau_o / (2 * G_theta_theta_p);
@@ -137,7 +140,7 @@ public:
                     (2 * this->data.m) * G_theta_p[i] + GET_SIGN(nu_theta) * (m1_m * G_theta_f[i] - G_theta_s[i]);
         }
         if (!this->data.calc_t_f) {
-            angular_integrals[2] = std::numeric_limits<Real>::quiet_NaN();
+            set_nan(angular_integrals[2]);
         }
 
 #ifdef PRINT_DEBUG
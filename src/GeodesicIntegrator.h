@@ -0,0 +1,216 @@
+#pragma once
+
+#include "ForwardRayTracing.h"
+
+#include <algorithm>
+#include <array>
+#include <limits>
+#include <vector>
+
+#include <boost/numeric/odeint.hpp>
+#include <oneapi/tbb/blocked_range.h>
+#include <oneapi/tbb/parallel_for.h>
+
+// Numerical reference for the closed-form ray tracing: the geodesic equations in Mino time integrated with an adaptive
+// Runge-Kutta-Fehlberg 7(8) stepper. It shares nothing with the elliptic integrals except the parameters, so it can
+// cross-validate them on random rays in any precision.
+//
+// The radial and polar equations are integrated in their second order form, d^2r/dtau^2 = R'(r) / 2 and
+// d^2theta/dtau^2 = Theta'(theta) / 2, which passes through turning points without sign bookkeeping. The ray is stopped
+// where r reaches r_o, located with Newton iterations on a single step from the last accepted state. A ray whose step
+// size collapses or whose end does not converge gets RayStatus::INTERNAL_ERROR.
+
+template <typename Real>
+struct GeodesicIntegratorSettings
+{
+    Real abs_tol = std::numeric_limits<Real>::epsilon() * 100;
+    Real rel_tol = std::numeric_limits<Real>::epsilon() * 100;
+    size_t max_steps = 1000000;
+    // rejected tries before the ray is given up, a step size that collapses is rejected on every try
+    size_t max_rejected_steps = 100000;
+    size_t max_newton_iterations = 64;
+};
+
+template <typename Real>
+struct GeodesicIntegratorResult
+{
+    RayStatus ray_status = RayStatus::NORMAL;
+    Real tau_o;
+    Real t_f;
+    Real theta_f;
+    Real phi_f;
+    size_t steps = 0;
+    size_t rejected_steps = 0;
+};
+
+template <typename Real, typename Complex>
+class GeodesicIntegrator
+{
+private:
+    // r, dr/dtau, theta, dtheta/dtau, phi, t
+    using State = std::array<Real, 6>;
+
+    struct MinoSystem
+    {
+        Real a, lambda, eta;
+
+        void operator()(const State &x, State &dxdt, const Real &) const
+        {
+            const Real &r = x[0];
+            const Real &theta = x[2];
+            Real r2 = r * r;
+            Real a2 = a * a;
+            Real delta = r2 - 2 * r + a2;
+            Real P = r2 + a2 - a * lambda;
+            Real sin_theta = sin(theta);
+            Real cos_theta = cos(theta);
+            Real sin2 = sin_theta * sin_theta;
+
+            dxdt[0] = x[1];
+            // R'(r) / 2
+            dxdt[1] = 2 * r * P - (r - 1) * (eta + (lambda - a) * (lambda - a));
+            dxdt[2] = x[3];
+            // Theta'(theta) / 2
+            dxdt[3] = -a2 * sin_theta * cos_theta + lambda * lambda * cos_theta / (sin2 * sin_theta);
+            dxdt[4] = a * (2 * r - a * lambda) / delta + lambda / sin2;
+            dxdt[5] = (r2 + a2) * P / delta + a * (lambda - a * sin2);
+        }
+    };
+
+    // multiprecision numbers name themselves as value_type, which odeint's own norm cannot resolve
+    struct MinoAlgebra : boost::numeric::odeint::range_algebra
+    {
+        template <typename S>
+        static Real norm_inf(const S &s)
+        {
+            Real norm = 0;
+            for (const Real &value : s)
+            {
+                norm = std::max(norm, Real(abs(value)));
+            }
+            return norm;
+        }
+    };
+
+    using Stepper = boost::numeric::odeint::runge_kutta_fehlberg78<State, Real, State, Real, MinoAlgebra>;
+
+public:
+    // Integrate one ray from r_s to r_o. Rays that the closed form rejects without integrals (argument errors, eta or
+    // theta out of range, confined or falling in) get the same status, everything else is integrated.
+    static GeodesicIntegratorResult<Real> integrate(ForwardRayTracing<Real, Complex> &ray_tracing,
+                                                    const ForwardRayTracingParams<Real> &params,
+                                                    const GeodesicIntegratorSettings<Real> &settings = {})
+    {
+        using namespace boost::numeric::odeint;
+
+        GeodesicIntegratorResult<Real> result;
+        ray_tracing.prepare_ray(params);
+        if (ray_tracing.get_radial_case() == RadialCase::NONE)
+        {
+            result.ray_status = ray_tracing.ray_status;
+            return result;
+        }
+        if (!isfinite(params.r_o))
+        {
+            // the integration has to end somewhere
+            result.ray_status = RayStatus::ARGUMENT_ERROR;
+            return result;
+        }
+
+        const Real &a = params.a;
+        const Real &lambda = ray_tracing.lambda;
+        const Real &eta = ray_tracing.eta;
+        MinoSystem system{a, lambda, eta};
+
+        const Real &r_s = params.r_s;
+        const Real &theta_s = params.theta_s;
+        Real P_s = r_s * r_s + a * a - a * lambda;
+        Real R_s = P_s * P_s - (r_s * r_s - 2 * r_s + a * a) * (eta + (lambda - a) * (lambda - a));
+        Real cos_s = cos(theta_s);
+        Real cot_s = cos_s / sin(theta_s);
+        Real Theta_s = eta + a * a * cos_s * cos_s - lambda * lambda * cot_s * cot_s;
+
+        // roundoff can make the potentials slightly negative at a turning point
+        State x = {r_s, static_cast<int>(params.nu_r) * sqrt(R_s > 0 ? R_s : Real(0)), theta_s,
+                   static_cast<int>(params.nu_theta) * sqrt(Theta_s > 0 ? Theta_s : Real(0)), Real(0), Real(0)};
+        Real tau = 0;
+        // Mino time scales as 1 / r far from the hole
+        Real dt = Real(1) / (100 * (1 + r_s));
+
+        auto controlled = make_controlled(settings.abs_tol, settings.rel_tol, Stepper());
+        const Real &r_o = params.r_o;
+        const Real r_horizon = ray_tracing.rp;
+
+        while (result.steps < settings.max_steps)
+        {
+            State x_prev = x;
+            Real tau_prev = tau;
+            if (controlled.try_step(system, x, tau, dt) == fail)
+            {
+                if (++result.rejected_steps > settings.max_rejected_steps)
+                {
+                    result.ray_status = RayStatus::INTERNAL_ERROR;
+                    return result;
+                }
+                continue;
+            }
+            result.steps++;
+
+            if (x[0] <= r_horizon)
+            {
+                result.ray_status = RayStatus::FALLS_IN;
+                return result;
+            }
+            if (x[0] < r_o)
+            {
+                continue;
+            }
+
+            // Newton on the length of a single step from the last accepted state, r is increasing there
+            Real h = (tau - tau_prev) * (r_o - x_prev[0]) / (x[0] - x_prev[0]);
+            State y;
+            bool converged = false;
+            for (size_t k = 0; k < settings.max_newton_iterations; k++)
+            {
+                controlled.stepper().do_step(system, x_prev, tau_prev, y, h);
+                Real f = y[0] - r_o;
+                if (abs(f) <= settings.abs_tol + settings.rel_tol * r_o)
+                {
+                    converged = true;
+                    break;
+                }
+                h -= f / y[1];
+            }
+            if (!converged)
+            {
+                result.ray_status = RayStatus::INTERNAL_ERROR;
+                return result;
+            }
+            result.tau_o = tau_prev + h;
+            result.theta_f = y[2];
+            result.phi_f = y[4];
+            result.t_f = y[5];
+            return result;
+        }
+
+        result.ray_status = RayStatus::INTERNAL_ERROR;
+        return result;
+    }
+
+    static std::vector<GeodesicIntegratorResult<Real>>
+    integrate_batch(const std::vector<ForwardRayTracingParams<Real>> &params_list,
+                    const GeodesicIntegratorSettings<Real> &settings = {})
+    {
+        std::vector<GeodesicIntegratorResult<Real>> results(params_list.size());
+        oneapi::tbb::parallel_for(oneapi::tbb::blocked_range<size_t>(0u, params_list.size()),
+                                  [&](const oneapi::tbb::blocked_range<size_t> &r)
+                                  {
+                                      auto ray_tracing = ForwardRayTracing<Real, Complex>::get_from_cache();
+                                      for (size_t i = r.begin(); i != r.end(); ++i)
+                                      {
+                                          results[i] = integrate(*ray_tracing, params_list[i], settings);
+                                      }
+                                  });
+        return results;
+    }
+};
@@ -17,6 +17,7 @@ private:
     std::array<Real, 3> integral_ro;
 public:
     explicit IIntegral2(ForwardRayTracing<Real, Complex> &data_) : Integral<Real, Complex>(data_,
+                                                                                           "IIntegral2",
                                                                                            TypeName<IIntegral2<Real, Complex>>::Get()) {
     }
 
@@ -87,9 +88,8 @@ public:
             const Real &r4 = this->data.r4;
             const Real &eta = this->data.eta;
 
-            using boost::math::ellint_rd;
-            E2 = E2_coeff * boost::math::ellint_2(ellint_k, ellint_phi);
-            Pi_12 = F2_coeff * boost::math::ellint_3(ellint_k, Pi_12_ellint_n, ellint_phi);
+            E2 = E2_coeff * ellint_2(ellint_k, ellint_phi);
+            Pi_12 = F2_coeff * ellint_3(ellint_k, Pi_12_ellint_n, ellint_phi);
             I1 = r3 * F2 + (r4 - r3) * Pi_12;
             I2 = -E2 + sqrt(-((eta + MY_SQUARE(a - lambda)) * (MY_SQUARE(a) + (-2 + r) * r)) +
                             MY_SQUARE(MY_SQUARE(a) - a * lambda + MY_SQUARE(r))) / (r - r3) -
@@ -102,11 +102,12 @@ public:
             fmt::println("I2 - E2: {}, Pi_12: {}, I1: {}, I2: {}", E2, Pi_12, I1, I2);
 #endif
         } else {
-            integral[2] = std::numeric_limits<Real>::quiet_NaN();
+            set_nan(integral[2]);
         }
     }
 
     void calc(bool is_plus) {
+        INSTRUMENT_STAGE(Stage::I_INTEGRAL_2);
         pre_calc();
 
         CHECK_DATA_STATUS
@@ -123,7 +124,13 @@ public:
 
         auto &radial_integrals = this->data.radial_integrals;
         for (int i = 0; i < 3; ++i) {
-            radial_integrals[i] = is_plus ? integral_ro[i] + integral_rs[i] : integral_ro[i] - integral_rs[i];
+            // accumulated in place, a conditional expression would need a temporary with expression templates
+            radial_integrals[i] = integral_ro[i];
+            if (is_plus) {
+                radial_integrals[i] += integral_rs[i];
+            } else {
+                radial_integrals[i] -= integral_rs[i];
+            }
         }
 #ifdef PRINT_DEBUG
         fmt::println("I2: {}, {}, {}", radial_integrals[0], radial_integrals[1], radial_integrals[2]);
@@ -3,8 +3,6 @@
 #include "Common.h"
 #include "Integral.h"
 
-#include <boost/math/special_functions/ellint_rc.hpp>
-
 // Radial Antiderivatives for case (3)
 template<typename Real, typename Complex>
 class IIntegral3 : public Integral<Real, Complex> {
@@ -28,9 +26,6 @@ private:
         ellint3_n = alpha2 / (alpha2 - 1);
         ellint3_n1 = ellint_m / ellint3_n;
 
-        using boost::math::ellint_rc;
-        using boost::math::ellint_rj;
-
         using boost::math::constants::half_pi;
         using boost::math::constants::two_thirds;
 
@@ -62,6 +57,7 @@ private:
 
 public:
     explicit IIntegral3(ForwardRayTracing<Real, Complex> &data_) : Integral<Real, Complex>(data_,
+                                                                                           "IIntegral3",
                                                                                            TypeName<IIntegral3<Real, Complex>>::Get()) {
     }
 
@@ -71,10 +67,9 @@ public:
         // two real roots, both inside horizon, r_1 < r_2 < r_- < r_+ and r_3 = conj(r_4)
         const Real &r1 = this->data.r1;
         const Real &r2 = this->data.r2;
-        const Complex &r3 = this->data.r3_c;
 
-        r34_re = real(r3);
-        r34_im = imag(r3);
+        r34_re = this->data.roots_z;
+        r34_im = this->data.roots_sqrt_34;
 
         // radial coeffs
         A = sqrt(MY_SQUARE(r34_im) + MY_SQUARE(r34_re - r2));
@@ -163,7 +158,7 @@ public:
                          R2_alpha_0, Pi_13, Pi_23, I1, I2);
 #endif
         } else {
-            integral[2] = std::numeric_limits<Real>::quiet_NaN();
+            set_nan(integral[2]);
         }
 
 #ifdef PRINT_DEBUG
@@ -173,6 +168,7 @@ public:
     }
 
     void calc(bool is_plus) {
+        INSTRUMENT_STAGE(Stage::I_INTEGRAL_3);
         pre_calc();
 
         CHECK_DATA_STATUS
@@ -189,7 +185,13 @@ public:
 
         auto &radial_integrals = this->data.radial_integrals;
         for (int i = 0; i < 3; ++i) {
-            radial_integrals[i] = is_plus ? integral_ro[i] + integral_rs[i] : integral_ro[i] - integral_rs[i];
+            // accumulated in place, a conditional expression would need a temporary with expression templates
+            radial_integrals[i] = integral_ro[i];
+            if (is_plus) {
+                radial_integrals[i] += integral_rs[i];
+            } else {
+                radial_integrals[i] -= integral_rs[i];
+            }
         }
 #ifdef PRINT_DEBUG
         fmt::println("I3: {}, {}, {}", radial_integrals[0], radial_integrals[1], radial_integrals[2]);
@@ -0,0 +1,185 @@
+#pragma once
+
+#include "Common.h"
+
+#include <array>
+#include <chrono>
+
+#ifdef ENABLE_INSTRUMENTATION
+#include <oneapi/tbb/enumerable_thread_specific.h>
+#endif
+
+enum class Stage
+{
+    ROOTS,        // roots of the radial potential
+    THETA_PM,     // angular turning points
+    I_INTEGRAL_2, // radial integrals, case (2)
+    I_INTEGRAL_3, // radial integrals, case (3)
+    G_INTEGRAL,   // angular integrals
+    CANDIDATES,   // sign changes of delta_theta and delta_phi on the sweep grid
+    PAIRING,      // rtree pairing of theta and phi candidates
+    ROOT_SOLVE,   // one find_root_period
+    DEDUPE,       // removal of duplicated roots
+};
+
+constexpr size_t STAGE_COUNT = static_cast<size_t>(Stage::DEDUPE) + 1;
+
+constexpr const char *stage_to_str(Stage stage)
+{
+    switch (stage)
+    {
+    case Stage::ROOTS:
+        return "ROOTS";
+    case Stage::THETA_PM:
+        return "THETA_PM";
+    case Stage::I_INTEGRAL_2:
+        return "I_INTEGRAL_2";
+    case Stage::I_INTEGRAL_3:
+        return "I_INTEGRAL_3";
+    case Stage::G_INTEGRAL:
+        return "G_INTEGRAL";
+    case Stage::CANDIDATES:
+        return "CANDIDATES";
+    case Stage::PAIRING:
+        return "PAIRING";
+    case Stage::ROOT_SOLVE:
+        return "ROOT_SOLVE";
+    case Stage::DEDUPE:
+        return "DEDUPE";
+    }
+    return "UNKNOWN";
+}
+
+// Aggregated stage timers and counters. Stage times are summed over threads, so the stages that run inside a
+// parallel_for can add up to more than the wall time of a sweep.
+struct InstrumentationReport
+{
+    bool enabled = false;
+
+    std::array<double, STAGE_COUNT> stage_seconds{};
+    std::array<size_t, STAGE_COUNT> stage_calls{};
+
+    // traced rays by their final RayStatus
+    std::array<size_t, RAY_STATUS_COUNT> rays{};
+
+    size_t root_solves = 0;
+    size_t broyden_iterations = 0;
+    size_t function_evaluations = 0;
+    size_t line_search_backtracks = 0;
+
+    void add(const InstrumentationReport &other)
+    {
+        for (size_t i = 0; i < STAGE_COUNT; i++)
+        {
+            stage_seconds[i] += other.stage_seconds[i];
+            stage_calls[i] += other.stage_calls[i];
+        }
+        for (size_t i = 0; i < RAY_STATUS_COUNT; i++)
+        {
+            rays[i] += other.rays[i];
+        }
+        root_solves += other.root_solves;
+        broyden_iterations += other.broyden_iterations;
+        function_evaluations += other.function_evaluations;
+        line_search_backtracks += other.line_search_backtracks;
+    }
+};
+
+// Compile-time switchable instrumentation (ENABLE_INSTRUMENTATION). Every thread accumulates into its own report, so
+// the hot paths never touch an atomic; collect() merges the threads and should be called after a batch or a sweep.
+// Without ENABLE_INSTRUMENTATION the macros below expand to nothing.
+class Instrumentation
+{
+#ifdef ENABLE_INSTRUMENTATION
+private:
+    inline static oneapi::tbb::enumerable_thread_specific<InstrumentationReport> locals;
+
+public:
+    static constexpr bool enabled = true;
+
+    static InstrumentationReport &local()
+    {
+        return locals.local();
+    }
+
+    static InstrumentationReport collect()
+    {
+        InstrumentationReport report;
+        for (const InstrumentationReport &local : locals)
+        {
+            report.add(local);
+        }
+        report.enabled = true;
+        return report;
+    }
+
+    static void clear()
+    {
+        for (InstrumentationReport &local : locals)
+        {
+            local = InstrumentationReport();
+        }
+    }
+#else
+public:
+    static constexpr bool enabled = false;
+
+    static InstrumentationReport collect()
+    {
+        return InstrumentationReport();
+    }
+
+    static void clear()
+    {
+    }
+#endif
+};
+
+#ifdef ENABLE_INSTRUMENTATION
+class StageTimer
+{
+private:
+    Stage stage;
+    bool running = true;
+    std::chrono::steady_clock::time_point begin;
+
+public:
+    explicit StageTimer(Stage stage_) : stage(stage_), begin(std::chrono::steady_clock::now())
+    {
+    }
+
+    void stop()
+    {
+        if (!running)
+        {
+            return;
+        }
+        running = false;
+        auto &report = Instrumentation::local();
+        report.stage_seconds[static_cast<size_t>(stage)] +=
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+        report.stage_calls[static_cast<size_t>(stage)]++;
+    }
+
+    ~StageTimer()
+    {
+        stop();
+    }
+};
+
+#define INSTRUMENT_CONCAT_IMPL(X, Y) X##Y
+#define INSTRUMENT_CONCAT(X, Y) INSTRUMENT_CONCAT_IMPL(X, Y)
+// time the rest of the enclosing scope
+#define INSTRUMENT_STAGE(STAGE) StageTimer INSTRUMENT_CONCAT(stage_timer_, __LINE__)(STAGE)
+// time a part of a scope, ends at INSTRUMENT_STAGE_STOP(NAME) or at the end of the scope
+#define INSTRUMENT_STAGE_START(NAME, STAGE) StageTimer NAME(STAGE)
+#define INSTRUMENT_STAGE_STOP(NAME) NAME.stop()
+#define INSTRUMENT_RAY(STATUS) Instrumentation::local().rays[static_cast<size_t>(STATUS)]++
+#define INSTRUMENT_COUNT(FIELD) Instrumentation::local().FIELD++
+#else
+#define INSTRUMENT_STAGE(STAGE)
+#define INSTRUMENT_STAGE_START(NAME, STAGE)
+#define INSTRUMENT_STAGE_STOP(NAME)
+#define INSTRUMENT_RAY(STATUS)
+#define INSTRUMENT_COUNT(FIELD)
+#endif
@@ -2,36 +2,40 @@
 
 #pragma once
 
+#include "Diagnostics.h"
+#include "Instrumentation.h"
+
 #define CHECK_DATA_STATUS if (this->data.ray_status != RayStatus::NORMAL) return;
 #define CHECK_VAR(VAR, COND) if (!this->check_variable(VAR, COND, #VAR)) return;
 
 template<typename Real, typename Complex>
 class Integral {
 private:
-    void print_error(const char *name, const Real &val) {
-      fmt::println(std::cerr,
-                   "[{}] a = {}, r_s = {}, theta_s {}, r_o = {}, lambda = {}, eta = {}, {} = {}, '{}' out of range",
-                   child_class_name,
-                   data.a,
-                   data.r_s,
-                   data.theta_s,
-                   data.r_o,
-                   data.lambda,
-                   data.eta, name, val, name);
+    void report_error(const char *name, const Real &val) {
+        Diagnostics::report(RayStatus::INTERNAL_ERROR, source, name, [&] {
+            return fmt::format("[{}] a = {}, r_s = {}, theta_s {}, r_o = {}, lambda = {}, eta = {}, {} = {}, '{}' out of range",
+                               child_class_name,
+                               data.a,
+                               data.r_s,
+                               data.theta_s,
+                               data.r_o,
+                               data.lambda,
+                               data.eta, name, val, name);
+        });
     }
 
 public:
     ForwardRayTracing<Real, Complex> &data;
+    // string literal naming the integral class, used as the diagnostics source
+    const char *source;
     std::string child_class_name;
 
-    explicit Integral(ForwardRayTracing<Real, Complex> &data_, std::string child_class_name_) : data(data_),
-                                                                                                child_class_name(
-                                                                                                        std::move(
-                                                                                                                child_class_name_)) {}
+    explicit Integral(ForwardRayTracing<Real, Complex> &data_, const char *source_, std::string child_class_name_)
+            : data(data_), source(source_), child_class_name(std::move(child_class_name_)) {}
 
     bool check_variable(const Real &val, bool condition, const char *name) {
         if (!condition) {
-            print_error(name, val);
+            report_error(name, val);
             data.ray_status = RayStatus::INTERNAL_ERROR;
             return false;
         } else {
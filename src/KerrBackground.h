@@ -0,0 +1,62 @@
+#pragma once
+
+#include "Common.h"
+
+#include <memory>
+#include <tuple>
+
+#ifdef TESTS
+#include <atomic>
+
+// backgrounds built so far, the tests check that a batch or a sweep of one spin only adds one
+inline std::atomic<size_t> kerr_background_builds{0};
+#endif
+
+template <typename Real>
+std::pair<Real, Real> get_rc_range(const Real &a)
+{
+    Real r_up = 2 * cos(acos(a) * third<Real>());
+    Real r_down = 2 * cos(acos(-a) * third<Real>());
+    r_up = MY_SQUARE(r_up);
+    r_down = MY_SQUARE(r_down);
+    return {r_down, r_up};
+}
+
+// Quantities that only depend on the spin a. Rays of a batch or a sweep usually share the same spin, so these are
+// computed once and shared instead of being re-evaluated for every ray. Per-spin tables belong here as well.
+template <typename Real>
+struct KerrBackground
+{
+    Real a;
+    Real a2;
+
+    // outer and inner horizon
+    Real rp, rm;
+
+    // range of the radius of spherical photon orbits
+    Real rc_down, rc_up;
+
+    explicit KerrBackground(const Real &a_) : a(a_)
+    {
+#ifdef TESTS
+        kerr_background_builds.fetch_add(1, std::memory_order_relaxed);
+#endif
+        a2 = MY_SQUARE(a);
+
+        Real sqrt_1_minus_a2 = sqrt(1 - a2);
+        rp = 1 + sqrt_1_minus_a2;
+        rm = 1 - sqrt_1_minus_a2;
+
+        std::tie(rc_down, rc_up) = get_rc_range(a);
+    }
+
+    bool matches(const Real &a_) const
+    {
+        return a == a_;
+    }
+
+    static std::shared_ptr<const KerrBackground<Real>> create(const Real &a)
+    {
+        return std::make_shared<const KerrBackground<Real>>(a);
+    }
+};
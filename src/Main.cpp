@@ -0,0 +1,476 @@
+#include "ForwardRayTracing.h"
+#include "QueryBatch.h"
+#include "QueryServer.h"
+#include "Utils.h"
+
+#include <atomic>
+#include <csignal>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+#include <boost/lexical_cast.hpp>
+#include <boost/program_options.hpp>
+#include <oneapi/tbb.h>
+
+// kerrp2p: runs rays, root solves or sweeps for parameter records read from files or stdin, or serves them to clients
+// of a Unix domain socket (serve, see QueryServer.h) until interrupted.
+//
+// A record is one line of numbers separated by spaces, tabs or commas, blank lines and lines starting with # are
+// skipped. Angles are in radians. The fields of each command are listed in QueryBatch.h, a sweep takes its grid from
+// --rc-count, --rc-margin and --lgd-*.
+//
+// Records are read, parsed, computed and written in a pipeline of batches, so parsing and writing overlap with the
+// computation and every core is busy. Output rows start with the index of their record and keep the input order.
+// With --format binary the output is native little-endian and columnar:
+//   "KERRCOLS", uint32 version, uint32 limbs, uint32 column count
+//   per column: uint8 kind (0 integer, 1 real), uint32 name length, name
+//   blocks of uint64 rows followed by every column, rows int64 or rows * limbs doubles (see FloatExpansion.h)
+
+namespace po = boost::program_options;
+
+constexpr char COLUMN_FILE_MAGIC[8] = {'K', 'E', 'R', 'R', 'C', 'O', 'L', 'S'};
+constexpr uint32_t COLUMN_FILE_VERSION = 1;
+
+struct Options {
+    QueryKind kind;
+    std::string precision = "double";
+    std::string format = "csv";
+    std::string output;
+    std::vector<std::string> inputs;
+    size_t batch_size = 0;
+    size_t tokens = 0;
+    bool calc_t_f = false;
+    std::string tol = "1e-6";
+    size_t cutoff = 50;
+    size_t rc_count = 1000;
+    std::string rc_margin = "0.05";
+    std::string lgd_min = "-10";
+    std::string lgd_max = "2";
+    size_t lgd_count = 2000;
+    std::string socket;
+    size_t sweep_cache = 8;
+};
+
+template<typename Real>
+struct Batch {
+    // index of the first record and the source of every record, for errors
+    size_t first_record = 0;
+    std::vector<std::string> lines;
+    std::vector<std::string> sources;
+    // query_record_fields values per record
+    std::vector<Real> values;
+    QueryTable<Real> table;
+};
+
+// reads records from the inputs in order, "-" is stdin
+class RecordReader {
+private:
+    std::vector<std::string> inputs;
+    size_t input_index = 0;
+    std::ifstream file;
+    std::istream *stream = nullptr;
+    size_t line_number = 0;
+
+    bool next_stream() {
+        if (input_index == inputs.size()) {
+            return false;
+        }
+        const std::string &input = inputs[input_index++];
+        line_number = 0;
+        if (input == "-") {
+            stream = &std::cin;
+            return true;
+        }
+        file = std::ifstream(input);
+        if (!file) {
+            throw std::runtime_error(fmt::format("cannot open {}", input));
+        }
+        stream = &file;
+        return true;
+    }
+
+public:
+    explicit RecordReader(std::vector<std::string> inputs) : inputs(std::move(inputs)) {
+        if (this->inputs.empty()) {
+            this->inputs.emplace_back("-");
+        }
+    }
+
+    // the next record line and where it is from, false at the end of the last input
+    bool read(std::string &line, std::string &source) {
+        while (stream || next_stream()) {
+            while (std::getline(*stream, line)) {
+                line_number++;
+                size_t begin = line.find_first_not_of(" \t\r");
+                if (begin == std::string::npos || line[begin] == '#') {
+                    continue;
+                }
+                source = fmt::format("{}:{}", inputs[input_index - 1], line_number);
+                return true;
+            }
+            stream = nullptr;
+        }
+        return false;
+    }
+};
+
+template<typename Real>
+void parse_batch(Batch<Real> &batch, size_t fields) {
+    batch.values.resize(batch.lines.size() * fields);
+    for (size_t k = 0; k < batch.lines.size(); k++) {
+        const std::string &line = batch.lines[k];
+        size_t count = 0;
+        size_t pos = 0;
+        while (true) {
+            size_t begin = line.find_first_not_of(" \t\r,", pos);
+            if (begin == std::string::npos) {
+                break;
+            }
+            size_t end = line.find_first_of(" \t\r,", begin);
+            if (end == std::string::npos) {
+                end = line.size();
+            }
+            if (count < fields) {
+                try {
+                    batch.values[k * fields + count] = boost::lexical_cast<Real>(line.substr(begin, end - begin));
+                } catch (const boost::bad_lexical_cast &) {
+                    throw std::runtime_error(fmt::format("{}: cannot parse \"{}\"", batch.sources[k],
+                                                         line.substr(begin, end - begin)));
+                }
+            }
+            count++;
+            pos = end;
+        }
+        if (count != fields) {
+            throw std::runtime_error(fmt::format("{}: expected {} fields, got {}", batch.sources[k], fields, count));
+        }
+    }
+}
+
+template<typename Real, typename Complex>
+class Driver {
+private:
+    QueryKind kind;
+    QueryOptions<Real> query_options;
+
+public:
+    explicit Driver(const Options &options) : kind(options.kind) {
+        query_options.calc_t_f = options.calc_t_f;
+        query_options.tol = boost::lexical_cast<Real>(options.tol);
+        query_options.cutoff = options.cutoff;
+        query_options.rc_count = options.rc_count;
+        query_options.rc_margin = boost::lexical_cast<Real>(options.rc_margin);
+        query_options.lgd_min = boost::lexical_cast<Real>(options.lgd_min);
+        query_options.lgd_max = boost::lexical_cast<Real>(options.lgd_max);
+        query_options.lgd_count = options.lgd_count;
+    }
+
+    void compute(Batch<Real> &batch) const {
+        parse_batch(batch, query_record_fields(kind));
+        QueryBatch<Real, Complex>::run(kind, batch.values.data(), batch.lines.size(), batch.first_record,
+                                       query_options, {}, batch.table);
+    }
+};
+
+template<typename Real>
+std::string format_real(const Real &value) {
+    if constexpr (std::is_same_v<Real, double>) {
+        return fmt::format("{}", value);
+    } else {
+        std::ostringstream oss;
+        oss << std::setprecision(std::numeric_limits<Real>::max_digits10) << value;
+        return oss.str();
+    }
+}
+
+template<typename Real>
+class TableWriter {
+private:
+    using Kind = typename QueryTable<Real>::Kind;
+    static constexpr size_t LIMBS = QueryTable<Real>::LIMBS;
+
+    std::ostream &out;
+    bool binary;
+    bool header_written = false;
+
+    void write_header(const QueryTable<Real> &table) {
+        if (binary) {
+            uint32_t version = COLUMN_FILE_VERSION;
+            uint32_t limbs = LIMBS;
+            auto column_count = static_cast<uint32_t>(table.columns.size());
+            out.write(COLUMN_FILE_MAGIC, sizeof(COLUMN_FILE_MAGIC));
+            out.write(reinterpret_cast<const char *>(&version), sizeof(version));
+            out.write(reinterpret_cast<const char *>(&limbs), sizeof(limbs));
+            out.write(reinterpret_cast<const char *>(&column_count), sizeof(column_count));
+            for (const auto &column: table.columns) {
+                auto kind = static_cast<uint8_t>(column.kind);
+                auto length = static_cast<uint32_t>(column.name.size());
+                out.write(reinterpret_cast<const char *>(&kind), sizeof(kind));
+                out.write(reinterpret_cast<const char *>(&length), sizeof(length));
+                out.write(column.name.data(), length);
+            }
+        } else {
+            std::string line;
+            for (size_t c = 0; c < table.columns.size(); c++) {
+                line += (c > 0 ? "," : "") + table.columns[c].name;
+            }
+            out << line << '\n';
+        }
+    }
+
+public:
+    TableWriter(std::ostream &out, bool binary) : out(out), binary(binary) {
+    }
+
+    void write(const QueryTable<Real> &table) {
+        if (!header_written && !table.columns.empty()) {
+            write_header(table);
+            header_written = true;
+        }
+        if (table.rows == 0) {
+            return;
+        }
+        if (binary) {
+            uint64_t rows = table.rows;
+            std::string buffer(reinterpret_cast<const char *>(&rows), sizeof(rows));
+            table.encode(buffer);
+            out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        } else {
+            std::string text;
+            for (size_t k = 0; k < table.rows; k++) {
+                for (size_t c = 0; c < table.columns.size(); c++) {
+                    const auto &column = table.columns[c];
+                    if (c > 0) {
+                        text += ',';
+                    }
+                    if (column.kind == Kind::REAL) {
+                        text += format_real(column.reals[k]);
+                    } else if (column.name == "status") {
+                        text += ray_status_to_str(static_cast<RayStatus>(column.integers[k]));
+                    } else {
+                        text += fmt::format("{}", column.integers[k]);
+                    }
+                }
+                text += '\n';
+            }
+            out << text;
+        }
+    }
+};
+
+template<typename Real, typename Complex>
+void run(const Options &options) {
+    Driver<Real, Complex> driver(options);
+    RecordReader reader(options.inputs);
+
+    std::ofstream file;
+    if (!options.output.empty() && options.output != "-") {
+        file.open(options.output, std::ios::binary);
+        if (!file) {
+            throw std::runtime_error(fmt::format("cannot open {}", options.output));
+        }
+    }
+    std::ostream &out = file.is_open() ? file : std::cout;
+    TableWriter<Real> writer(out, options.format == "binary");
+
+    size_t batch_size = options.batch_size;
+    if (batch_size == 0) {
+        batch_size = options.kind == QueryKind::RAY ? 4096 : options.kind == QueryKind::ROOT ? 64 : 1;
+    }
+    size_t tokens = options.tokens > 0 ? options.tokens : 2 * oneapi::tbb::info::default_concurrency();
+    size_t record_count = 0;
+
+    // batches are owned by their token, so those in flight are freed when a filter throws and cancels the pipeline
+    using BatchPtr = std::unique_ptr<Batch<Real>>;
+    oneapi::tbb::parallel_pipeline(
+            tokens,
+            oneapi::tbb::make_filter<void, BatchPtr>(
+                    oneapi::tbb::filter_mode::serial_in_order,
+                    [&](oneapi::tbb::flow_control &fc) -> BatchPtr {
+                        auto batch = std::make_unique<Batch<Real>>();
+                        batch->first_record = record_count;
+                        std::string line, source;
+                        while (batch->lines.size() < batch_size && reader.read(line, source)) {
+                            batch->lines.push_back(std::move(line));
+                            batch->sources.push_back(std::move(source));
+                        }
+                        if (batch->lines.empty()) {
+                            fc.stop();
+                            return nullptr;
+                        }
+                        record_count += batch->lines.size();
+                        return batch;
+                    }) &
+            oneapi::tbb::make_filter<BatchPtr, BatchPtr>(
+                    oneapi::tbb::filter_mode::parallel,
+                    [&](BatchPtr batch) -> BatchPtr {
+                        driver.compute(*batch);
+                        return batch;
+                    }) &
+            oneapi::tbb::make_filter<BatchPtr, void>(
+                    oneapi::tbb::filter_mode::serial_in_order,
+                    [&](BatchPtr batch) {
+                        writer.write(batch->table);
+                    }));
+    out.flush();
+    if (!out) {
+        throw std::runtime_error("failed to write the output");
+    }
+}
+
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+// serve queries until SIGINT or SIGTERM
+void serve(const Options &options) {
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    // the threads started from here on inherit the mask, so only sigwait sees the signals
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+    QueryServer server(options.socket, options.sweep_cache);
+    std::atomic<bool> signalled{false};
+    std::thread signal_thread([&] {
+        int signal;
+        sigwait(&signals, &signal);
+        signalled = true;
+        server.stop();
+    });
+    // however run() ends the signal thread is joined, a joinable std::thread would call std::terminate. Without a
+    // signal it is still in sigwait and woken with one of its own.
+    auto join_signal_thread = [&] {
+        if (!signalled) {
+            pthread_kill(signal_thread.native_handle(), SIGTERM);
+        }
+        signal_thread.join();
+    };
+    std::cerr << "listening on " << options.socket << '\n';
+    try {
+        server.run();
+    } catch (...) {
+        join_signal_thread();
+        throw;
+    }
+    join_signal_thread();
+}
+#endif
+
+int main(int argc, char *argv[]) {
+    Options options;
+    std::string command;
+    size_t threads = 0;
+
+    po::options_description visible("options");
+    visible.add_options()
+            ("help,h", "show this help")
+            ("precision,p", po::value(&options.precision)->default_value(options.precision),
+             "double, long_double, double_double, float128 or float256")
+            ("format,f", po::value(&options.format)->default_value(options.format), "csv or binary")
+            ("output,o", po::value(&options.output), "output file, stdout if not set")
+            ("threads,j", po::value(&threads), "worker threads, all cores if not set")
+            ("batch", po::value(&options.batch_size),
+             "records per batch, 4096 for ray, 64 for root and 1 for sweep if not set")
+            ("tokens", po::value(&options.tokens), "batches in flight, twice the threads if not set")
+            ("t-f", po::bool_switch(&options.calc_t_f), "ray: compute t_f")
+            ("tol", po::value(&options.tol)->default_value(options.tol), "root, sweep: residual tolerance")
+            ("cutoff", po::value(&options.cutoff)->default_value(options.cutoff), "sweep: candidate pairs solved")
+            ("rc-count", po::value(&options.rc_count)->default_value(options.rc_count), "sweep: rc nodes")
+            ("rc-margin", po::value(&options.rc_margin)->default_value(options.rc_margin),
+             "sweep: distance of the rc nodes from the ends of the rc range")
+            ("lgd-min", po::value(&options.lgd_min)->default_value(options.lgd_min), "sweep: first log_abs_d node")
+            ("lgd-max", po::value(&options.lgd_max)->default_value(options.lgd_max), "sweep: last log_abs_d node")
+            ("lgd-count", po::value(&options.lgd_count)->default_value(options.lgd_count), "sweep: log_abs_d nodes")
+            ("socket", po::value(&options.socket), "serve: path of the socket")
+            ("sweep-cache", po::value(&options.sweep_cache)->default_value(options.sweep_cache),
+             "serve: sweep grids whose maps are kept per precision");
+    po::options_description hidden;
+    hidden.add_options()
+            ("command", po::value(&command))
+            ("inputs", po::value(&options.inputs));
+    po::options_description all;
+    all.add(visible).add(hidden);
+    po::positional_options_description positional;
+    positional.add("command", 1).add("inputs", -1);
+
+    auto usage = [&](std::ostream &os) {
+        os << "usage: " << argv[0] << " ray|root|sweep [options] [input files, - or none for stdin]\n"
+           << "       " << argv[0] << " serve --socket PATH [options]\n" << visible;
+    };
+
+    po::variables_map vm;
+    try {
+        po::store(po::command_line_parser(argc, argv).options(all).positional(positional).run(), vm);
+        po::notify(vm);
+    } catch (const po::error &e) {
+        std::cerr << e.what() << '\n';
+        usage(std::cerr);
+        return 1;
+    }
+    if (vm.count("help")) {
+        usage(std::cout);
+        return 0;
+    }
+    bool serving = command == "serve";
+    if (command == "ray") {
+        options.kind = QueryKind::RAY;
+    } else if (command == "root") {
+        options.kind = QueryKind::ROOT;
+    } else if (command == "sweep") {
+        options.kind = QueryKind::SWEEP;
+    } else if (serving && !options.socket.empty()) {
+#if !defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+        std::cerr << "serve needs Unix domain sockets\n";
+        return 1;
+#endif
+    } else {
+        usage(std::cerr);
+        return 1;
+    }
+    if (options.format != "csv" && options.format != "binary") {
+        std::cerr << "unknown format " << options.format << '\n';
+        return 1;
+    }
+    if (!serving && options.kind == QueryKind::SWEEP && (options.rc_count < 2 || options.lgd_count < 2)) {
+        std::cerr << "a sweep needs at least 2 rc and 2 log_abs_d nodes\n";
+        return 1;
+    }
+
+    std::ios::sync_with_stdio(false);
+    std::unique_ptr<oneapi::tbb::global_control> thread_limit;
+    if (threads > 0) {
+        thread_limit = std::make_unique<oneapi::tbb::global_control>(
+                oneapi::tbb::global_control::max_allowed_parallelism, threads);
+    }
+
+    try {
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+        if (serving) {
+            // every precision is served, the one of a request is in its header
+            serve(options);
+            return 0;
+        }
+#endif
+        if (options.precision == "double") {
+            run<double, std::complex<double>>(options);
+        } else if (options.precision == "long_double") {
+            run<long double, std::complex<long double>>(options);
+        } else if (options.precision == "double_double") {
+            run<DoubleDouble, ComplexDoubleDouble>(options);
+        } else if (options.precision == "float128") {
+            run<Float128, Complex128>(options);
+        } else if (options.precision == "float256") {
+            run<Float256, Complex256>(options);
+        } else {
+            std::cerr << "unknown precision " << options.precision << '\n';
+            return 1;
+        }
+    } catch (const std::exception &e) {
+        std::cerr << e.what() << '\n';
+        return 1;
+    }
+    return 0;
+}
@@ -8,8 +8,114 @@
 #include "ForwardRayTracing.h"
 #include "Utils.h"
 
+#include <algorithm>
+#include <cfloat>
+#include <iterator>
+#include <limits>
+
 namespace py = pybind11;
 
+template<typename Real>
+using RealArray = py::array_t<Real, py::array::c_style | py::array::forcecast>;
+
+// rays traced per call of calc_ray_batch by the array entry points, bounds the memory of the full results
+constexpr size_t RAY_ARRAY_CHUNK = 65536;
+
+// Broadcast the arguments against each other by the numpy rules, as contiguous arrays of Real
+template<typename Real>
+std::vector<RealArray<Real>> broadcast_real_arrays(const py::tuple &arguments) {
+    py::object broadcast = py::module_::import("numpy").attr("broadcast_arrays")(*arguments);
+    std::vector<RealArray<Real>> arrays;
+    for (const auto &item: broadcast) {
+        arrays.push_back(py::cast<RealArray<Real>>(item));
+    }
+    return arrays;
+}
+
+// Trace the rays of broadcast arguments a, r_s, theta_s, r_o, nu_r, nu_theta followed by lambda, q or by rc,
+// log_abs_d, d_sign, with signs as positive or negative numbers. The GIL is released while tracing.
+template<typename Real, typename Complex>
+py::dict calc_ray_arrays(const py::tuple &arguments, bool from_rc_d, bool calc_t_f) {
+    std::vector<RealArray<Real>> inputs = broadcast_real_arrays<Real>(arguments);
+    std::vector<py::ssize_t> shape(inputs.front().shape(), inputs.front().shape() + inputs.front().ndim());
+    auto size = static_cast<size_t>(inputs.front().size());
+
+    RealArray<Real> theta_f(shape), phi_f(shape), t_f(shape), n_half(shape);
+    py::array_t<int32_t> m(shape);
+    py::array_t<uint8_t> status(shape);
+    std::vector<const Real *> in;
+    for (const auto &input: inputs) {
+        in.push_back(input.data());
+    }
+    Real *theta_f_data = theta_f.mutable_data();
+    Real *phi_f_data = phi_f.mutable_data();
+    Real *t_f_data = t_f.mutable_data();
+    Real *n_half_data = n_half.mutable_data();
+    int32_t *m_data = m.mutable_data();
+    uint8_t *status_data = status.mutable_data();
+
+    {
+        py::gil_scoped_release release;
+        auto to_sign = [](const Real &value) { return value > 0 ? Sign::POSITIVE : Sign::NEGATIVE; };
+        std::vector<ForwardRayTracingParams<Real>> params_list;
+        std::shared_ptr<const KerrBackground<Real>> background;
+        for (size_t begin = 0; begin < size; begin += RAY_ARRAY_CHUNK) {
+            size_t end = std::min(size, begin + RAY_ARRAY_CHUNK);
+            params_list.resize(end - begin);
+            // a chunk may mix spins, each run of rays with one spin shares a background
+            for (size_t i = begin; i < end; i++) {
+                if (!background || !background->matches(in[0][i])) {
+                    background = KerrBackground<Real>::create(in[0][i]);
+                }
+                params_list[i - begin].background = background;
+            }
+            oneapi::tbb::parallel_for(oneapi::tbb::blocked_range<size_t>(begin, end),
+                                      [&](const oneapi::tbb::blocked_range<size_t> &r) {
+                                          for (size_t i = r.begin(); i != r.end(); ++i) {
+                                              auto &params = params_list[i - begin];
+                                              params.a = in[0][i];
+                                              params.r_s = in[1][i];
+                                              params.theta_s = in[2][i];
+                                              params.r_o = in[3][i];
+                                              params.nu_r = to_sign(in[4][i]);
+                                              params.nu_theta = to_sign(in[5][i]);
+                                              params.calc_t_f = calc_t_f;
+                                              params.print_args_error = false;
+                                              if (from_rc_d) {
+                                                  params.rc = in[6][i];
+                                                  params.log_abs_d = in[7][i];
+                                                  params.d_sign = to_sign(in[8][i]);
+                                                  params.rc_d_to_lambda_q();
+                                              } else {
+                                                  params.lambda = in[6][i];
+                                                  params.q = in[7][i];
+                                              }
+                                          }
+                                      });
+
+            auto results = ForwardRayTracingUtils<Real, Complex>::calc_ray_batch(params_list);
+            for (size_t i = begin; i < end; i++) {
+                const auto &result = results[i - begin];
+                theta_f_data[i] = result.theta_f;
+                phi_f_data[i] = result.phi_f;
+                t_f_data[i] = result.t_f;
+                n_half_data[i] = result.n_half;
+                m_data[i] = result.m;
+                status_data[i] = static_cast<uint8_t>(result.ray_status);
+            }
+        }
+    }
+
+    py::dict result;
+    result["theta_f"] = theta_f;
+    result["phi_f"] = phi_f;
+    result["t_f"] = t_f;
+    result["n_half"] = n_half;
+    result["m"] = m;
+    result["status"] = status;
+    return result;
+}
+
 template<typename Real, typename Complex>
 void define_sweep_result(pybind11::module_ &mod, const char *name) {
     using SweepR = SweepResult<Real, Complex>;
@@ -20,10 +126,79 @@ void define_sweep_result(pybind11::module_ &mod, const char *name) {
             .def_readonly("eta", &SweepR::eta)
             .def_readonly("delta_theta", &SweepR::delta_theta)
             .def_readonly("delta_phi", &SweepR::delta_phi)
+            .def_readonly("status", &SweepR::status)
             .def_readonly("theta_roots", &SweepR::theta_roots)
             .def_readonly("phi_roots", &SweepR::phi_roots)
             .def_readonly("theta_roots_closest", &SweepR::theta_roots_closest)
-            .def_readonly("results", &SweepR::results);
+            .def_readonly("results", &SweepR::results)
+            .def_readonly("status_count", &SweepR::status_count)
+            .def_readonly("classified_count", &SweepR::classified_count);
+}
+
+// read-only numpy view into the mapping of a SweepFile, which owner keeps alive
+py::array sweep_file_view(const py::object &owner, const SweepFile::MapView &view) {
+    py::array array(py::dtype::of<double>(),
+                    {static_cast<py::ssize_t>(view.rows()), static_cast<py::ssize_t>(view.cols())},
+                    {static_cast<py::ssize_t>(view.outerStride() * sizeof(double)),
+                     static_cast<py::ssize_t>(view.innerStride() * sizeof(double))},
+                    view.data(), owner);
+    array.attr("flags").attr("writeable") = false;
+    return array;
+}
+
+void define_sweep_file(pybind11::module_ &mod) {
+    py::class_<SweepFile>(mod, "SweepFile")
+            .def(py::init<const std::string &>(), py::arg("path"))
+            .def_property_readonly("rows", &SweepFile::rows)
+            .def_property_readonly("cols", &SweepFile::cols)
+            .def_property_readonly("limbs", &SweepFile::limbs)
+            .def_property_readonly("precision", &SweepFile::precision)
+            .def_property_readonly("tile_rows", &SweepFile::tile_rows)
+            .def_property_readonly("tile_count", &SweepFile::tile_count)
+            .def("map", [](const py::object &self, const std::string &name, size_t limb) {
+                     return sweep_file_view(self, self.cast<const SweepFile &>().map(sweep_map_from_name(name), limb));
+                 },
+                 py::arg("name"), py::arg("limb") = 0)
+            .def("tile", [](const py::object &self, const std::string &name, size_t tile_index, size_t limb) {
+                     const auto &sweep_file = self.cast<const SweepFile &>();
+                     if (tile_index >= sweep_file.tile_count()) {
+                         throw py::index_error(fmt::format("tile {} out of range", tile_index));
+                     }
+                     return sweep_file_view(self, sweep_file.tile(sweep_map_from_name(name), tile_index, limb));
+                 },
+                 py::arg("name"), py::arg("tile"), py::arg("limb") = 0)
+            .def("status", [](const py::object &self) {
+                const auto &sweep_file = self.cast<const SweepFile &>();
+                py::array array(py::dtype::of<uint8_t>(),
+                                {static_cast<py::ssize_t>(sweep_file.rows()),
+                                 static_cast<py::ssize_t>(sweep_file.cols())},
+                                sweep_file.status().data(), self);
+                array.attr("flags").attr("writeable") = false;
+                return array;
+            })
+            .def("rc_list", [](const SweepFile &self) { return self.rc_list<double>(); })
+            .def("lgd_list", [](const SweepFile &self) { return self.lgd_list<double>(); });
+}
+
+void define_sweep_cache(pybind11::module_ &mod) {
+    py::class_<SweepCache>(mod, "SweepCache")
+            .def(py::init<const std::string &, uintmax_t>(), py::arg("directory"),
+                 py::arg("max_bytes") = uintmax_t(16) << 30)
+            .def("evict", &SweepCache::evict)
+            .def("clear", &SweepCache::clear)
+            .def("size_bytes", &SweepCache::size_bytes);
+}
+
+template<typename Real>
+void define_kerr_background(pybind11::module_ &mod, const char *name) {
+    using Background = KerrBackground<Real>;
+    py::class_<Background>(mod, name)
+            .def(py::init<const Real &>())
+            .def_readonly("a", &Background::a)
+            .def_readonly("rp", &Background::rp)
+            .def_readonly("rm", &Background::rm)
+            .def_readonly("rc_down", &Background::rc_down)
+            .def_readonly("rc_up", &Background::rc_up);
 }
 
 template<typename Real>
@@ -44,7 +219,8 @@ void define_params(pybind11::module_ &mod, const char *name) {
             .def_readwrite("q", &Params::q)
             .def_readwrite("calc_t_f", &Params::calc_t_f)
             .def_readwrite("print_args_error", &Params::print_args_error)
-            .def("rc_d_to_lambda_q", &Params::rc_d_to_lambda_q);
+            .def("rc_d_to_lambda_q", &Params::rc_d_to_lambda_q)
+            .def("get_background", &Params::get_background, py::return_value_policy::copy);
 }
 
 template<typename Real, typename Complex>
@@ -84,9 +260,64 @@ void define_find_root_result(pybind11::module_ &mod, const char *name) {
     py::class_<ResultType>(mod, name)
             .def_readonly("success", &ResultType::success)
             .def_readonly("fail_reason", &ResultType::fail_reason)
+            .def_readonly("ray_status", &ResultType::ray_status)
             .def_readonly("root", &ResultType::root);
 }
 
+void define_diagnostics(pybind11::module_ &mod) {
+    py::class_<DiagnosticCount>(mod, "DiagnosticCount")
+            .def_readonly("status", &DiagnosticCount::status)
+            .def_readonly("source", &DiagnosticCount::source)
+            .def_readonly("variable", &DiagnosticCount::variable)
+            .def_readonly("count", &DiagnosticCount::count);
+    py::class_<DiagnosticRecord>(mod, "DiagnosticRecord")
+            .def_readonly("status", &DiagnosticRecord::status)
+            .def_readonly("source", &DiagnosticRecord::source)
+            .def_readonly("variable", &DiagnosticRecord::variable)
+            .def_readonly("detail", &DiagnosticRecord::detail);
+    py::class_<DiagnosticsReport>(mod, "DiagnosticsReport")
+            .def_readonly("counts", &DiagnosticsReport::counts)
+            .def_readonly("records", &DiagnosticsReport::records)
+            .def("total", &DiagnosticsReport::total);
+    mod.def("get_diagnostics", &Diagnostics::collect);
+    mod.def("clear_diagnostics", &Diagnostics::clear);
+    mod.def("set_diagnostics_sampling", &Diagnostics::set_sampling, py::arg("every"),
+            py::arg("max_records_per_thread") = 64);
+}
+
+void define_instrumentation(pybind11::module_ &mod) {
+    mod.def("get_instrumentation", []() {
+        InstrumentationReport report = Instrumentation::collect();
+        py::dict stages;
+        for (size_t i = 0; i < STAGE_COUNT; i++) {
+            py::dict stage;
+            stage["seconds"] = report.stage_seconds[i];
+            stage["calls"] = report.stage_calls[i];
+            stages[stage_to_str(static_cast<Stage>(i))] = stage;
+        }
+        py::dict rays;
+        for (size_t i = 0; i < RAY_STATUS_COUNT; i++) {
+            rays[ray_status_to_str(static_cast<RayStatus>(i))] = report.rays[i];
+        }
+        py::dict result;
+        result["enabled"] = report.enabled;
+        result["stages"] = stages;
+        result["rays"] = rays;
+        result["root_solves"] = report.root_solves;
+        result["broyden_iterations"] = report.broyden_iterations;
+        result["function_evaluations"] = report.function_evaluations;
+        result["line_search_backtracks"] = report.line_search_backtracks;
+        return result;
+    });
+    mod.def("clear_instrumentation", &Instrumentation::clear);
+}
+
+void define_tracing(pybind11::module_ &mod) {
+    mod.def("start_tracing", &Tracing::start);
+    mod.def("stop_tracing", &Tracing::stop);
+    mod.def("write_chrome_trace", &Tracing::write_chrome_trace, py::arg("path"));
+}
+
 template<typename Real, typename Complex>
 void define_methods(pybind11::module_ &mod, const std::string &suffix) {
     mod.def(("calc_ray" + suffix).c_str(), &ForwardRayTracingUtils<Real, Complex>::calc_ray,
@@ -103,17 +334,319 @@ void define_methods(pybind11::module_ &mod, const std::string &suffix) {
             py::call_guard<py::gil_scoped_release>(), py::return_value_policy::move);
         mod.def(("sweep_rc_d_high" + suffix).c_str(), &ForwardRayTracingUtils<Real, Complex>::sweep_rc_d_high,
             py::call_guard<py::gil_scoped_release>(), py::return_value_policy::move);
+        mod.def(("sweep_rc_d_streaming" + suffix).c_str(),
+                [](const ForwardRayTracingParams<Real> &params, Real theta_o, Real phi_o, const std::vector<Real> &rc_list,
+                   const std::vector<Real> &lgd_list, size_t cutoff, Real tol, size_t band_rows,
+                   const std::string &spill_path, bool resume) {
+                    SweepStreamSettings<Real> settings;
+                    settings.band_rows = band_rows;
+                    settings.spill_path = spill_path;
+                    settings.resume = resume;
+                    return ForwardRayTracingUtils<Real, Complex>::sweep_rc_d_streaming(params, theta_o, phi_o, rc_list,
+                                                                                      lgd_list, cutoff, tol, settings);
+                },
+                py::arg("params"), py::arg("theta_o"), py::arg("phi_o"), py::arg("rc_list"), py::arg("lgd_list"),
+                py::arg("cutoff"), py::arg("tol"), py::arg("band_rows") = 256, py::arg("spill_path") = "",
+                py::arg("resume") = false,
+                py::call_guard<py::gil_scoped_release>(), py::return_value_policy::move);
+        mod.def(("sweep_rc_d_sparse" + suffix).c_str(), &ForwardRayTracingUtils<Real, Complex>::sweep_rc_d_sparse,
+                py::arg("params"), py::arg("theta_o"), py::arg("phi_o"), py::arg("rc_list"), py::arg("lgd_list"),
+                py::arg("cutoff"), py::arg("tol"), py::arg("strip_cols") = 64,
+                py::call_guard<py::gil_scoped_release>(), py::return_value_policy::move);
+        mod.def(("sweep_rc_d_cached" + suffix).c_str(), &ForwardRayTracingUtils<Real, Complex>::sweep_rc_d_cached,
+                py::arg("params"), py::arg("theta_o"), py::arg("phi_o"), py::arg("rc_list"), py::arg("lgd_list"),
+                py::arg("cutoff"), py::arg("tol"), py::arg("cache"),
+                py::call_guard<py::gil_scoped_release>(), py::return_value_policy::move);
+        mod.def(("sweep_rc_d_extend" + suffix).c_str(),
+                [](const ForwardRayTracingParams<Real> &params, Real theta_o, Real phi_o, const std::vector<Real> &rc_list,
+                   const std::vector<Real> &lgd_list, size_t cutoff, Real tol,
+                   const SweepResult<Real, Complex> &previous, const std::vector<Real> &previous_rc_list,
+                   const std::vector<Real> &previous_lgd_list) {
+                    return ForwardRayTracingUtils<Real, Complex>::sweep_rc_d_extend(params, theta_o, phi_o, rc_list,
+                                                                                   lgd_list, cutoff, tol, previous,
+                                                                                   previous_rc_list,
+                                                                                   previous_lgd_list);
+                },
+                py::arg("params"), py::arg("theta_o"), py::arg("phi_o"), py::arg("rc_list"), py::arg("lgd_list"),
+                py::arg("cutoff"), py::arg("tol"), py::arg("previous"), py::arg("previous_rc_list"),
+                py::arg("previous_lgd_list"), py::call_guard<py::gil_scoped_release>(),
+                py::return_value_policy::move);
+        mod.def(("sweep_rc_d_extend" + suffix).c_str(),
+                [](const SweepFile &previous, const std::vector<Real> &rc_list, const std::vector<Real> &lgd_list,
+                   size_t cutoff, Real tol) {
+                    return ForwardRayTracingUtils<Real, Complex>::sweep_rc_d_extend(previous, rc_list, lgd_list, cutoff,
+                                                                                   tol);
+                },
+                py::arg("previous"), py::arg("rc_list"), py::arg("lgd_list"), py::arg("cutoff"), py::arg("tol"),
+                py::call_guard<py::gil_scoped_release>(), py::return_value_policy::move);
+        mod.def(("write_sweep_file" + suffix).c_str(),
+                [](const std::string &path, const SweepResult<Real, Complex> &sweep_result,
+                   const ForwardRayTracingParams<Real> &params, Real theta_o, Real phi_o,
+                   const std::vector<Real> &rc_list, const std::vector<Real> &lgd_list) {
+                    write_sweep_file(path, sweep_result, params, theta_o, phi_o, rc_list, lgd_list);
+                },
+                py::arg("path"), py::arg("sweep_result"), py::arg("params"), py::arg("theta_o"), py::arg("phi_o"),
+                py::arg("rc_list"), py::arg("lgd_list"), py::call_guard<py::gil_scoped_release>());
+        mod.def(("read_sweep_file" + suffix).c_str(),
+                [](const std::string &path) {
+                    SweepFile sweep_file(path);
+                    SweepResult<Real, Complex> sweep_result;
+                    for (auto *map: {&sweep_result.theta, &sweep_result.phi, &sweep_result.lambda, &sweep_result.eta,
+                                     &sweep_result.delta_theta, &sweep_result.delta_phi}) {
+                        map->resize(sweep_file.rows(), sweep_file.cols());
+                    }
+                    sweep_result.status.resize(sweep_file.rows(), sweep_file.cols());
+                    sweep_file.read_rows(sweep_result, 0, sweep_file.rows());
+                    return sweep_result;
+                },
+                py::arg("path"), py::call_guard<py::gil_scoped_release>(), py::return_value_policy::move);
+    }
+}
+
+// Bulk conversions for the precisions numpy has no dtype of, without decimal strings. Arrays hold every value as a
+// double expansion (see FloatExpansion.h), a last axis of double_expansion_size<Real> float64 parts, hi first.
+template<typename Real>
+py::array_t<double> to_expansion_array(const std::vector<Real> &values) {
+    constexpr size_t N = double_expansion_size<Real>;
+    py::array_t<double> array({static_cast<py::ssize_t>(values.size()), static_cast<py::ssize_t>(N)});
+    double *data = array.mutable_data();
+    py::gil_scoped_release release;
+    for (size_t k = 0; k < values.size(); k++) {
+        auto parts = to_double_expansion<N>(values[k]);
+        std::copy(parts.begin(), parts.end(), data + k * N);
+    }
+    return array;
+}
+
+template<typename Real>
+std::vector<Real> from_expansion_array(const RealArray<double> &array) {
+    constexpr size_t N = double_expansion_size<Real>;
+    if (array.ndim() == 0 || array.shape(array.ndim() - 1) != static_cast<py::ssize_t>(N)) {
+        throw py::value_error(fmt::format("expected a last axis of {} parts", N));
+    }
+    std::vector<Real> values(static_cast<size_t>(array.size()) / N);
+    const double *data = array.data();
+    py::gil_scoped_release release;
+    for (size_t k = 0; k < values.size(); k++) {
+        values[k] = from_double_expansion<Real, N>(data + k * N);
+    }
+    return values;
+}
+
+template<typename Real>
+py::array_t<double> to_float64_array(const std::vector<Real> &values) {
+    py::array_t<double> array(static_cast<py::ssize_t>(values.size()));
+    double *data = array.mutable_data();
+    py::gil_scoped_release release;
+    for (size_t k = 0; k < values.size(); k++) {
+        data[k] = static_cast<double>(values[k]);
     }
+    return array;
+}
+
+template<typename Real>
+std::vector<Real> from_float64_array(const RealArray<double> &array) {
+    std::vector<Real> values(static_cast<size_t>(array.size()));
+    const double *data = array.data();
+    py::gil_scoped_release release;
+    for (size_t k = 0; k < values.size(); k++) {
+        values[k] = data[k];
+    }
+    return values;
+}
+
+// Exact (man, exp) pairs with value man * 2**exp, as taken by mpmath.mpf, zeros and non-finite values as floats
+template<typename Real>
+py::list to_mpmath_pairs(const std::vector<Real> &values) {
+    constexpr size_t N = double_expansion_size<Real>;
+    py::list pairs(values.size());
+    for (size_t k = 0; k < values.size(); k++) {
+        auto parts = to_double_expansion<N>(values[k]);
+        if (parts[0] == 0 || !std::isfinite(parts[0])) {
+            // keeps the sign of -0, which mpmath has no pair for
+            pairs[k] = py::float_(parts[0]);
+            continue;
+        }
+        BinaryFraction fraction = to_binary_fraction(parts);
+        py::object man = py::int_(0).attr("from_bytes")(py::bytes(magnitude_to_bytes(fraction.magnitude)), "little");
+        if (fraction.negative) {
+            man = -man;
+        }
+        pairs[k] = py::make_tuple(man, fraction.exponent);
+    }
+    return pairs;
+}
+
+// From mpmath.mpf values, (man, exp) pairs or floats, rounded to Real. The value goes through doubles, so values beyond
+// the range of double become inf or zero.
+template<typename Real>
+std::vector<Real> from_mpmath_values(const py::sequence &items) {
+    std::vector<Real> values(items.size());
+    py::int_ zero(0);
+    for (size_t k = 0; k < values.size(); k++) {
+        py::object item = items[k];
+        py::object man;
+        py::object exp;
+        if (py::hasattr(item, "_mpf_")) {
+            // (sign, man, exp, bc) with an unsigned man, which mpf.man also is in recent versions
+            auto mpf = item.attr("_mpf_").cast<py::tuple>();
+            man = py::int_(mpf[1]);
+            if (man.equal(zero)) {
+                // zero, inf or nan
+                values[k] = item.attr("__float__")().cast<double>();
+                continue;
+            }
+            if (py::int_(mpf[0]).cast<int>() != 0) {
+                man = -man;
+            }
+            exp = py::int_(mpf[2]);
+        } else if (py::isinstance<py::tuple>(item)) {
+            auto pair = item.cast<py::tuple>();
+            man = py::int_(pair[0]);
+            exp = py::int_(pair[1]);
+        } else {
+            values[k] = item.cast<double>();
+            continue;
+        }
+
+        if (man.equal(zero)) {
+            values[k] = 0;
+            continue;
+        }
+        // exp is unbounded, values outside the range of double become inf or zero before it is narrowed
+        bool negative = man < zero;
+        py::object magnitude = negative ? -man : man;
+        py::object bits = magnitude.attr("bit_length")();
+        py::object top_exponent = exp + bits;
+        if (top_exponent > py::int_(DBL_MAX_EXP)) {
+            values[k] = negative ? -std::numeric_limits<double>::infinity() : std::numeric_limits<double>::infinity();
+            continue;
+        }
+        if (top_exponent < py::int_(DBL_MIN_EXP - DBL_MANT_DIG)) {
+            values[k] = negative ? -0.0 : 0.0;
+            continue;
+        }
+        auto length = (bits.cast<size_t>() + 7) / 8;
+        auto bytes = magnitude.attr("to_bytes")(length, "little").cast<std::string>();
+        BinaryFraction fraction;
+        fraction.negative = negative;
+        fraction.magnitude = magnitude_from_bytes(reinterpret_cast<const unsigned char *>(bytes.data()), bytes.size());
+        fraction.exponent = exp.cast<long>();
+        values[k] = from_binary_fraction<Real>(fraction);
+    }
+    return values;
+}
+
+// the rays of a batch as a dict of expansion arrays, m as int32 and status as uint8
+template<typename Real, typename Complex>
+py::dict ray_results_to_arrays(const std::vector<ForwardRayTracingResult<Real, Complex>> &results) {
+    constexpr size_t N = double_expansion_size<Real>;
+    auto count = static_cast<py::ssize_t>(results.size());
+    const char *names[] = {"theta_f", "phi_f", "t_f", "n_half", "lam", "q", "eta", "rc", "log_abs_d"};
+    std::vector<py::array_t<double>> reals;
+    std::vector<double *> real_data;
+    for (size_t c = 0; c < std::size(names); c++) {
+        reals.emplace_back(std::vector<py::ssize_t>{count, static_cast<py::ssize_t>(N)});
+        real_data.push_back(reals.back().mutable_data());
+    }
+    py::array_t<int32_t> m(count);
+    py::array_t<uint8_t> status(count);
+    int32_t *m_data = m.mutable_data();
+    uint8_t *status_data = status.mutable_data();
+    {
+        py::gil_scoped_release release;
+        for (size_t k = 0; k < results.size(); k++) {
+            const auto &res = results[k];
+            const Real *row[] = {&res.theta_f, &res.phi_f, &res.t_f, &res.n_half, &res.lambda, &res.q, &res.eta,
+                                 &res.rc, &res.log_abs_d};
+            for (size_t c = 0; c < std::size(row); c++) {
+                auto parts = to_double_expansion<N>(*row[c]);
+                std::copy(parts.begin(), parts.end(), real_data[c] + k * N);
+            }
+            m_data[k] = res.m;
+            status_data[k] = static_cast<uint8_t>(res.ray_status);
+        }
+    }
+    py::dict arrays;
+    for (size_t c = 0; c < std::size(names); c++) {
+        arrays[names[c]] = reals[c];
+    }
+    arrays["m"] = m;
+    arrays["status"] = status;
+    return arrays;
+}
+
+template<typename Real, typename Complex>
+void define_conversion_methods(pybind11::module_ &mod, const std::string &suffix) {
+    mod.def(("to_expansion" + suffix).c_str(), &to_expansion_array<Real>, py::arg("values"));
+    mod.def(("from_expansion" + suffix).c_str(), &from_expansion_array<Real>, py::arg("array"));
+    mod.def(("to_float64" + suffix).c_str(), &to_float64_array<Real>, py::arg("values"));
+    mod.def(("from_float64" + suffix).c_str(), &from_float64_array<Real>, py::arg("array"));
+    mod.def(("to_mpmath" + suffix).c_str(), &to_mpmath_pairs<Real>, py::arg("values"));
+    mod.def(("from_mpmath" + suffix).c_str(), &from_mpmath_values<Real>, py::arg("values"));
+    mod.def(("ray_results_to_arrays" + suffix).c_str(), &ray_results_to_arrays<Real, Complex>, py::arg("results"));
+#ifdef FLOAT128_NATIVE
+    if constexpr (std::is_same_v<Real, Float128>) {
+        // IEEE binary128 values as a 16-byte void dtype, the layout of __float128 and numpy.dtype("V16")
+        mod.def("to_binary128", [](const std::vector<Float128> &values) {
+            py::array array(py::dtype("V16"), static_cast<py::ssize_t>(values.size()));
+            auto *data = static_cast<char *>(array.mutable_data());
+            for (size_t k = 0; k < values.size(); k++) {
+                to_binary128(values[k], data + k * BINARY128_SIZE);
+            }
+            return array;
+        }, py::arg("values"));
+        mod.def("from_binary128", [](const py::array &array) {
+            if (array.itemsize() != BINARY128_SIZE) {
+                throw py::value_error(fmt::format("expected items of {} bytes", BINARY128_SIZE));
+            }
+            py::array contiguous = py::module_::import("numpy").attr("ascontiguousarray")(array);
+            std::vector<Float128> values(static_cast<size_t>(contiguous.size()));
+            const auto *data = static_cast<const char *>(contiguous.data());
+            for (size_t k = 0; k < values.size(); k++) {
+                values[k] = from_binary128(data + k * BINARY128_SIZE);
+            }
+            return values;
+        }, py::arg("array"));
+    }
+#endif
+}
+
+// numpy entry points, for the precisions numpy has a dtype of
+template<typename Real, typename Complex>
+void define_array_methods(pybind11::module_ &mod, const std::string &suffix) {
+    mod.def(("calc_ray_lambda_q_array" + suffix).c_str(),
+            [](const py::object &a, const py::object &r_s, const py::object &theta_s, const py::object &r_o,
+               const py::object &nu_r, const py::object &nu_theta, const py::object &lam, const py::object &q,
+               bool calc_t_f) {
+                return calc_ray_arrays<Real, Complex>(py::make_tuple(a, r_s, theta_s, r_o, nu_r, nu_theta, lam, q),
+                                                      false, calc_t_f);
+            },
+            py::arg("a"), py::arg("r_s"), py::arg("theta_s"), py::arg("r_o"), py::arg("nu_r"), py::arg("nu_theta"),
+            py::arg("lam"), py::arg("q"), py::arg("calc_t_f") = false);
+    mod.def(("calc_ray_rc_d_array" + suffix).c_str(),
+            [](const py::object &a, const py::object &r_s, const py::object &theta_s, const py::object &r_o,
+               const py::object &nu_r, const py::object &nu_theta, const py::object &rc, const py::object &log_abs_d,
+               const py::object &d_sign, bool calc_t_f) {
+                return calc_ray_arrays<Real, Complex>(
+                        py::make_tuple(a, r_s, theta_s, r_o, nu_r, nu_theta, rc, log_abs_d, d_sign), true, calc_t_f);
+            },
+            py::arg("a"), py::arg("r_s"), py::arg("theta_s"), py::arg("r_o"), py::arg("nu_r"), py::arg("nu_theta"),
+            py::arg("rc"), py::arg("log_abs_d"), py::arg("d_sign"), py::arg("calc_t_f") = false);
 }
 
 template<typename Real, typename Complex>
 void define_all(pybind11::module_ &mod, const std::string &suffix) {
     define_methods<Real, Complex>(mod, "_" + suffix);
+    define_kerr_background<Real>(mod, ("KerrBackground" + suffix).c_str());
     define_params<Real>(mod, ("ForwardRayTracingParams" + suffix).c_str());
     define_forward_ray_tracing_result<Real, Complex>(mod, ("ForwardRayTracing" + suffix).c_str());
     define_find_root_result<Real, Complex>(mod, ("FindRootResult" + suffix).c_str());
     if constexpr (std::is_same_v<Real, double> || std::is_same_v<Real, long double>) {
         define_sweep_result<Real, Complex>(mod, ("SweepResult" + suffix).c_str());
+        define_array_methods<Real, Complex>(mod, "_" + suffix);
+    } else {
+        define_conversion_methods<Real, Complex>(mod, "_" + suffix);
     }
 }
 
@@ -181,9 +714,19 @@ PYBIND11_MODULE(pykerrp2p, mod) {
             .value("NEGATIVE", Sign::NEGATIVE)
             .export_values();
 
+    define_diagnostics(mod);
+    define_instrumentation(mod);
+    define_tracing(mod);
+    define_sweep_file(mod);
+    define_sweep_cache(mod);
+
     define_all<double, std::complex<double>>(mod, "Float64");
     define_all<long double, std::complex<long double>>(mod, "LongDouble");
 
+    define_numerical_type<DoubleDouble>(mod, "DoubleDouble", false);
+    define_numerical_type<ComplexDoubleDouble>(mod, "ComplexDoubleDouble", true);
+    define_all<DoubleDouble, ComplexDoubleDouble>(mod, "DoubleDouble");
+
     define_numerical_type<Float128>(mod, "Float128", false);
     define_numerical_type<Complex128>(mod, "Complex128", true);
     define_all<Float128, Complex128>(mod, "Float128");
@@ -194,10 +737,17 @@ PYBIND11_MODULE(pykerrp2p, mod) {
 
     mod.attr("calc_ray") = mod.attr("calc_ray_Float64");
     mod.attr("calc_ray_batch") = mod.attr("calc_ray_batch_Float64");
+    mod.attr("calc_ray_lambda_q_array") = mod.attr("calc_ray_lambda_q_array_Float64");
+    mod.attr("calc_ray_rc_d_array") = mod.attr("calc_ray_rc_d_array_Float64");
     mod.attr("sweep_rc_d") = mod.attr("sweep_rc_d_Float64");
+    mod.attr("sweep_rc_d_streaming") = mod.attr("sweep_rc_d_streaming_Float64");
+    mod.attr("sweep_rc_d_sparse") = mod.attr("sweep_rc_d_sparse_Float64");
+    mod.attr("sweep_rc_d_cached") = mod.attr("sweep_rc_d_cached_Float64");
+    mod.attr("sweep_rc_d_extend") = mod.attr("sweep_rc_d_extend_Float64");
     mod.attr("find_root_period") = mod.attr("find_root_period_Float64");
     mod.attr("find_root") = mod.attr("find_root_Float64");
     mod.attr("clean_cache") = mod.attr("clean_cache_Float64");
+    mod.attr("KerrBackground") = mod.attr("KerrBackgroundFloat64");
     mod.attr("ForwardRayTracingParams") = mod.attr("ForwardRayTracingParamsFloat64");
     mod.attr("ForwardRayTracing") = mod.attr("ForwardRayTracingFloat64");
     mod.attr("FindRootResult") = mod.attr("FindRootResultFloat64");
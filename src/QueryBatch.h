@@ -0,0 +1,378 @@
+#pragma once
+
+#include "Utils.h"
+#include "FloatExpansion.h"
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <string>
+#include <vector>
+
+// Batches of rays, root solves and sweeps given as flat records of numbers, with their results as a table of columns.
+// The command line driver (Main.cpp) and the query server (QueryServer.h) share it, so both take the same records and
+// return the same columns. A record holds
+//   ray    a r_s theta_s r_o nu_r nu_theta rc log_abs_d d_sign
+//   root   a r_s theta_s r_o nu_r nu_theta rc log_abs_d d_sign theta_o phi_o    (rc, log_abs_d are the seed)
+//   sweep  a r_s theta_s r_o nu_r nu_theta d_sign theta_o phi_o               (grid from QueryOptions)
+// with signs as any positive or negative number. Every table starts with the index of the record of each row.
+
+enum class QueryKind : uint8_t
+{
+    RAY = 1,
+    ROOT = 2,
+    SWEEP = 3,
+};
+
+constexpr size_t query_record_fields(QueryKind kind)
+{
+    switch (kind)
+    {
+    case QueryKind::RAY:
+        return 9;
+    case QueryKind::ROOT:
+        return 11;
+    case QueryKind::SWEEP:
+        return 9;
+    }
+    return 0;
+}
+
+template <typename Real>
+struct QueryOptions
+{
+    // ray: compute t_f
+    bool calc_t_f = false;
+    // root, sweep: residual tolerance
+    Real tol = 1e-6;
+    // sweep: candidate pairs solved and the grid, rc_count nodes over the rc range of the spin shrunk by rc_margin on
+    // both ends and lgd_count nodes over [lgd_min, lgd_max]
+    size_t cutoff = 50;
+    size_t rc_count = 1000;
+    Real rc_margin = 0.05;
+    Real lgd_min = -10;
+    Real lgd_max = 2;
+    size_t lgd_count = 2000;
+
+    std::vector<Real> rc_list(const Real &a) const
+    {
+        auto [rc_down, rc_up] = get_rc_range(a);
+        rc_down += rc_margin;
+        rc_up -= rc_margin;
+        std::vector<Real> list(rc_count);
+        for (size_t i = 0; i < list.size(); i++)
+        {
+            list[i] = rc_down + (rc_up - rc_down) * i / (list.size() - 1.);
+        }
+        return list;
+    }
+
+    std::vector<Real> lgd_list() const
+    {
+        std::vector<Real> list(lgd_count);
+        for (size_t i = 0; i < list.size(); i++)
+        {
+            list[i] = lgd_min + (lgd_max - lgd_min) * i / (list.size() - 1.);
+        }
+        return list;
+    }
+};
+
+// a block of result rows, column by column
+template <typename Real>
+struct QueryTable
+{
+    enum class Kind : uint8_t
+    {
+        INTEGER = 0,
+        REAL = 1,
+    };
+
+    struct Column
+    {
+        std::string name;
+        Kind kind;
+        // integer columns named status hold a RayStatus
+        std::vector<int64_t> integers;
+        std::vector<Real> reals;
+    };
+
+    static constexpr size_t LIMBS = double_expansion_size<Real>;
+
+    std::vector<Column> columns;
+    size_t rows = 0;
+
+    size_t add_column(std::string name, Kind kind)
+    {
+        columns.push_back({std::move(name), kind, {}, {}});
+        return columns.size() - 1;
+    }
+
+    void resize(size_t row_count)
+    {
+        rows = row_count;
+        for (auto &column : columns)
+        {
+            if (column.kind == Kind::INTEGER)
+            {
+                column.integers.resize(rows);
+            }
+            else
+            {
+                column.reals.resize(rows, std::numeric_limits<Real>::quiet_NaN());
+            }
+        }
+    }
+
+    // Append the columns one after another to buffer, integers as int64 and reals as double expansions of LIMBS
+    // parts, native byte order
+    void encode(std::string &buffer) const
+    {
+        for (const auto &column : columns)
+        {
+            if (column.kind == Kind::INTEGER)
+            {
+                buffer.append(reinterpret_cast<const char *>(column.integers.data()), rows * sizeof(int64_t));
+                continue;
+            }
+            for (const Real &value : column.reals)
+            {
+                auto parts = to_double_expansion<LIMBS>(value);
+                buffer.append(reinterpret_cast<const char *>(parts.data()), sizeof(parts));
+            }
+        }
+    }
+};
+
+template <typename Real, typename Complex>
+struct QueryContext
+{
+    // called on the params of every record before anything else, e.g. to attach a cached background
+    std::function<void(ForwardRayTracingParams<Real> &)> prepare;
+    // runs one sweep, sweep_rc_d_sparse if not set
+    std::function<SweepResult<Real, Complex>(const ForwardRayTracingParams<Real> &, const Real &, const Real &,
+                                             const std::vector<Real> &, const std::vector<Real> &, size_t,
+                                             const Real &)>
+        sweep;
+};
+
+template <typename Real, typename Complex>
+class QueryBatch
+{
+private:
+    using Utils = ForwardRayTracingUtils<Real, Complex>;
+    using Table = QueryTable<Real>;
+    using Kind = typename Table::Kind;
+
+    static Sign to_sign(const Real &value)
+    {
+        return value > 0 ? Sign::POSITIVE : Sign::NEGATIVE;
+    }
+
+    // a, r_s, theta_s, r_o, nu_r, nu_theta from the first fields of a record
+    static ForwardRayTracingParams<Real> record_params(const Real *values)
+    {
+        ForwardRayTracingParams<Real> params;
+        params.a = values[0];
+        params.r_s = values[1];
+        params.theta_s = values[2];
+        params.r_o = values[3];
+        params.nu_r = to_sign(values[4]);
+        params.nu_theta = to_sign(values[5]);
+        params.print_args_error = false;
+        return params;
+    }
+
+    // Attach the background of context.prepare, or else the last one built if the spin matches, before anything calls
+    // get_background on params
+    static void attach_background(ForwardRayTracingParams<Real> &params, const QueryContext<Real, Complex> &context,
+                                  std::shared_ptr<const KerrBackground<Real>> &last)
+    {
+        if (context.prepare)
+        {
+            context.prepare(params);
+        }
+        if (params.background && params.background->matches(params.a))
+        {
+            return;
+        }
+        if (!last || !last->matches(params.a))
+        {
+            last = KerrBackground<Real>::create(params.a);
+        }
+        params.background = last;
+    }
+
+    template <size_t N>
+    static std::array<size_t, N> add_real_columns(Table &table, const std::array<const char *, N> &names)
+    {
+        std::array<size_t, N> columns{};
+        for (size_t c = 0; c < N; c++)
+        {
+            columns[c] = table.add_column(names[c], Kind::REAL);
+        }
+        return columns;
+    }
+
+    static void rays(const Real *values, size_t count, size_t first_record, const QueryOptions<Real> &options,
+                     const QueryContext<Real, Complex> &context, Table &table)
+    {
+        size_t fields = query_record_fields(QueryKind::RAY);
+        std::vector<ForwardRayTracingParams<Real>> params_list;
+        params_list.reserve(count);
+        std::shared_ptr<const KerrBackground<Real>> background;
+        for (size_t k = 0; k < count; k++)
+        {
+            const Real *record = values + k * fields;
+            auto &params = params_list.emplace_back(record_params(record));
+            params.rc = record[6];
+            params.log_abs_d = record[7];
+            params.d_sign = to_sign(record[8]);
+            params.calc_t_f = options.calc_t_f;
+            attach_background(params, context, background);
+            params.rc_d_to_lambda_q();
+        }
+        auto results = Utils::calc_ray_batch(params_list);
+
+        size_t record = table.add_column("record", Kind::INTEGER);
+        size_t status = table.add_column("status", Kind::INTEGER);
+        size_t m = table.add_column("m", Kind::INTEGER);
+        auto reals = add_real_columns<7>(table, {"lambda", "q", "eta", "theta_f", "phi_f", "t_f", "n_half"});
+        table.resize(count);
+        for (size_t k = 0; k < count; k++)
+        {
+            const auto &res = results[k];
+            table.columns[record].integers[k] = static_cast<int64_t>(first_record + k);
+            table.columns[status].integers[k] = static_cast<int64_t>(res.ray_status);
+            table.columns[m].integers[k] = res.m;
+            const Real *row[] = {&res.lambda, &res.q, &res.eta, &res.theta_f, &res.phi_f, &res.t_f, &res.n_half};
+            for (size_t c = 0; c < reals.size(); c++)
+            {
+                table.columns[reals[c]].reals[k] = *row[c];
+            }
+        }
+    }
+
+    static void roots(const Real *values, size_t count, size_t first_record, const QueryOptions<Real> &options,
+                      const QueryContext<Real, Complex> &context, Table &table)
+    {
+        size_t fields = query_record_fields(QueryKind::ROOT);
+        // the params are cheap to set up, so they are built in order and share their backgrounds
+        std::vector<ForwardRayTracingParams<Real>> params_list;
+        params_list.reserve(count);
+        std::shared_ptr<const KerrBackground<Real>> background;
+        for (size_t k = 0; k < count; k++)
+        {
+            const Real *record = values + k * fields;
+            auto &params = params_list.emplace_back(record_params(record));
+            params.rc = record[6];
+            params.log_abs_d = record[7];
+            params.d_sign = to_sign(record[8]);
+            attach_background(params, context, background);
+            params.rc_d_to_lambda_q();
+        }
+        std::vector<FindRootResult<Real, Complex>> results(count);
+        oneapi::tbb::parallel_for(oneapi::tbb::blocked_range<size_t>(0u, count),
+                                  [&](const oneapi::tbb::blocked_range<size_t> &r)
+                                  {
+                                      for (size_t k = r.begin(); k != r.end(); ++k)
+                                      {
+                                          const Real *record = values + k * fields;
+                                          results[k] = Utils::find_root(params_list[k], record[9], record[10],
+                                                                        options.tol);
+                                      }
+                                  });
+
+        size_t record = table.add_column("record", Kind::INTEGER);
+        size_t success = table.add_column("success", Kind::INTEGER);
+        size_t iterations = table.add_column("iterations", Kind::INTEGER);
+        size_t status = table.add_column("status", Kind::INTEGER);
+        auto reals = add_real_columns<6>(table, {"rc", "log_abs_d", "lambda", "eta", "theta_f", "phi_f"});
+        table.resize(count);
+        for (size_t k = 0; k < count; k++)
+        {
+            const auto &res = results[k];
+            table.columns[record].integers[k] = static_cast<int64_t>(first_record + k);
+            table.columns[success].integers[k] = res.success;
+            table.columns[iterations].integers[k] = static_cast<int64_t>(res.iterations);
+            table.columns[status].integers[k] = static_cast<int64_t>(res.ray_status);
+            if (res.root)
+            {
+                const auto &root = *res.root;
+                const Real *row[] = {&root.rc, &root.log_abs_d, &root.lambda, &root.eta, &root.theta_f, &root.phi_f};
+                for (size_t c = 0; c < reals.size(); c++)
+                {
+                    table.columns[reals[c]].reals[k] = *row[c];
+                }
+            }
+        }
+    }
+
+    static void sweeps(const Real *values, size_t count, size_t first_record, const QueryOptions<Real> &options,
+                       const QueryContext<Real, Complex> &context, Table &table)
+    {
+        size_t fields = query_record_fields(QueryKind::SWEEP);
+        std::vector<Real> lgd_list = options.lgd_list();
+        std::vector<SweepResult<Real, Complex>> results(count);
+        std::shared_ptr<const KerrBackground<Real>> background;
+        for (size_t k = 0; k < count; k++)
+        {
+            const Real *record = values + k * fields;
+            auto params = record_params(record);
+            params.d_sign = to_sign(record[6]);
+            attach_background(params, context, background);
+            std::vector<Real> rc_list = options.rc_list(params.a);
+            // only the roots are returned, so the maps are not needed
+            results[k] = context.sweep ? context.sweep(params, record[7], record[8], rc_list, lgd_list, options.cutoff,
+                                                       options.tol)
+                                       : Utils::sweep_rc_d_sparse(params, record[7], record[8], rc_list, lgd_list,
+                                                                  options.cutoff, options.tol);
+        }
+
+        size_t record = table.add_column("record", Kind::INTEGER);
+        size_t status = table.add_column("status", Kind::INTEGER);
+        auto reals = add_real_columns<6>(table, {"rc", "log_abs_d", "lambda", "eta", "theta_f", "phi_f"});
+        size_t rows = 0;
+        for (const auto &result : results)
+        {
+            rows += result.results.size();
+        }
+        table.resize(rows);
+        size_t k_row = 0;
+        for (size_t k = 0; k < count; k++)
+        {
+            for (const auto &root : results[k].results)
+            {
+                table.columns[record].integers[k_row] = static_cast<int64_t>(first_record + k);
+                table.columns[status].integers[k_row] = static_cast<int64_t>(root.ray_status);
+                const Real *row[] = {&root.rc, &root.log_abs_d, &root.lambda, &root.eta, &root.theta_f, &root.phi_f};
+                for (size_t c = 0; c < reals.size(); c++)
+                {
+                    table.columns[reals[c]].reals[k_row] = *row[c];
+                }
+                k_row++;
+            }
+        }
+    }
+
+public:
+    // Compute count records of values, query_record_fields(kind) values each, into table. The rows of record k are
+    // numbered first_record + k.
+    static void run(QueryKind kind, const Real *values, size_t count, size_t first_record,
+                    const QueryOptions<Real> &options, const QueryContext<Real, Complex> &context, Table &table)
+    {
+        switch (kind)
+        {
+        case QueryKind::RAY:
+            rays(values, count, first_record, options, context, table);
+            break;
+        case QueryKind::ROOT:
+            roots(values, count, first_record, options, context, table);
+            break;
+        case QueryKind::SWEEP:
+            sweeps(values, count, first_record, options, context, table);
+            break;
+        }
+    }
+};
@@ -0,0 +1,649 @@
+#pragma once
+
+#include "QueryBatch.h"
+#include "SweepCache.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#include <boost/asio.hpp>
+
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// A long-lived server for small queries over a Unix domain socket. The process keeps the TBB workers, the object pools,
+// the backgrounds of recent spins and the maps of recent sweeps warm, so a query costs its computation and not the
+// start of a process. A sweep for a new observer of a cached grid only recomputes the delta maps and the roots.
+//
+// Clients send requests and read responses in order on one connection, every client has its own thread and the
+// computations of all clients share the TBB workers. Frames are native little-endian:
+//   request   QueryRequestHeader, then QUERY_OPTION_COUNT options and count records of query_record_fields(kind)
+//             values, every value a double expansion of the limbs of the precision (see FloatExpansion.h). The
+//             options are calc_t_f, tol, cutoff, rc_count, rc_margin, lgd_min, lgd_max and lgd_count of QueryOptions.
+//   response  QueryResponseHeader, then a message of message_size bytes if status is not 0, otherwise uint32 column
+//             count, per column uint8 kind and uint32 name length and name, and the columns as in QueryTable::encode.
+// A ping request has no options or records and is answered with an empty table. A header that is malformed or over
+// the limits below closes the connection, options that are out of range are answered with a message.
+
+constexpr char QUERY_MAGIC[4] = {'K', 'P', 'Q', '1'};
+constexpr size_t QUERY_OPTION_COUNT = 8;
+// records of one request
+constexpr uint32_t QUERY_MAX_RECORDS = 1u << 24;
+// bytes of the options and records of one request, checked before they are read
+constexpr size_t QUERY_MAX_PAYLOAD_BYTES = size_t(1) << 28;
+// nodes of each axis of a sweep and of its grid, every node of a dense sweep keeps its maps
+constexpr size_t QUERY_MAX_SWEEP_NODES = 1u << 16;
+constexpr size_t QUERY_MAX_SWEEP_CELLS = size_t(1) << 22;
+
+// kind of a request, QueryKind or ping
+constexpr uint8_t QUERY_PING = 0;
+
+enum class QueryPrecision : uint8_t
+{
+    DOUBLE = 0,
+    LONG_DOUBLE = 1,
+    DOUBLE_DOUBLE = 2,
+    FLOAT128 = 3,
+    FLOAT256 = 4,
+};
+
+template <typename Real>
+constexpr QueryPrecision query_precision();
+
+template <>
+constexpr QueryPrecision query_precision<double>()
+{
+    return QueryPrecision::DOUBLE;
+}
+
+template <>
+constexpr QueryPrecision query_precision<long double>()
+{
+    return QueryPrecision::LONG_DOUBLE;
+}
+
+template <>
+constexpr QueryPrecision query_precision<DoubleDouble>()
+{
+    return QueryPrecision::DOUBLE_DOUBLE;
+}
+
+template <>
+constexpr QueryPrecision query_precision<Float128>()
+{
+    return QueryPrecision::FLOAT128;
+}
+
+template <>
+constexpr QueryPrecision query_precision<Float256>()
+{
+    return QueryPrecision::FLOAT256;
+}
+
+struct QueryRequestHeader
+{
+    char magic[4];
+    uint8_t kind;
+    uint8_t precision;
+    uint16_t reserved;
+    uint32_t count;
+};
+
+struct QueryResponseHeader
+{
+    char magic[4];
+    uint8_t kind;
+    // 0 on success
+    uint8_t status;
+    uint16_t reserved;
+    uint32_t rows;
+    uint32_t message_size;
+};
+
+// The warm state of one precision: backgrounds by spin and the maps of the max_sweeps most recent sweep grids
+template <typename Real, typename Complex>
+class QueryHandler
+{
+private:
+    using Utils = ForwardRayTracingUtils<Real, Complex>;
+    static constexpr size_t LIMBS = double_expansion_size<Real>;
+    static constexpr size_t MAX_BACKGROUNDS = 64;
+
+    size_t max_sweeps;
+    std::mutex mutex;
+    std::map<Real, std::shared_ptr<const KerrBackground<Real>>> backgrounds;
+    // most recent first
+    std::list<std::pair<std::string, std::shared_ptr<const SweepResult<Real, Complex>>>> sweeps;
+
+    std::shared_ptr<const KerrBackground<Real>> background(const Real &a)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = backgrounds.find(a);
+        if (it != backgrounds.end())
+        {
+            return it->second;
+        }
+        if (backgrounds.size() == MAX_BACKGROUNDS)
+        {
+            backgrounds.clear();
+        }
+        return backgrounds.emplace(a, KerrBackground<Real>::create(a)).first->second;
+    }
+
+    std::shared_ptr<const SweepResult<Real, Complex>> find_sweep(const std::string &key)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto it = sweeps.begin(); it != sweeps.end(); ++it)
+        {
+            if (it->first == key)
+            {
+                sweeps.splice(sweeps.begin(), sweeps, it);
+                return it->second;
+            }
+        }
+        return nullptr;
+    }
+
+    void store_sweep(const std::string &key, std::shared_ptr<const SweepResult<Real, Complex>> maps)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        sweeps.remove_if([&](const auto &entry)
+                         { return entry.first == key; });
+        sweeps.emplace_front(key, std::move(maps));
+        while (sweeps.size() > max_sweeps)
+        {
+            sweeps.pop_back();
+        }
+    }
+
+    SweepResult<Real, Complex> sweep(const ForwardRayTracingParams<Real> &params_, Real theta_o, Real phi_o,
+                                     const std::vector<Real> &rc_list, const std::vector<Real> &lgd_list,
+                                     size_t cutoff, const Real &tol)
+    {
+        std::string key = SweepCache::key(params_, rc_list, lgd_list);
+        auto maps = max_sweeps > 0 ? find_sweep(key) : nullptr;
+        if (!maps)
+        {
+            auto sweep_result = Utils::sweep_rc_d(params_, theta_o, phi_o, rc_list, lgd_list, cutoff, tol);
+            if (max_sweeps > 0)
+            {
+                store_sweep(key, std::make_shared<const SweepResult<Real, Complex>>(sweep_result));
+            }
+            return sweep_result;
+        }
+
+        ForwardRayTracingParams<Real> params(params_);
+        params.get_background();
+        wrap_phi(phi_o);
+        SweepResult<Real, Complex> sweep_result;
+        sweep_result.theta = maps->theta;
+        sweep_result.phi = maps->phi;
+        sweep_result.lambda = maps->lambda;
+        sweep_result.eta = maps->eta;
+        sweep_result.status = maps->status;
+        sweep_result.delta_theta.resize(maps->theta.rows(), maps->theta.cols());
+        sweep_result.delta_phi.resize(maps->theta.rows(), maps->theta.cols());
+        Utils::observe_sweep(sweep_result, params, theta_o, phi_o, rc_list, lgd_list, cutoff, tol);
+        return sweep_result;
+    }
+
+    static Real load(const double *parts)
+    {
+        return from_double_expansion<Real, LIMBS>(parts);
+    }
+
+    static Real load_finite(const double *parts, const char *name)
+    {
+        Real value = load(parts);
+        if (!std::isfinite(static_cast<double>(value)))
+        {
+            throw std::invalid_argument(fmt::format("option {} is not finite", name));
+        }
+        return value;
+    }
+
+    // a count option, rejected unless it is a whole number in [0, max]
+    static size_t load_count(const double *parts, const char *name, size_t max)
+    {
+        auto value = static_cast<double>(load(parts));
+        if (!(value >= 0 && value <= static_cast<double>(max)) || value != std::floor(value))
+        {
+            throw std::invalid_argument(fmt::format("option {} is not a whole number in [0, {}]", name, max));
+        }
+        return static_cast<size_t>(value);
+    }
+
+public:
+    explicit QueryHandler(size_t max_sweeps) : max_sweeps(max_sweeps)
+    {
+    }
+
+    // doubles a request of kind with count records needs after its header
+    static size_t payload_doubles(QueryKind kind, size_t count)
+    {
+        return (QUERY_OPTION_COUNT + count * query_record_fields(kind)) * LIMBS;
+    }
+
+    // compute a request and append the column descriptions and columns of its table to response
+    size_t handle(QueryKind kind, const double *payload, size_t count, std::string &response)
+    {
+        QueryOptions<Real> options;
+        options.calc_t_f = load_finite(payload, "calc_t_f") != 0;
+        options.tol = load_finite(payload + LIMBS, "tol");
+        options.cutoff = load_count(payload + 2 * LIMBS, "cutoff", QUERY_MAX_SWEEP_CELLS);
+        options.rc_count = load_count(payload + 3 * LIMBS, "rc_count", QUERY_MAX_SWEEP_NODES);
+        options.rc_margin = load_finite(payload + 4 * LIMBS, "rc_margin");
+        options.lgd_min = load_finite(payload + 5 * LIMBS, "lgd_min");
+        options.lgd_max = load_finite(payload + 6 * LIMBS, "lgd_max");
+        options.lgd_count = load_count(payload + 7 * LIMBS, "lgd_count", QUERY_MAX_SWEEP_NODES);
+        if (kind == QueryKind::SWEEP &&
+            (options.rc_count < 2 || options.lgd_count < 2 ||
+             options.rc_count * options.lgd_count > QUERY_MAX_SWEEP_CELLS))
+        {
+            throw std::invalid_argument(fmt::format("a sweep needs 2 to {} nodes on each axis and at most {} in its "
+                                                    "grid, got {}x{}",
+                                                    QUERY_MAX_SWEEP_NODES, QUERY_MAX_SWEEP_CELLS, options.rc_count,
+                                                    options.lgd_count));
+        }
+
+        size_t value_count = count * query_record_fields(kind);
+        const double *records = payload + QUERY_OPTION_COUNT * LIMBS;
+        std::vector<Real> values(value_count);
+        for (size_t k = 0; k < value_count; k++)
+        {
+            values[k] = load(records + k * LIMBS);
+        }
+
+        QueryContext<Real, Complex> context;
+        context.prepare = [this](ForwardRayTracingParams<Real> &params)
+        {
+            // backgrounds are keyed by the spin, which must compare equal to itself
+            if (!std::isfinite(static_cast<double>(params.a)))
+            {
+                throw std::invalid_argument("a is not finite");
+            }
+            params.background = background(params.a);
+        };
+        context.sweep = [this](const ForwardRayTracingParams<Real> &params, const Real &theta_o, const Real &phi_o,
+                               const std::vector<Real> &rc_list, const std::vector<Real> &lgd_list, size_t cutoff,
+                               const Real &tol)
+        { return sweep(params, theta_o, phi_o, rc_list, lgd_list, cutoff, tol); };
+
+        QueryTable<Real> table;
+        QueryBatch<Real, Complex>::run(kind, values.data(), count, 0, options, context, table);
+
+        auto column_count = static_cast<uint32_t>(table.columns.size());
+        response.append(reinterpret_cast<const char *>(&column_count), sizeof(column_count));
+        for (const auto &column : table.columns)
+        {
+            auto column_kind = static_cast<uint8_t>(column.kind);
+            auto length = static_cast<uint32_t>(column.name.size());
+            response.append(reinterpret_cast<const char *>(&column_kind), sizeof(column_kind));
+            response.append(reinterpret_cast<const char *>(&length), sizeof(length));
+            response.append(column.name);
+        }
+        table.encode(response);
+        return table.rows;
+    }
+};
+
+class QueryServer
+{
+private:
+    using Protocol = boost::asio::local::stream_protocol;
+
+    std::string socket_path;
+    boost::asio::io_context io_context;
+    Protocol::acceptor acceptor;
+    std::tuple<QueryHandler<double, std::complex<double>>, QueryHandler<long double, std::complex<long double>>,
+               QueryHandler<DoubleDouble, ComplexDoubleDouble>, QueryHandler<Float128, Complex128>,
+               QueryHandler<Float256, Complex256>>
+        handlers;
+
+    std::mutex clients_mutex;
+    std::list<std::thread> client_threads;
+    std::set<int> client_sockets;
+    // threads of clients that disconnected, joined on the next accept
+    std::vector<std::thread::id> finished_clients;
+    std::atomic<bool> stopping{false};
+
+    // Read the payload of a request and compute it into response. Returns false without reading if the payload is
+    // too large, errors of the socket are thrown and errors of the computation are answered.
+    template <typename Handler>
+    bool handle(Handler &handler, Protocol::socket &socket, QueryKind kind, uint32_t count,
+                QueryResponseHeader &response_header, std::string &response)
+    {
+        size_t payload_doubles = Handler::payload_doubles(kind, count);
+        if (payload_doubles > QUERY_MAX_PAYLOAD_BYTES / sizeof(double))
+        {
+            return false;
+        }
+        std::vector<double> payload(payload_doubles);
+        boost::asio::read(socket, boost::asio::buffer(payload));
+        try
+        {
+            response_header.rows = static_cast<uint32_t>(handler.handle(kind, payload.data(), count, response));
+        }
+        catch (const std::exception &e)
+        {
+            response_header.status = 1;
+            response_header.rows = 0;
+            response = e.what();
+            response_header.message_size = static_cast<uint32_t>(response.size());
+        }
+        return true;
+    }
+
+    bool dispatch(const QueryRequestHeader &header, Protocol::socket &socket, QueryResponseHeader &response_header,
+                  std::string &response)
+    {
+        auto kind = static_cast<QueryKind>(header.kind);
+        switch (static_cast<QueryPrecision>(header.precision))
+        {
+        case QueryPrecision::DOUBLE:
+            return handle(std::get<0>(handlers), socket, kind, header.count, response_header, response);
+        case QueryPrecision::LONG_DOUBLE:
+            return handle(std::get<1>(handlers), socket, kind, header.count, response_header, response);
+        case QueryPrecision::DOUBLE_DOUBLE:
+            return handle(std::get<2>(handlers), socket, kind, header.count, response_header, response);
+        case QueryPrecision::FLOAT128:
+            return handle(std::get<3>(handlers), socket, kind, header.count, response_header, response);
+        case QueryPrecision::FLOAT256:
+            return handle(std::get<4>(handlers), socket, kind, header.count, response_header, response);
+        }
+        throw std::logic_error("unreachable");
+    }
+
+    void serve_client(Protocol::socket socket)
+    {
+        try
+        {
+            while (true)
+            {
+                QueryRequestHeader header;
+                boost::system::error_code ec;
+                boost::asio::read(socket, boost::asio::buffer(&header, sizeof(header)), ec);
+                if (ec)
+                {
+                    break;
+                }
+                // the payload size depends on the kind and precision, a client sending unknown ones is dropped
+                if (std::memcmp(header.magic, QUERY_MAGIC, sizeof(QUERY_MAGIC)) != 0 ||
+                    header.precision > static_cast<uint8_t>(QueryPrecision::FLOAT256) ||
+                    header.kind > static_cast<uint8_t>(QueryKind::SWEEP) || header.count > QUERY_MAX_RECORDS)
+                {
+                    break;
+                }
+
+                QueryResponseHeader response_header{};
+                std::memcpy(response_header.magic, QUERY_MAGIC, sizeof(QUERY_MAGIC));
+                response_header.kind = header.kind;
+                std::string response;
+                if (header.kind == QUERY_PING)
+                {
+                    uint32_t column_count = 0;
+                    response.append(reinterpret_cast<const char *>(&column_count), sizeof(column_count));
+                }
+                else if (!dispatch(header, socket, response_header, response))
+                {
+                    // the payload is not read, so the stream cannot be followed any more
+                    break;
+                }
+                std::array<boost::asio::const_buffer, 2> buffers = {
+                    boost::asio::buffer(&response_header, sizeof(response_header)), boost::asio::buffer(response)};
+                boost::asio::write(socket, buffers);
+            }
+        }
+        catch (const boost::system::system_error &)
+        {
+            // the client went away
+        }
+
+        std::lock_guard<std::mutex> lock(clients_mutex);
+        client_sockets.erase(socket.native_handle());
+        finished_clients.push_back(std::this_thread::get_id());
+    }
+
+    // called with clients_mutex held
+    void join_finished_clients()
+    {
+        for (auto it = client_threads.begin(); it != client_threads.end();)
+        {
+            if (std::find(finished_clients.begin(), finished_clients.end(), it->get_id()) != finished_clients.end())
+            {
+                it->join();
+                it = client_threads.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+        finished_clients.clear();
+    }
+
+    void accept()
+    {
+        acceptor.async_accept([this](const boost::system::error_code &ec, Protocol::socket socket)
+                              {
+                                  if (ec || stopping)
+                                  {
+                                      return;
+                                  }
+                                  {
+                                      std::lock_guard<std::mutex> lock(clients_mutex);
+                                      join_finished_clients();
+                                      client_sockets.insert(socket.native_handle());
+                                      client_threads.emplace_back(&QueryServer::serve_client, this,
+                                                                  std::move(socket));
+                                  }
+                                  accept();
+                              });
+    }
+
+public:
+    // Listen on socket_path, replacing a stale socket file. Throws if another file is there or a server still
+    // answers on it. Every precision keeps the maps of its max_sweeps most recent sweep grids.
+    explicit QueryServer(const std::string &socket_path, size_t max_sweeps = 8)
+        : socket_path(socket_path), acceptor(io_context),
+          handlers(max_sweeps, max_sweeps, max_sweeps, max_sweeps, max_sweeps)
+    {
+        Protocol::endpoint endpoint(socket_path);
+        struct stat status;
+        if (::lstat(socket_path.c_str(), &status) == 0)
+        {
+            if (!S_ISSOCK(status.st_mode))
+            {
+                throw std::runtime_error(fmt::format("{} exists and is not a socket", socket_path));
+            }
+            Protocol::socket probe(io_context);
+            boost::system::error_code ec;
+            probe.connect(endpoint, ec);
+            if (!ec)
+            {
+                throw std::runtime_error(fmt::format("a server is already listening on {}", socket_path));
+            }
+            ::unlink(socket_path.c_str());
+        }
+        acceptor.open(endpoint.protocol());
+        acceptor.bind(endpoint);
+        acceptor.listen();
+    }
+
+    QueryServer(const QueryServer &) = delete;
+    QueryServer &operator=(const QueryServer &) = delete;
+
+    ~QueryServer()
+    {
+        stop();
+        for (auto &thread : client_threads)
+        {
+            if (thread.joinable())
+            {
+                thread.join();
+            }
+        }
+        ::unlink(socket_path.c_str());
+    }
+
+    // accept clients until stop is called
+    void run()
+    {
+        accept();
+        io_context.run();
+    }
+
+    // stop accepting and close every connection, from any thread
+    void stop()
+    {
+        if (stopping.exchange(true))
+        {
+            return;
+        }
+        boost::asio::post(io_context, [this]
+                          {
+                              boost::system::error_code ec;
+                              acceptor.close(ec);
+                          });
+        io_context.stop();
+        std::lock_guard<std::mutex> lock(clients_mutex);
+        for (int fd : client_sockets)
+        {
+            ::shutdown(fd, SHUT_RDWR);
+        }
+    }
+};
+
+// A connection to a QueryServer
+class QueryClient
+{
+private:
+    using Protocol = boost::asio::local::stream_protocol;
+
+    boost::asio::io_context io_context;
+    Protocol::socket socket;
+
+    template <typename Real>
+    static void append_value(std::vector<double> &payload, const Real &value)
+    {
+        auto parts = to_double_expansion<double_expansion_size<Real>>(value);
+        payload.insert(payload.end(), parts.begin(), parts.end());
+    }
+
+    QueryResponseHeader exchange(const QueryRequestHeader &header, const std::vector<double> &payload,
+                                 std::string &body)
+    {
+        std::array<boost::asio::const_buffer, 2> buffers = {boost::asio::buffer(&header, sizeof(header)),
+                                                            boost::asio::buffer(payload)};
+        boost::asio::write(socket, buffers);
+        QueryResponseHeader response_header;
+        boost::asio::read(socket, boost::asio::buffer(&response_header, sizeof(response_header)));
+        if (response_header.status != 0)
+        {
+            std::string message(response_header.message_size, '\0');
+            boost::asio::read(socket, boost::asio::buffer(message));
+            throw std::runtime_error(message);
+        }
+        uint32_t column_count;
+        boost::asio::read(socket, boost::asio::buffer(&column_count, sizeof(column_count)));
+        body.assign(reinterpret_cast<const char *>(&column_count), sizeof(column_count));
+        return response_header;
+    }
+
+public:
+    explicit QueryClient(const std::string &socket_path) : socket(io_context)
+    {
+        socket.connect(Protocol::endpoint(socket_path));
+    }
+
+    void ping()
+    {
+        QueryRequestHeader header{};
+        std::memcpy(header.magic, QUERY_MAGIC, sizeof(QUERY_MAGIC));
+        header.kind = QUERY_PING;
+        std::string body;
+        exchange(header, {}, body);
+    }
+
+    // compute records of query_record_fields(kind) values each on the server
+    template <typename Real>
+    QueryTable<Real> query(QueryKind kind, const std::vector<Real> &values, const QueryOptions<Real> &options = {})
+    {
+        size_t fields = query_record_fields(kind);
+        if (values.size() % fields != 0)
+        {
+            throw std::invalid_argument(fmt::format("{} values are not records of {}", values.size(), fields));
+        }
+        QueryRequestHeader header{};
+        std::memcpy(header.magic, QUERY_MAGIC, sizeof(QUERY_MAGIC));
+        header.kind = static_cast<uint8_t>(kind);
+        header.precision = static_cast<uint8_t>(query_precision<Real>());
+        header.count = static_cast<uint32_t>(values.size() / fields);
+
+        std::vector<double> payload;
+        payload.reserve((QUERY_OPTION_COUNT + values.size()) * double_expansion_size<Real>);
+        for (const Real &option : {Real(options.calc_t_f ? 1 : 0), options.tol, Real(options.cutoff),
+                                   Real(options.rc_count), options.rc_margin, options.lgd_min, options.lgd_max,
+                                   Real(options.lgd_count)})
+        {
+            append_value(payload, option);
+        }
+        for (const Real &value : values)
+        {
+            append_value(payload, value);
+        }
+
+        std::string body;
+        QueryResponseHeader response_header = exchange(header, payload, body);
+        uint32_t column_count;
+        std::memcpy(&column_count, body.data(), sizeof(column_count));
+
+        QueryTable<Real> table;
+        for (uint32_t c = 0; c < column_count; c++)
+        {
+            uint8_t column_kind;
+            uint32_t length;
+            boost::asio::read(socket, boost::asio::buffer(&column_kind, sizeof(column_kind)));
+            boost::asio::read(socket, boost::asio::buffer(&length, sizeof(length)));
+            std::string name(length, '\0');
+            boost::asio::read(socket, boost::asio::buffer(name));
+            table.add_column(std::move(name), static_cast<typename QueryTable<Real>::Kind>(column_kind));
+        }
+        table.resize(response_header.rows);
+        std::vector<double> parts(table.rows * QueryTable<Real>::LIMBS);
+        for (auto &column : table.columns)
+        {
+            if (column.kind == QueryTable<Real>::Kind::INTEGER)
+            {
+                boost::asio::read(socket, boost::asio::buffer(column.integers));
+                continue;
+            }
+            boost::asio::read(socket, boost::asio::buffer(parts));
+            for (size_t k = 0; k < table.rows; k++)
+            {
+                column.reals[k] = from_double_expansion<Real, QueryTable<Real>::LIMBS>(
+                    parts.data() + k * QueryTable<Real>::LIMBS);
+            }
+        }
+        return table;
+    }
+};
+
+#endif
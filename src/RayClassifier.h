@@ -0,0 +1,140 @@
+#pragma once
+
+#include "SweepGrid.h"
+
+#include <vector>
+
+// Analytic classification of rays from (lambda, q) before their radial roots and integrals are computed. It follows the
+// order of the checks in ForwardRayTracing::calc_ray, but only uses signs of the potentials:
+// - the angular potential Theta(theta_s) < 0 iff theta_s is outside [theta_m, theta_p]
+// - the discriminant of the resolvent cubic decides whether r3, r4 are real (turning point) or complex conjugates
+// - the radial potential R(r) < 0 iff r lies between two real roots, i.e. below r4
+// A status is only reported when the sign is decided with a safety margin, otherwise NORMAL is returned and the ray has
+// to be traced. CONFINED cannot be decided this way, since calc_ray already reports r_s < r4 as R_OUT_OF_RANGE.
+template <typename Real>
+class RayClassifier
+{
+private:
+    Real a, a2;
+    Real r_s, r_o;
+    Sign nu_r;
+    bool r_o_finite;
+
+    Real cos2_theta_s, cot2_theta_s;
+    Real r2_a2_s, delta_s, r2_a2_o, delta_o;
+
+    Real margin;
+
+    // sign of R(r) with r^2 + a^2 and Delta precomputed: 1 if positive, -1 if negative, 0 if undecided
+    int radial_sign(const Real &r2_a2, const Real &delta, const Real &lambda, const Real &eta) const
+    {
+        Real term_1 = MY_SQUARE(r2_a2 - a * lambda);
+        Real term_2 = delta * (eta + MY_SQUARE(lambda - a));
+        Real scale = margin * (term_1 + abs(term_2));
+        Real R = term_1 - term_2;
+        return R > scale ? 1 : (R < -scale ? -1 : 0);
+    }
+
+public:
+    explicit RayClassifier(const ForwardRayTracingParams<Real> &params)
+        : a(params.a), r_s(params.r_s), r_o(params.r_o), nu_r(params.nu_r)
+    {
+        a2 = MY_SQUARE(a);
+        r_o_finite = !isinf(r_o);
+
+        Real cos_theta_s = cos(params.theta_s);
+        Real sin_theta_s = sin(params.theta_s);
+        cos2_theta_s = MY_SQUARE(cos_theta_s);
+        cot2_theta_s = cos2_theta_s / MY_SQUARE(sin_theta_s);
+
+        r2_a2_s = MY_SQUARE(r_s) + a2;
+        delta_s = r2_a2_s - 2 * r_s;
+        if (r_o_finite)
+        {
+            r2_a2_o = MY_SQUARE(r_o) + a2;
+            delta_o = r2_a2_o - 2 * r_o;
+        }
+
+        margin = ErrorLimit<Real>::Value;
+    }
+
+    // NORMAL means that the status cannot be decided analytically and the ray has to be traced
+    RayStatus classify(const Real &lambda, const Real &q) const
+    {
+        if (isnan(lambda) || isnan(q) || abs(lambda) <= 10000 * ErrorLimit<Real>::Value)
+        {
+            return RayStatus::ARGUMENT_ERROR;
+        }
+
+        Real eta = q * q;
+        if (eta <= 0)
+        {
+            return RayStatus::ETA_OUT_OF_RANGE;
+        }
+
+        // Theta(theta_s) = eta + a^2 cos^2(theta_s) - lambda^2 cot^2(theta_s)
+        Real theta_positive = eta + a2 * cos2_theta_s;
+        Real theta_negative = MY_SQUARE(lambda) * cot2_theta_s;
+        Real theta_scale = margin * (theta_positive + theta_negative);
+        if (theta_positive - theta_negative < -theta_scale)
+        {
+            return RayStatus::THETA_OUT_OF_RANGE;
+        }
+        if (theta_positive - theta_negative <= theta_scale)
+        {
+            return RayStatus::NORMAL;
+        }
+
+        // same depressed quartic and resolvent cubic as ForwardRayTracing::init_radial_potential_roots
+        Real AA = a2 - eta - lambda * lambda;
+        Real BB = 2 * (eta + (lambda - a) * (lambda - a));
+        Real CC = -a2 * eta;
+        Real PP = -AA * AA / 12 - CC;
+        Real QQ = (-2 * MY_CUBE(AA) - 27 * MY_SQUARE(BB) + 72 * AA * CC) / 216;
+        Real disc_1 = MY_CUBE(PP) / 27;
+        Real disc_2 = MY_SQUARE(QQ) / 4;
+        Real disc = disc_1 + disc_2;
+        Real disc_scale = margin * (abs(disc_1) + disc_2);
+
+        if (disc > disc_scale)
+        {
+            // one real root of the resolvent cubic: r3, r4 are complex conjugates and there is no radial turning point
+            return nu_r == Sign::NEGATIVE ? RayStatus::FALLS_IN : RayStatus::NORMAL;
+        }
+
+        if (disc < -disc_scale)
+        {
+            // four real roots: R < 0 between r1 and r2 or between r3 and r4, both below r4
+            if (radial_sign(r2_a2_s, delta_s, lambda, eta) < 0 ||
+                (r_o_finite && radial_sign(r2_a2_o, delta_o, lambda, eta) < 0))
+            {
+                return RayStatus::R_OUT_OF_RANGE;
+            }
+        }
+
+        return RayStatus::NORMAL;
+    }
+
+    // classify the cells of a sweep grid tile, status is row-major with the size of the tile
+    void classify_tile(const SweepGrid<Real> &grid, size_t row_begin, size_t row_end, size_t col_begin,
+                       size_t col_end, std::vector<RayStatus> &status) const
+    {
+        size_t cols = col_end - col_begin;
+        status.resize((row_end - row_begin) * cols);
+        Real lambda, q;
+        for (size_t i = row_begin; i < row_end; ++i)
+        {
+            for (size_t j = col_begin; j < col_end; ++j)
+            {
+                RayStatus &cell = status[(i - row_begin) * cols + (j - col_begin)];
+                if (!grid.valid(i, j))
+                {
+                    cell = RayStatus::ARGUMENT_ERROR;
+                    continue;
+                }
+                grid.cell_lambda_q(i, j, lambda, q);
+                cell = classify(lambda, q);
+            }
+        }
+    }
+};
@@ -0,0 +1,233 @@
+#pragma once
+
+#include "Common.h"
+#include "FloatExpansion.h"
+#include "SweepFile.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <ctime>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+// Sweep maps on local disk, addressed by a hash of everything they depend on: the precision, a, r_s, theta_s, r_o,
+// the signs and both axes. theta_o and phi_o are not part of the key, a cached sweep serves every observer and only its
+// delta maps are recomputed. Entries are sweep files named <key>.sweep (see SweepFile).
+//
+// Several processes on one machine can share a directory. An entry is written to a unique temporary file and renamed
+// into place, so readers only see complete files, and a reader keeps its mapping if the entry is evicted meanwhile.
+// The directory is kept under max_bytes by removing the least recently used entries, a hit refreshes the modification
+// time of its entry. Temporary files count towards max_bytes, those older than STALE_TEMP_SECONDS were left behind by a
+// writer that died and are removed.
+class SweepCache
+{
+public:
+    static constexpr std::time_t STALE_TEMP_SECONDS = 3600;
+
+private:
+    boost::filesystem::path directory;
+    uintmax_t max_bytes;
+
+    // FNV-1a
+    struct Hasher
+    {
+        uint64_t hash = 14695981039346656037ull;
+
+        void add(const void *data, size_t size)
+        {
+            const auto *bytes = static_cast<const unsigned char *>(data);
+            for (size_t i = 0; i < size; i++)
+            {
+                hash ^= bytes[i];
+                hash *= 1099511628211ull;
+            }
+        }
+
+        template <typename Real>
+        void add_value(const Real &value)
+        {
+            auto parts = to_double_expansion<double_expansion_size<Real>>(value);
+            add(parts.data(), parts.size() * sizeof(double));
+        }
+    };
+
+    boost::filesystem::path entry_path(const std::string &key) const
+    {
+        return directory / (key + ".sweep");
+    }
+
+    struct Entry
+    {
+        boost::filesystem::path path;
+        std::time_t time;
+        uintmax_t size;
+    };
+
+    // Collect the entries of the directory and return the bytes they and the temporary files take. Temporary files
+    // are sweep files being written by store, they are not entries, and those older than STALE_TEMP_SECONDS are
+    // removed instead of counted.
+    uintmax_t scan(std::vector<Entry> &entries) const
+    {
+        uintmax_t total = 0;
+        std::time_t now = std::time(nullptr);
+        boost::system::error_code ec;
+        for (boost::filesystem::directory_iterator it(directory, ec), end; !ec && it != end; it.increment(ec))
+        {
+            const boost::filesystem::path &path = it->path();
+            bool temp = path.extension() == ".tmp";
+            if (!temp && path.extension() != ".sweep")
+            {
+                continue;
+            }
+            boost::system::error_code time_ec, size_ec;
+            Entry entry{path, boost::filesystem::last_write_time(path, time_ec),
+                        boost::filesystem::file_size(path, size_ec)};
+            if (time_ec || size_ec)
+            {
+                // removed or renamed by another process
+                continue;
+            }
+            if (temp && now - entry.time > STALE_TEMP_SECONDS)
+            {
+                boost::system::error_code remove_ec;
+                if (boost::filesystem::remove(path, remove_ec))
+                {
+                    continue;
+                }
+            }
+            total += entry.size;
+            if (!temp)
+            {
+                entries.push_back(std::move(entry));
+            }
+        }
+        return total;
+    }
+
+public:
+    explicit SweepCache(const std::string &directory, uintmax_t max_bytes = uintmax_t(16) << 30)
+        : directory(directory), max_bytes(max_bytes)
+    {
+        boost::filesystem::create_directories(this->directory);
+    }
+
+    template <typename Real>
+    static std::string key(const ForwardRayTracingParams<Real> &params, const std::vector<Real> &rc_list,
+                           const std::vector<Real> &lgd_list)
+    {
+        Hasher hasher;
+        std::string precision = TypeName<Real>::Get();
+        hasher.add(precision.data(), precision.size());
+        hasher.add(&SWEEP_FILE_VERSION, sizeof(SWEEP_FILE_VERSION));
+        for (const Real *value : {&params.a, &params.r_s, &params.theta_s, &params.r_o})
+        {
+            hasher.add_value(*value);
+        }
+        for (Sign sign : {params.nu_r, params.nu_theta, params.d_sign})
+        {
+            auto value = static_cast<int32_t>(sign);
+            hasher.add(&value, sizeof(value));
+        }
+        for (const std::vector<Real> *list : {&rc_list, &lgd_list})
+        {
+            uint64_t size = list->size();
+            hasher.add(&size, sizeof(size));
+            for (const Real &value : *list)
+            {
+                hasher.add_value(value);
+            }
+        }
+        return fmt::format("{:016x}", hasher.hash);
+    }
+
+    // The cached sweep for these inputs, if there is one. The entry is checked against the inputs, so a hash
+    // collision or a damaged file is a miss.
+    template <typename Real>
+    std::optional<SweepFile> load(const ForwardRayTracingParams<Real> &params, const std::vector<Real> &rc_list,
+                                  const std::vector<Real> &lgd_list) const
+    {
+        boost::filesystem::path path = entry_path(key(params, rc_list, lgd_list));
+        boost::system::error_code ec;
+        if (!boost::filesystem::exists(path, ec))
+        {
+            return std::nullopt;
+        }
+        try
+        {
+            SweepFile sweep_file(path.string());
+            if (!sweep_file.matches(params, rc_list, lgd_list) || !sweep_file.rows_written(0, sweep_file.rows()))
+            {
+                return std::nullopt;
+            }
+            boost::filesystem::last_write_time(path, std::time(nullptr), ec);
+            return sweep_file;
+        }
+        catch (const std::exception &)
+        {
+            // evicted or replaced by another process while opening
+            return std::nullopt;
+        }
+    }
+
+    // Add the maps of a finished sweep, replacing an entry with the same key, and evict old entries
+    template <typename Real, typename Maps>
+    void store(const ForwardRayTracingParams<Real> &params, const Real &theta_o, const Real &phi_o,
+               const std::vector<Real> &rc_list, const std::vector<Real> &lgd_list, const Maps &maps) const
+    {
+        boost::filesystem::path path = entry_path(key(params, rc_list, lgd_list));
+        boost::filesystem::path temp_path = directory / boost::filesystem::unique_path("%%%%-%%%%-%%%%-%%%%.tmp");
+        try
+        {
+            write_sweep_file(temp_path.string(), maps, params, theta_o, phi_o, rc_list, lgd_list);
+            boost::filesystem::rename(temp_path, path);
+        }
+        catch (...)
+        {
+            boost::system::error_code ec;
+            boost::filesystem::remove(temp_path, ec);
+            throw;
+        }
+        evict();
+    }
+
+    // remove the least recently used entries until the directory holds at most max_bytes
+    void evict() const
+    {
+        std::vector<Entry> entries;
+        uintmax_t total = scan(entries);
+        std::sort(entries.begin(), entries.end(), [](const Entry &e1, const Entry &e2)
+                  { return e1.time < e2.time; });
+        boost::system::error_code ec;
+        for (const Entry &entry : entries)
+        {
+            if (total <= max_bytes)
+            {
+                break;
+            }
+            boost::filesystem::remove(entry.path, ec);
+            total -= entry.size;
+        }
+    }
+
+    void clear() const
+    {
+        boost::system::error_code ec;
+        for (boost::filesystem::directory_iterator it(directory, ec), end; !ec && it != end; it.increment(ec))
+        {
+            if (it->path().extension() == ".sweep")
+            {
+                boost::filesystem::remove(it->path(), ec);
+            }
+        }
+    }
+
+    // the bytes of the entries and of the temporary files being written, stale temporary files are removed first
+    uintmax_t size_bytes() const
+    {
+        std::vector<Entry> entries;
+        return scan(entries);
+    }
+};
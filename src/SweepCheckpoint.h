@@ -0,0 +1,182 @@
+#pragma once
+
+#include "Common.h"
+#include "FloatExpansion.h"
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+// Root solves of a sweep, appended to a log as they finish so an interrupted sweep can resume its root stage. Records
+// are keyed by the rank of the candidate pair, which does not depend on the thread schedule, and hold the cell of the
+// candidate and the solution (see SweepStreamSettings::resume). The file is native little-endian:
+//   SweepRootLogHeader
+//   records of ROOT_RECORD_FIXED_BYTES followed by rc and log_abs_d as double expansions
+// A record cut short by a kill is ignored. A log written for another cutoff, tol or precision is started over.
+
+constexpr char SWEEP_ROOT_LOG_MAGIC[8] = {'K', 'E', 'R', 'R', 'R', 'O', 'O', 'T'};
+constexpr uint32_t SWEEP_ROOT_LOG_VERSION = 1;
+
+struct SweepRootLogHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t limbs;
+    char precision[32];
+    uint64_t cutoff;
+    // tol as a double expansion of limbs parts follows the header
+};
+
+template <typename Real>
+class SweepRootLog
+{
+public:
+    struct Entry
+    {
+        int32_t row;
+        int32_t col;
+        bool success;
+        Real rc;
+        Real log_abs_d;
+    };
+
+private:
+    static constexpr size_t LIMBS = double_expansion_size<Real>;
+    // rank, row, col, success and padding
+    static constexpr size_t ROOT_RECORD_FIXED_BYTES = 24;
+    static constexpr size_t ROOT_RECORD_BYTES = ROOT_RECORD_FIXED_BYTES + 2 * LIMBS * sizeof(double);
+
+    std::ofstream out;
+    std::mutex mutex;
+    std::unordered_map<uint64_t, Entry> entries;
+    // complete records in the log
+    size_t record_count = 0;
+
+    static SweepRootLogHeader make_header(size_t cutoff)
+    {
+        SweepRootLogHeader header{};
+        std::memcpy(header.magic, SWEEP_ROOT_LOG_MAGIC, sizeof(SWEEP_ROOT_LOG_MAGIC));
+        header.version = SWEEP_ROOT_LOG_VERSION;
+        header.limbs = LIMBS;
+        std::string precision = TypeName<Real>::Get();
+        std::strncpy(header.precision, precision.c_str(), sizeof(header.precision) - 1);
+        header.cutoff = cutoff;
+        return header;
+    }
+
+    static Real load(const double *parts)
+    {
+        return from_double_expansion<Real, LIMBS>(parts);
+    }
+
+    // the records of an existing log of the same sweep, false if it belongs to another one
+    bool read(const std::string &path, const SweepRootLogHeader &expected, const std::array<double, LIMBS> &tol)
+    {
+        std::ifstream ifs(path, std::ios::binary);
+        SweepRootLogHeader header;
+        std::array<double, LIMBS> log_tol;
+        if (!ifs.read(reinterpret_cast<char *>(&header), sizeof(header)) ||
+            !ifs.read(reinterpret_cast<char *>(log_tol.data()), sizeof(log_tol)) ||
+            std::memcmp(&header, &expected, sizeof(header)) != 0 || log_tol != tol)
+        {
+            return false;
+        }
+
+        std::vector<char> record(ROOT_RECORD_BYTES);
+        while (ifs.read(record.data(), static_cast<std::streamsize>(record.size())))
+        {
+            uint64_t rank;
+            Entry entry;
+            std::memcpy(&rank, record.data(), sizeof(rank));
+            std::memcpy(&entry.row, record.data() + 8, sizeof(entry.row));
+            std::memcpy(&entry.col, record.data() + 12, sizeof(entry.col));
+            entry.success = record[16] != 0;
+            std::array<double, 2 * LIMBS> parts;
+            std::memcpy(parts.data(), record.data() + ROOT_RECORD_FIXED_BYTES, sizeof(parts));
+            entry.rc = load(parts.data());
+            entry.log_abs_d = load(parts.data() + LIMBS);
+            entries[rank] = entry;
+            record_count++;
+        }
+        return true;
+    }
+
+public:
+    // Open the log at path. With resume the records of an earlier run of the same sweep are kept and new ones are
+    // appended, otherwise the log is started over.
+    SweepRootLog(const std::string &path, size_t cutoff, const Real &tol, bool resume)
+    {
+        SweepRootLogHeader header = make_header(cutoff);
+        std::array<double, LIMBS> tol_parts = to_double_expansion<LIMBS>(tol);
+        if (resume && read(path, header, tol_parts))
+        {
+            // drop a partial record at the end so new records stay aligned
+            boost::filesystem::resize_file(path, sizeof(header) + sizeof(tol_parts) + record_count * ROOT_RECORD_BYTES);
+            out.open(path, std::ios::binary | std::ios::app);
+        }
+        else
+        {
+            entries.clear();
+        }
+
+        if (!out.is_open())
+        {
+            out.open(path, std::ios::binary | std::ios::trunc);
+            out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+            out.write(reinterpret_cast<const char *>(tol_parts.data()), sizeof(tol_parts));
+            out.flush();
+        }
+        if (!out)
+        {
+            throw std::runtime_error(fmt::format("cannot open {}", path));
+        }
+    }
+
+    // the earlier solve of the candidate pair of this rank, if it was made for the same cell
+    const Entry *find(size_t rank, size_t row, size_t col) const
+    {
+        auto it = entries.find(rank);
+        if (it == entries.end() || it->second.row != static_cast<int32_t>(row) ||
+            it->second.col != static_cast<int32_t>(col))
+        {
+            return nullptr;
+        }
+        return &it->second;
+    }
+
+    // append a finished solve, called from the solving threads
+    void record(size_t rank, size_t row, size_t col, bool success, const Real &rc, const Real &log_abs_d)
+    {
+        std::array<char, ROOT_RECORD_BYTES> buffer{};
+        uint64_t rank_value = rank;
+        auto row_value = static_cast<int32_t>(row);
+        auto col_value = static_cast<int32_t>(col);
+        std::memcpy(buffer.data(), &rank_value, sizeof(rank_value));
+        std::memcpy(buffer.data() + 8, &row_value, sizeof(row_value));
+        std::memcpy(buffer.data() + 12, &col_value, sizeof(col_value));
+        buffer[16] = success ? 1 : 0;
+        auto rc_parts = to_double_expansion<LIMBS>(rc);
+        auto log_abs_d_parts = to_double_expansion<LIMBS>(log_abs_d);
+        std::memcpy(buffer.data() + ROOT_RECORD_FIXED_BYTES, rc_parts.data(), sizeof(rc_parts));
+        std::memcpy(buffer.data() + ROOT_RECORD_FIXED_BYTES + sizeof(rc_parts), log_abs_d_parts.data(),
+                    sizeof(log_abs_d_parts));
+
+        std::lock_guard<std::mutex> lock(mutex);
+        out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        // a root solve takes far longer than handing its record to the OS
+        out.flush();
+    }
+
+    size_t size() const
+    {
+        return entries.size();
+    }
+};
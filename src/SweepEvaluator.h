@@ -0,0 +1,228 @@
+#pragma once
+
+#include "ForwardRayTracing.h"
+
+#include "SweepGrid.h"
+#include "RayClassifier.h"
+#include "CaseBinnedExecutor.h"
+#include "Tracing.h"
+
+#include <array>
+#include <vector>
+#include <oneapi/tbb.h>
+
+#include <boost/geometry.hpp>
+#include <boost/geometry/geometries/point.hpp>
+
+// (row, col) of a sweep cell
+using SweepPoint = boost::geometry::model::point<int, 2, boost::geometry::cs::cartesian>;
+
+// The ray tracing stage of sweep_rc_d: classifies, prepares and traces the cells of a block of grid rows and stores
+// theta, phi, lambda, eta, delta_theta, delta_phi and the RayStatus of every cell into a set of maps. The maps are any
+// type with these matrices as members, holding all the columns and the rows from row_offset on, so the same stage
+// fills the full maps of SweepResult or the bounded bands of the streaming sweep.
+template <typename Real, typename Complex>
+class SweepEvaluator
+{
+private:
+    using StatusCount = std::array<size_t, RAY_STATUS_COUNT>;
+
+    const ForwardRayTracingParams<Real> &params;
+    const Real &theta_o;
+    const Real &phi_o;
+    const std::vector<Real> &rc_list;
+    const std::vector<Real> &lgd_list;
+
+    // per-column critical curve data, per-row d and the analytic validity of every cell
+    SweepGrid<Real> grid;
+    // cells whose status is known analytically are not traced
+    RayClassifier<Real> classifier;
+
+    oneapi::tbb::enumerable_thread_specific<StatusCount> status_count_local;
+    oneapi::tbb::enumerable_thread_specific<size_t> classified_count_local;
+    oneapi::tbb::enumerable_thread_specific<CaseBinnedExecutor<Real, Complex>> executor_local;
+    // per-thread scratch kept between tiles, so multiprecision numbers are not reallocated for every tile
+    oneapi::tbb::enumerable_thread_specific<ForwardRayTracingParams<Real>> params_local;
+    oneapi::tbb::enumerable_thread_specific<std::vector<RayStatus>> tile_status_local;
+
+    template <typename Maps>
+    void evaluate_tile(const oneapi::tbb::blocked_range2d<size_t, size_t> &r, Maps &maps, size_t row_offset)
+    {
+        TraceSpan span("tile", "sweep");
+        span.set_args([&]
+                      { return fmt::format(R"("rows":[{},{}],"cols":[{},{}])", r.rows().begin(), r.rows().end(), r.cols().begin(), r.cols().end()); });
+        auto ray_tracing = ForwardRayTracing<Real, Complex>::get_from_cache();
+        ForwardRayTracingParams<Real> &local_params = params_local.local();
+        StatusCount &status_count = status_count_local.local();
+        size_t &classified_count = classified_count_local.local();
+        CaseBinnedExecutor<Real, Complex> &executor = executor_local.local();
+
+        size_t row_begin = r.rows().begin();
+        size_t col_begin = r.cols().begin();
+        size_t tile_cols = r.cols().size();
+
+        auto store_cell = [&](size_t i, size_t j, RayStatus status)
+        {
+            status_count[static_cast<size_t>(status)]++;
+            size_t row = i - row_offset;
+            maps.status(row, j) = static_cast<uint8_t>(status);
+            if (status == RayStatus::NORMAL)
+            {
+                maps.theta(row, j) = ray_tracing->theta_f;
+                maps.phi(row, j) = ray_tracing->phi_f;
+                maps.delta_theta(row, j) = maps.theta(row, j) - theta_o;
+                maps.delta_phi(row, j) = sin((maps.phi(row, j) - phi_o) * half<Real>());
+                maps.lambda(row, j) = ray_tracing->lambda;
+                maps.eta(row, j) = ray_tracing->eta;
+            }
+            else
+            {
+                maps.theta(row, j) = std::numeric_limits<Real>::quiet_NaN();
+                maps.phi(row, j) = std::numeric_limits<Real>::quiet_NaN();
+                maps.delta_theta(row, j) = std::numeric_limits<Real>::quiet_NaN();
+                maps.delta_phi(row, j) = std::numeric_limits<Real>::quiet_NaN();
+                maps.lambda(row, j) = std::numeric_limits<Real>::quiet_NaN();
+                maps.eta(row, j) = std::numeric_limits<Real>::quiet_NaN();
+            }
+        };
+
+        std::vector<RayStatus> &tile_status = tile_status_local.local();
+        classifier.classify_tile(grid, r.rows().begin(), r.rows().end(), r.cols().begin(), r.cols().end(),
+                                 tile_status);
+
+        // phase one: roots and radial case of every cell of the tile
+        size_t k = 0;
+        for (size_t i = r.rows().begin(); i != r.rows().end(); ++i)
+        {
+            for (size_t j = r.cols().begin(); j != r.cols().end(); ++j, ++k)
+            {
+                RayStatus status = tile_status[k];
+                if (status == RayStatus::NORMAL)
+                {
+                    local_params.rc = rc_list[j];
+                    local_params.log_abs_d = lgd_list[i];
+                    grid.cell_lambda_q(i, j, local_params.lambda, local_params.q);
+                    status = executor.prepare(*ray_tracing, k, local_params);
+                    if (status == RayStatus::NORMAL)
+                    {
+                        continue;
+                    }
+                }
+                else
+                {
+                    classified_count++;
+                }
+                store_cell(i, j, status);
+            }
+        }
+
+        // phase two: integrals case by case, scattered back into the maps
+        executor.execute(*ray_tracing,
+                         [&](size_t index, const ForwardRayTracing<Real, Complex> &)
+                         {
+                             store_cell(row_begin + index / tile_cols, col_begin + index % tile_cols,
+                                        ray_tracing->ray_status);
+                         });
+    }
+
+public:
+    // params must have its background built
+    SweepEvaluator(const ForwardRayTracingParams<Real> &params, const Real &theta_o, const Real &phi_o,
+                   const std::vector<Real> &rc_list, const std::vector<Real> &lgd_list)
+        : params(params), theta_o(theta_o), phi_o(phi_o), rc_list(rc_list), lgd_list(lgd_list),
+          grid(*params.background, params.d_sign, rc_list, lgd_list), classifier(params),
+          status_count_local(StatusCount{}), classified_count_local(0), params_local(params)
+    {
+    }
+
+    // trace the grid rows [row_begin, row_end) in parallel, grid row i is stored in row i - row_offset of maps
+    template <typename Maps>
+    void evaluate_rows(size_t row_begin, size_t row_end, Maps &maps, size_t row_offset = 0)
+    {
+        evaluate_block(row_begin, row_end, 0u, rc_list.size(), maps, row_offset);
+    }
+
+    // trace the cells of the grid rows [row_begin, row_end) and columns [col_begin, col_end)
+    template <typename Maps>
+    void evaluate_block(size_t row_begin, size_t row_end, size_t col_begin, size_t col_end, Maps &maps,
+                        size_t row_offset = 0)
+    {
+        oneapi::tbb::parallel_for(oneapi::tbb::blocked_range2d<size_t>(row_begin, row_end, col_begin, col_end),
+                                  [&](const oneapi::tbb::blocked_range2d<size_t, size_t> &r)
+                                  {
+                                      evaluate_tile(r, maps, row_offset);
+                                  });
+    }
+
+    // add the status counts of every row evaluated so far
+    void collect(StatusCount &status_count, size_t &classified_count)
+    {
+        status_count_local.combine_each([&](const StatusCount &count)
+                                        {
+                                            for (size_t k = 0; k < RAY_STATUS_COUNT; k++)
+                                            {
+                                                status_count[k] += count[k];
+                                            }
+                                        });
+        classified_count += classified_count_local.combine(std::plus<size_t>());
+    }
+};
+
+template <typename T>
+int sgn(T val)
+{
+    return (T(0) < val) - (val < T(0));
+}
+
+// Root candidates of the grid rows [row_begin, row_end): cells where delta_theta, or delta_phi with lambda keeping its
+// sign, changes sign against the left or the upper neighbour. Rows are grid rows stored from row_offset on in maps,
+// row_begin - 1 included, and row_begin >= 1. Only the columns [col_begin, col_end) are checked, col_begin >= 1 and
+// col_end is clamped to the columns of the maps.
+template <typename Maps>
+void detect_sweep_candidates(const Maps &maps, size_t row_begin, size_t row_end, size_t row_offset,
+                             tbb::concurrent_vector<SweepPoint> &theta_roots_index,
+                             tbb::concurrent_vector<SweepPoint> &phi_roots_index, size_t col_begin = 1,
+                             size_t col_end = std::numeric_limits<size_t>::max())
+{
+    const auto &delta_theta = maps.delta_theta;
+    const auto &delta_phi = maps.delta_phi;
+    const auto &lambda = maps.lambda;
+    col_end = std::min(col_end, static_cast<size_t>(maps.theta.cols()));
+    if (row_begin >= row_end || col_begin >= col_end)
+    {
+        return;
+    }
+    oneapi::tbb::parallel_for(oneapi::tbb::blocked_range2d<size_t>(row_begin, row_end, col_begin, col_end),
+                              [&](const oneapi::tbb::blocked_range2d<size_t, size_t> &r)
+                              {
+                                  int d_row, d_col, d_row_lambda, d_col_lambda;
+                                  for (size_t row = r.rows().begin(); row != r.rows().end(); ++row)
+                                  {
+                                      size_t i = row - row_offset;
+                                      for (size_t j = r.cols().begin(); j != r.cols().end(); ++j)
+                                      {
+                                          d_row = sgn(delta_theta(i, j)) * sgn(delta_theta(i, j - 1));
+                                          d_col = sgn(delta_theta(i, j)) * sgn(delta_theta(i - 1, j));
+                                          if (!isnan(delta_theta(i, j)) && !isnan(delta_theta(i, j - 1)) &&
+                                              !isnan(delta_theta(i - 1, j)) &&
+                                              (d_row <= 0 || d_col <= 0))
+                                          {
+                                              theta_roots_index.emplace_back(row, j);
+                                          }
+                                          d_row = sgn(delta_phi(i, j)) * sgn(delta_phi(i, j - 1));
+                                          d_col = sgn(delta_phi(i, j)) * sgn(delta_phi(i - 1, j));
+                                          d_row_lambda = sgn(lambda(i, j)) * sgn(lambda(i, j - 1));
+                                          d_col_lambda = sgn(lambda(i, j)) * sgn(lambda(i - 1, j));
+                                          if (!isnan(delta_phi(i, j)) && !isnan(delta_phi(i, j - 1)) &&
+                                              !isnan(delta_phi(i - 1, j)) &&
+                                              !isnan(lambda(i, j)) && !isnan(lambda(i, j - 1)) &&
+                                              !isnan(lambda(i - 1, j)) && d_row_lambda > 0 &&
+                                              d_col_lambda > 0 &&
+                                              (d_row <= 0 || d_col <= 0))
+                                          {
+                                              phi_roots_index.emplace_back(row, j);
+                                          }
+                                      }
+                                  }
+                              });
+}
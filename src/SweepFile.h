@@ -0,0 +1,542 @@
+#pragma once
+
+#include "Common.h"
+#include "FloatExpansion.h"
+#include "ForwardRayTracing.h"
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <oneapi/tbb.h>
+#include <Eigen/Dense>
+#include <unistd.h>
+
+// Sweep maps on disk, mapped instead of read. The file is native little-endian:
+//   SweepFileHeader
+//   a, r_s, theta_s, r_o, theta_o, phi_o
+//   rc_list, lgd_list
+//   theta, phi, lambda, eta, delta_theta, delta_phi, one map after another
+//   the RayStatus of every cell, one byte each, SWEEP_CELL_PENDING until the cell is written
+// Maps are row-major with rows of log_abs_d and columns of rc, and tiles are blocks of tile_rows full rows, so a tile
+// and a whole map are both contiguous. Every value is a double expansion of limbs parts (see FloatExpansion.h), the
+// parts of one value next to each other: limb 0 of any precision is a strided double view, and for double it is the
+// value itself. Sections start at multiples of SWEEP_FILE_ALIGNMENT bytes.
+
+enum class SweepMap : size_t
+{
+    THETA,
+    PHI,
+    LAMBDA,
+    ETA,
+    DELTA_THETA,
+    DELTA_PHI
+};
+
+constexpr size_t SWEEP_MAP_COUNT = 6;
+constexpr std::array<const char *, SWEEP_MAP_COUNT> SWEEP_MAP_NAMES = {"theta", "phi", "lambda", "eta",
+                                                                     "delta_theta", "delta_phi"};
+
+// a, r_s, theta_s, r_o, theta_o, phi_o
+constexpr size_t SWEEP_SCALAR_COUNT = 6;
+
+constexpr char SWEEP_FILE_MAGIC[8] = {'K', 'E', 'R', 'R', 'S', 'W', 'P', '\0'};
+constexpr uint32_t SWEEP_FILE_VERSION = 1;
+constexpr size_t SWEEP_FILE_ALIGNMENT = 64;
+constexpr uint8_t SWEEP_CELL_PENDING = 0xff;
+// limbs of the widest precision, a file of any precision can be read in any other
+constexpr size_t SWEEP_MAX_LIMBS = double_expansion_size<Float256>;
+
+inline SweepMap sweep_map_from_name(const std::string &name)
+{
+    for (size_t k = 0; k < SWEEP_MAP_COUNT; k++)
+    {
+        if (name == SWEEP_MAP_NAMES[k])
+        {
+            return static_cast<SweepMap>(k);
+        }
+    }
+    throw std::invalid_argument(fmt::format("unknown sweep map {}", name));
+}
+
+struct SweepFileHeader
+{
+    char magic[8];
+    uint32_t version;
+    // doubles per value
+    uint32_t limbs;
+    // TypeName of the Real the sweep ran in
+    char precision[32];
+    // log_abs_d, rc
+    uint64_t rows;
+    uint64_t cols;
+    uint64_t tile_rows;
+    int32_t nu_r;
+    int32_t nu_theta;
+    int32_t d_sign;
+    uint32_t reserved;
+    // byte offsets from the start of the file
+    uint64_t scalars_offset;
+    uint64_t rc_offset;
+    uint64_t lgd_offset;
+    uint64_t map_offset[SWEEP_MAP_COUNT];
+    uint64_t status_offset;
+    uint64_t file_size;
+};
+
+class SweepFile
+{
+public:
+    using MapView = Eigen::Map<const Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>,
+                               Eigen::Unaligned, Eigen::Stride<Eigen::Dynamic, Eigen::Dynamic>>;
+    using StatusView = Eigen::Map<const Eigen::Matrix<uint8_t, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>>;
+
+private:
+    boost::interprocess::file_mapping file;
+    boost::interprocess::mapped_region region;
+    std::string path;
+    char *base = nullptr;
+    SweepFileHeader header{};
+
+    static uint64_t align(uint64_t offset)
+    {
+        return (offset + SWEEP_FILE_ALIGNMENT - 1) / SWEEP_FILE_ALIGNMENT * SWEEP_FILE_ALIGNMENT;
+    }
+
+    static void check_byte_order()
+    {
+        const uint32_t probe = 1;
+        uint8_t first;
+        std::memcpy(&first, &probe, 1);
+        if (first != 1)
+        {
+            throw std::runtime_error("sweep files need a little-endian host");
+        }
+    }
+
+    double *values(uint64_t offset)
+    {
+        return reinterpret_cast<double *>(base + offset);
+    }
+
+    const double *values(uint64_t offset) const
+    {
+        return reinterpret_cast<const double *>(base + offset);
+    }
+
+    template <typename Real>
+    void store(double *dest, const Real &value)
+    {
+        // the exponent range of double holds every map value, the expansion keeps the bits of Real
+        constexpr size_t N = double_expansion_size<Real>;
+        auto parts = to_double_expansion<N>(value);
+        std::copy(parts.begin(), parts.end(), dest);
+        std::fill(dest + N, dest + header.limbs, 0.0);
+    }
+
+    template <typename Real>
+    Real load(const double *src) const
+    {
+        // the parts a narrower file lacks are zero
+        std::array<double, SWEEP_MAX_LIMBS> parts{};
+        std::copy(src, src + header.limbs, parts.begin());
+        return from_double_expansion<Real, SWEEP_MAX_LIMBS>(parts);
+    }
+
+    // maps are only written and read in the precision of the file
+    template <typename Real>
+    void check_precision() const
+    {
+        if (precision() != TypeName<Real>::Get() || header.limbs != double_expansion_size<Real>)
+        {
+            throw std::invalid_argument(fmt::format("{} holds a {} sweep of {} limbs, not {}", path, precision(),
+                                                    header.limbs, TypeName<Real>::Get()));
+        }
+    }
+
+    void map_file(const std::string &file_path, boost::interprocess::mode_t mode)
+    {
+        using namespace boost::interprocess;
+        check_byte_order();
+        path = file_path;
+        file = file_mapping(file_path.c_str(), mode);
+        region = mapped_region(file, mode);
+        base = static_cast<char *>(region.get_address());
+
+        if (region.get_size() < sizeof(SweepFileHeader))
+        {
+            throw std::runtime_error(fmt::format("{} is not a sweep file", file_path));
+        }
+        std::memcpy(&header, base, sizeof(header));
+        if (std::memcmp(header.magic, SWEEP_FILE_MAGIC, sizeof(SWEEP_FILE_MAGIC)) != 0 ||
+            header.version != SWEEP_FILE_VERSION)
+        {
+            throw std::runtime_error(fmt::format("{} is not a sweep file of version {}", file_path,
+                                                 SWEEP_FILE_VERSION));
+        }
+        if (header.limbs == 0 || header.limbs > SWEEP_MAX_LIMBS)
+        {
+            throw std::runtime_error(fmt::format("{} has {} limbs per value", file_path, header.limbs));
+        }
+        if (header.file_size != region.get_size())
+        {
+            throw std::runtime_error(fmt::format("{} is truncated", file_path));
+        }
+    }
+
+public:
+    SweepFile() = default;
+    SweepFile(const SweepFile &) = delete;
+    SweepFile &operator=(const SweepFile &) = delete;
+    SweepFile(SweepFile &&) = default;
+    SweepFile &operator=(SweepFile &&) = default;
+
+    // Map an existing file, read-only unless writable is set
+    explicit SweepFile(const std::string &file_path, bool writable = false)
+    {
+        map_file(file_path, writable ? boost::interprocess::read_write : boost::interprocess::read_only);
+    }
+
+    // Create a file for a sweep over rc_list and lgd_list and map it for writing. Maps are NaN and every cell is
+    // SWEEP_CELL_PENDING until its rows are written. The file is laid out under a temporary name next to file_path,
+    // unique to the process and the call, and renamed when it is complete: a crash while creating it leaves no file
+    // at file_path, and concurrent creates of one path do not share a temporary file.
+    template <typename Real>
+    static SweepFile create(const std::string &file_path, const ForwardRayTracingParams<Real> &params,
+                            const Real &theta_o, const Real &phi_o, const std::vector<Real> &rc_list,
+                            const std::vector<Real> &lgd_list, size_t tile_rows = 256)
+    {
+        check_byte_order();
+        SweepFileHeader header{};
+        std::memcpy(header.magic, SWEEP_FILE_MAGIC, sizeof(SWEEP_FILE_MAGIC));
+        header.version = SWEEP_FILE_VERSION;
+        header.limbs = static_cast<uint32_t>(double_expansion_size<Real>);
+        std::string precision = TypeName<Real>::Get();
+        std::strncpy(header.precision, precision.c_str(), sizeof(header.precision) - 1);
+        header.rows = lgd_list.size();
+        header.cols = rc_list.size();
+        header.tile_rows = std::max<size_t>(tile_rows, 1);
+        header.nu_r = static_cast<int32_t>(params.nu_r);
+        header.nu_theta = static_cast<int32_t>(params.nu_theta);
+        header.d_sign = static_cast<int32_t>(params.d_sign);
+
+        uint64_t value_bytes = header.limbs * sizeof(double);
+        uint64_t offset = align(sizeof(SweepFileHeader));
+        header.scalars_offset = offset;
+        offset = align(offset + SWEEP_SCALAR_COUNT * value_bytes);
+        header.rc_offset = offset;
+        offset = align(offset + header.cols * value_bytes);
+        header.lgd_offset = offset;
+        offset = align(offset + header.rows * value_bytes);
+        for (uint64_t &map_offset : header.map_offset)
+        {
+            map_offset = offset;
+            offset = align(offset + header.rows * header.cols * value_bytes);
+        }
+        header.status_offset = offset;
+        header.file_size = align(offset + header.rows * header.cols);
+
+        // every cell is pending before anything else is written, and the file only appears at file_path complete
+        std::string tmp_path = fmt::format("{}.{}{}", file_path, getpid(),
+                                           boost::filesystem::unique_path("-%%%%-%%%%-%%%%.tmp").string());
+        try
+        {
+            {
+                std::ofstream ofs(tmp_path, std::ios::binary | std::ios::trunc);
+                if (!ofs)
+                {
+                    throw std::runtime_error(fmt::format("cannot open {}", tmp_path));
+                }
+                ofs.write(reinterpret_cast<const char *>(&header), sizeof(header));
+            }
+            boost::filesystem::resize_file(tmp_path, header.file_size);
+
+            SweepFile sweep_file(tmp_path, true);
+            std::memset(sweep_file.base + header.status_offset, SWEEP_CELL_PENDING, header.rows * header.cols);
+            const std::array<const Real *, SWEEP_SCALAR_COUNT> scalars = {&params.a, &params.r_s, &params.theta_s,
+                                                                           &params.r_o, &theta_o, &phi_o};
+            for (size_t k = 0; k < SWEEP_SCALAR_COUNT; k++)
+            {
+                sweep_file.store(sweep_file.values(header.scalars_offset) + k * header.limbs, *scalars[k]);
+            }
+            for (size_t j = 0; j < rc_list.size(); j++)
+            {
+                sweep_file.store(sweep_file.values(header.rc_offset) + j * header.limbs, rc_list[j]);
+            }
+            for (size_t i = 0; i < lgd_list.size(); i++)
+            {
+                sweep_file.store(sweep_file.values(header.lgd_offset) + i * header.limbs, lgd_list[i]);
+            }
+            for (uint64_t map_offset : header.map_offset)
+            {
+                std::fill_n(sweep_file.values(map_offset), header.rows * header.cols * header.limbs,
+                            std::numeric_limits<double>::quiet_NaN());
+            }
+            sweep_file.flush();
+            // the mapping follows the file to its new name
+            boost::filesystem::rename(tmp_path, file_path);
+            sweep_file.path = file_path;
+            return sweep_file;
+        }
+        catch (...)
+        {
+            boost::system::error_code ec;
+            boost::filesystem::remove(tmp_path, ec);
+            throw;
+        }
+    }
+
+    const std::string &file_path() const
+    {
+        return path;
+    }
+
+    size_t rows() const
+    {
+        return header.rows;
+    }
+
+    size_t cols() const
+    {
+        return header.cols;
+    }
+
+    size_t limbs() const
+    {
+        return header.limbs;
+    }
+
+    std::string precision() const
+    {
+        return std::string(header.precision, strnlen(header.precision, sizeof(header.precision)));
+    }
+
+    size_t tile_rows() const
+    {
+        return header.tile_rows;
+    }
+
+    size_t tile_count() const
+    {
+        return (header.rows + header.tile_rows - 1) / header.tile_rows;
+    }
+
+    // Write the grid rows [row_begin, row_end) of a set of maps (see SweepEvaluator), stored from row_offset on.
+    // Rows are converted in parallel straight into the mapped file.
+    template <typename Maps>
+    void write_rows(const Maps &maps, size_t row_begin, size_t row_end, size_t row_offset = 0)
+    {
+        using Real = typename std::decay_t<decltype(maps.theta)>::Scalar;
+        check_precision<Real>();
+        const std::array<const std::decay_t<decltype(maps.theta)> *, SWEEP_MAP_COUNT> sources = {
+            &maps.theta, &maps.phi, &maps.lambda, &maps.eta, &maps.delta_theta, &maps.delta_phi};
+        size_t cols = header.cols;
+        uint8_t *status = reinterpret_cast<uint8_t *>(base + header.status_offset);
+        oneapi::tbb::parallel_for(oneapi::tbb::blocked_range<size_t>(row_begin, row_end),
+                                  [&](const oneapi::tbb::blocked_range<size_t> &r)
+                                  {
+                                      for (size_t i = r.begin(); i != r.end(); ++i)
+                                      {
+                                          size_t row = i - row_offset;
+                                          for (size_t k = 0; k < SWEEP_MAP_COUNT; k++)
+                                          {
+                                              double *dest = values(header.map_offset[k]) + i * cols * header.limbs;
+                                              for (size_t j = 0; j < cols; j++)
+                                              {
+                                                  store(dest + j * header.limbs, (*sources[k])(row, j));
+                                              }
+                                          }
+                                          for (size_t j = 0; j < cols; j++)
+                                          {
+                                              status[i * cols + j] = maps.status(row, j);
+                                          }
+                                      }
+                                  });
+    }
+
+    // Read the grid rows [row_begin, row_end) into a set of maps, stored from row_offset on
+    template <typename Maps>
+    void read_rows(Maps &maps, size_t row_begin, size_t row_end, size_t row_offset = 0) const
+    {
+        using Real = typename std::decay_t<decltype(maps.theta)>::Scalar;
+        check_precision<Real>();
+        const std::array<std::decay_t<decltype(maps.theta)> *, SWEEP_MAP_COUNT> dests = {
+            &maps.theta, &maps.phi, &maps.lambda, &maps.eta, &maps.delta_theta, &maps.delta_phi};
+        size_t cols = header.cols;
+        StatusView status_view = status();
+        oneapi::tbb::parallel_for(oneapi::tbb::blocked_range<size_t>(row_begin, row_end),
+                                  [&](const oneapi::tbb::blocked_range<size_t> &r)
+                                  {
+                                      for (size_t i = r.begin(); i != r.end(); ++i)
+                                      {
+                                          size_t row = i - row_offset;
+                                          for (size_t k = 0; k < SWEEP_MAP_COUNT; k++)
+                                          {
+                                              const double *src = values(header.map_offset[k]) + i * cols * header.limbs;
+                                              for (size_t j = 0; j < cols; j++)
+                                              {
+                                                  (*dests[k])(row, j) = load<Real>(src + j * header.limbs);
+                                              }
+                                          }
+                                          for (size_t j = 0; j < cols; j++)
+                                          {
+                                              maps.status(row, j) = status_view(i, j);
+                                          }
+                                      }
+                                  });
+    }
+
+    // Zero-copy view of one limb of a map, limb 0 is the value rounded to double
+    MapView map(SweepMap sweep_map, size_t limb = 0) const
+    {
+        return MapView(values(header.map_offset[static_cast<size_t>(sweep_map)]) + limb, header.rows, header.cols,
+                       Eigen::Stride<Eigen::Dynamic, Eigen::Dynamic>(header.cols * header.limbs, header.limbs));
+    }
+
+    // Zero-copy view of one limb of the rows of a tile
+    MapView tile(SweepMap sweep_map, size_t tile_index, size_t limb = 0) const
+    {
+        size_t row_begin = tile_index * header.tile_rows;
+        size_t tile_rows = std::min<size_t>(header.tile_rows, header.rows - row_begin);
+        return MapView(values(header.map_offset[static_cast<size_t>(sweep_map)]) +
+                           row_begin * header.cols * header.limbs + limb,
+                       tile_rows, header.cols,
+                       Eigen::Stride<Eigen::Dynamic, Eigen::Dynamic>(header.cols * header.limbs, header.limbs));
+    }
+
+    StatusView status() const
+    {
+        return StatusView(reinterpret_cast<const uint8_t *>(base + header.status_offset), header.rows, header.cols);
+    }
+
+    // true once every cell of the rows [row_begin, row_end) has been written
+    bool rows_written(size_t row_begin, size_t row_end) const
+    {
+        StatusView status_view = status();
+        for (size_t i = row_begin; i < row_end; i++)
+        {
+            for (size_t j = 0; j < header.cols; j++)
+            {
+                if (status_view(i, j) == SWEEP_CELL_PENDING)
+                {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    // true if the file holds a sweep of this precision, a, r_s, theta_s, r_o, signs and axes
+    template <typename Real>
+    bool matches(const ForwardRayTracingParams<Real> &params, const std::vector<Real> &rc_list,
+                 const std::vector<Real> &lgd_list) const
+    {
+        if (precision() != TypeName<Real>::Get() || rows() != lgd_list.size() || cols() != rc_list.size())
+        {
+            return false;
+        }
+        auto stored = this->params<Real>();
+        return stored.a == params.a && stored.r_s == params.r_s && stored.theta_s == params.theta_s &&
+               stored.r_o == params.r_o && stored.nu_r == params.nu_r && stored.nu_theta == params.nu_theta &&
+               stored.d_sign == params.d_sign && this->rc_list<Real>() == rc_list &&
+               this->lgd_list<Real>() == lgd_list;
+    }
+
+    template <typename Real>
+    Real value(SweepMap sweep_map, size_t i, size_t j) const
+    {
+        return load<Real>(values(header.map_offset[static_cast<size_t>(sweep_map)]) +
+                          (i * header.cols + j) * header.limbs);
+    }
+
+    template <typename Real>
+    std::vector<Real> rc_list() const
+    {
+        std::vector<Real> list(header.cols);
+        for (size_t j = 0; j < header.cols; j++)
+        {
+            list[j] = load<Real>(values(header.rc_offset) + j * header.limbs);
+        }
+        return list;
+    }
+
+    template <typename Real>
+    std::vector<Real> lgd_list() const
+    {
+        std::vector<Real> list(header.rows);
+        for (size_t i = 0; i < header.rows; i++)
+        {
+            list[i] = load<Real>(values(header.lgd_offset) + i * header.limbs);
+        }
+        return list;
+    }
+
+    // a, r_s, theta_s, r_o and the signs of the sweep
+    template <typename Real>
+    ForwardRayTracingParams<Real> params() const
+    {
+        ForwardRayTracingParams<Real> params;
+        const double *scalars = values(header.scalars_offset);
+        params.a = load<Real>(scalars);
+        params.r_s = load<Real>(scalars + header.limbs);
+        params.theta_s = load<Real>(scalars + 2 * header.limbs);
+        params.r_o = load<Real>(scalars + 3 * header.limbs);
+        params.nu_r = static_cast<Sign>(header.nu_r);
+        params.nu_theta = static_cast<Sign>(header.nu_theta);
+        params.d_sign = static_cast<Sign>(header.d_sign);
+        return params;
+    }
+
+    template <typename Real>
+    Real theta_o() const
+    {
+        return load<Real>(values(header.scalars_offset) + 4 * header.limbs);
+    }
+
+    template <typename Real>
+    Real phi_o() const
+    {
+        return load<Real>(values(header.scalars_offset) + 5 * header.limbs);
+    }
+
+    const char *data() const
+    {
+        return base;
+    }
+
+    size_t map_offset(SweepMap sweep_map) const
+    {
+        return header.map_offset[static_cast<size_t>(sweep_map)];
+    }
+
+    size_t status_offset() const
+    {
+        return header.status_offset;
+    }
+
+    // write the mapped pages back to the file
+    void flush()
+    {
+        region.flush();
+    }
+};
+
+// Write the maps of a finished sweep (SweepResult or any maps holding every row) to a new sweep file
+template <typename Real, typename Maps>
+SweepFile write_sweep_file(const std::string &file_path, const Maps &maps, const ForwardRayTracingParams<Real> &params,
+                           const Real &theta_o, const Real &phi_o, const std::vector<Real> &rc_list,
+                           const std::vector<Real> &lgd_list)
+{
+    SweepFile sweep_file = SweepFile::create(file_path, params, theta_o, phi_o, rc_list, lgd_list);
+    sweep_file.write_rows(maps, 0, lgd_list.size());
+    sweep_file.flush();
+    return sweep_file;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "ForwardRayTracing.h"
+
+#include <vector>
+#include <oneapi/tbb.h>
+#include <Eigen/Dense>
+
+// Separable parameterization of the rc - log_abs_d grid. The critical curve data only depends on the column (rc) and
+// d only depends on the row (log_abs_d), so both are computed once per axis; a cell is then formed by two
+// multiply-adds. The analytic validity of every cell is known before any ray is traced. Memory is linear in the axes,
+// so the grid can back sweeps that never hold a full map.
+template <typename Real>
+struct SweepGrid
+{
+    using ColumnMask = Eigen::Array<bool, 1, Eigen::Dynamic>;
+
+    std::vector<CriticalCurvePoint<Real>> columns;
+    std::vector<Real> d;
+
+    Sign d_sign;
+
+    // rc inside the range of spherical photon orbits
+    ColumnMask column_valid;
+
+    SweepGrid(const KerrBackground<Real> &bg, Sign d_sign, const std::vector<Real> &rc_list,
+              const std::vector<Real> &lgd_list)
+        : columns(rc_list.size()), d(lgd_list.size()), d_sign(d_sign)
+    {
+        size_t rc_size = rc_list.size();
+        size_t lgd_size = lgd_list.size();
+
+        column_valid.resize(rc_size);
+        oneapi::tbb::parallel_for(oneapi::tbb::blocked_range<size_t>(0u, rc_size),
+                                  [&](const oneapi::tbb::blocked_range<size_t> &r)
+                                  {
+                                      for (size_t j = r.begin(); j != r.end(); ++j)
+                                      {
+                                          const Real &rc = rc_list[j];
+                                          column_valid[j] = rc >= bg.rc_down && rc <= bg.rc_up;
+                                          if (column_valid[j])
+                                          {
+                                              columns[j] = CriticalCurvePoint<Real>(bg, rc);
+                                          }
+                                      }
+                                  });
+
+        oneapi::tbb::parallel_for(oneapi::tbb::blocked_range<size_t>(0u, lgd_size),
+                                  [&](const oneapi::tbb::blocked_range<size_t> &r)
+                                  {
+                                      for (size_t i = r.begin(); i != r.end(); ++i)
+                                      {
+                                          d[i] = signed_d(d_sign, lgd_list[i]);
+                                      }
+                                  });
+    }
+
+    size_t rows() const
+    {
+        return d.size();
+    }
+
+    size_t cols() const
+    {
+        return columns.size();
+    }
+
+    // column_valid, and q >= 0 if d_sign is NEGATIVE
+    bool valid(size_t i, size_t j) const
+    {
+        if (!column_valid[j])
+        {
+            return false;
+        }
+        // q = qc + d * q_dir < 0 once |d| is large enough
+        const CriticalCurvePoint<Real> &point = columns[j];
+        return d_sign != Sign::NEGATIVE || !(point.qc + d[i] * point.q_dir < 0);
+    }
+
+    void cell_lambda_q(size_t i, size_t j, Real &lambda, Real &q) const
+    {
+        columns[j].to_lambda_q(d[i], lambda, q);
+    }
+};
@@ -0,0 +1,147 @@
+#pragma once
+
+#include "SweepEvaluator.h"
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <Eigen/Dense>
+
+// Row bands of the streaming sweep. A band holds one halo row, the last row of the previous band, followed by the
+// rows of the band itself, so the sign changes against the upper neighbour are found without the rows above. The maps
+// of one band are reused for the next one and peak memory is set by band_rows, not by the size of the grid.
+template <typename Real>
+struct SweepBand
+{
+    using Matrix = Eigen::Matrix<Real, Eigen::Dynamic, Eigen::Dynamic>;
+    using StatusMatrix = Eigen::Matrix<uint8_t, Eigen::Dynamic, Eigen::Dynamic>;
+
+    // grid rows [row_begin, row_end) are in rows halo .. halo + row_end - row_begin of the maps
+    size_t row_begin = 0;
+    size_t row_end = 0;
+    // 1 if row 0 of the maps is grid row row_begin - 1, 0 for the first band
+    size_t halo = 0;
+
+    Matrix theta;
+    Matrix phi;
+
+    Matrix lambda;
+    Matrix eta;
+
+    Matrix delta_theta;
+    Matrix delta_phi;
+
+    StatusMatrix status;
+
+    // candidates found in the rows of this band
+    std::vector<SweepPoint> theta_candidates;
+    std::vector<SweepPoint> phi_candidates;
+
+    // grid row of row 0 of the maps
+    size_t row_offset() const
+    {
+        return row_begin - halo;
+    }
+
+    void resize(size_t rows, size_t cols)
+    {
+        theta.resize(rows, cols);
+        phi.resize(rows, cols);
+        lambda.resize(rows, cols);
+        eta.resize(rows, cols);
+        delta_theta.resize(rows, cols);
+        delta_phi.resize(rows, cols);
+        status.resize(rows, cols);
+    }
+
+    // keep the last row of the band as the halo of the next one
+    void shift_halo()
+    {
+        size_t last = halo + row_end - row_begin - 1;
+        for (Matrix *map : {&theta, &phi, &lambda, &eta, &delta_theta, &delta_phi})
+        {
+            map->row(0) = map->row(last);
+        }
+        status.row(0) = status.row(last);
+        halo = 1;
+    }
+};
+
+template <typename Real>
+struct SweepStreamSettings
+{
+    // rows of the grid traced at once
+    size_t band_rows = 256;
+    // if not empty, the maps are written band by band to a sweep file at this path, see SweepFile, and the root solves
+    // are logged to spill_path + ".roots", see SweepRootLog
+    std::string spill_path;
+    // continue an interrupted sweep from the files at spill_path: bands already in the sweep file are read instead of
+    // traced and logged root solves are replayed. Files of another sweep are started over.
+    bool resume = false;
+    // called after every band with its maps and its new candidates
+    std::function<void(const SweepBand<Real> &)> on_band;
+};
+
+// Two rows of the grid columns [col_begin, col_end) for the candidate-only sweep, the previous row in row 0 and the
+// current one in row 1. The maps are indexed by grid column like full maps, so SweepEvaluator and
+// detect_sweep_candidates run on it unchanged.
+template <typename Real>
+struct SweepWindow
+{
+    template <typename Scalar>
+    struct Map
+    {
+        Eigen::Matrix<Scalar, 2, Eigen::Dynamic> values;
+        size_t col_offset = 0;
+
+        Scalar &operator()(size_t i, size_t j)
+        {
+            return values(i, j - col_offset);
+        }
+
+        const Scalar &operator()(size_t i, size_t j) const
+        {
+            return values(i, j - col_offset);
+        }
+
+        // the grid columns up to the end of the window
+        size_t cols() const
+        {
+            return col_offset + values.cols();
+        }
+    };
+
+    Map<Real> theta;
+    Map<Real> phi;
+
+    Map<Real> lambda;
+    Map<Real> eta;
+
+    Map<Real> delta_theta;
+    Map<Real> delta_phi;
+
+    Map<uint8_t> status;
+
+    SweepWindow(size_t col_begin, size_t col_end)
+    {
+        for (Map<Real> *map : {&theta, &phi, &lambda, &eta, &delta_theta, &delta_phi})
+        {
+            map->values.resize(2, col_end - col_begin);
+            map->col_offset = col_begin;
+        }
+        status.values.resize(2, col_end - col_begin);
+        status.col_offset = col_begin;
+    }
+
+    // make the current row the previous one
+    void shift_row()
+    {
+        for (Map<Real> *map : {&theta, &phi, &lambda, &eta, &delta_theta, &delta_phi})
+        {
+            map->values.row(0) = map->values.row(1);
+        }
+        status.values.row(0) = status.values.row(1);
+    }
+};
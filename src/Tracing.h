@@ -0,0 +1,225 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <fmt/format.h>
+#include <oneapi/tbb/enumerable_thread_specific.h>
+
+// One complete span of a trace. name and category must be string literals, args is the body of a JSON object whose
+// strings are escaped with Tracing::escape.
+struct TraceEvent
+{
+    const char *name;
+    const char *category;
+    size_t thread;
+    int64_t begin_ns;
+    int64_t end_ns;
+    std::string args;
+};
+
+// Timeline of sweep tiles and root solves, written as Chrome trace JSON (chrome://tracing, ui.perfetto.dev).
+// Tracing is switched at runtime: spans created while it is stopped cost one relaxed load and record nothing. Every
+// thread appends to its own buffer, collect() and the writers should only be called when no sweep is running.
+class Tracing
+{
+private:
+    struct Local
+    {
+        size_t thread = next_thread.fetch_add(1, std::memory_order_relaxed);
+        std::vector<TraceEvent> events;
+    };
+
+    inline static std::atomic<bool> active{false};
+    inline static std::atomic<size_t> next_thread{0};
+    inline static std::atomic<int64_t> epoch_ns{0};
+    inline static oneapi::tbb::enumerable_thread_specific<Local> locals;
+
+    static int64_t now_ns()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+    }
+
+public:
+    // str as the contents of a JSON string: quotes, backslashes and control characters escaped
+    static std::string escape(std::string_view str)
+    {
+        std::string result;
+        result.reserve(str.size());
+        for (char c : str)
+        {
+            switch (c)
+            {
+            case '"':
+                result += "\\\"";
+                break;
+            case '\\':
+                result += "\\\\";
+                break;
+            case '\n':
+                result += "\\n";
+                break;
+            case '\r':
+                result += "\\r";
+                break;
+            case '\t':
+                result += "\\t";
+                break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20)
+                {
+                    result += fmt::format("\\u{:04x}", static_cast<unsigned char>(c));
+                }
+                else
+                {
+                    result.push_back(c);
+                }
+            }
+        }
+        return result;
+    }
+
+    // drop the events of the previous trace and start recording
+    static void start()
+    {
+        clear();
+        epoch_ns.store(now_ns(), std::memory_order_relaxed);
+        active.store(true, std::memory_order_release);
+    }
+
+    static void stop()
+    {
+        active.store(false, std::memory_order_release);
+    }
+
+    static bool enabled()
+    {
+        return active.load(std::memory_order_relaxed);
+    }
+
+    static void clear()
+    {
+        for (Local &local : locals)
+        {
+            local.events.clear();
+        }
+    }
+
+    static void record(const char *name, const char *category, int64_t begin_ns, int64_t end_ns, std::string args)
+    {
+        Local &local = locals.local();
+        int64_t epoch = epoch_ns.load(std::memory_order_relaxed);
+        local.events.push_back(TraceEvent{name, category, local.thread, begin_ns - epoch, end_ns - epoch,
+                                          std::move(args)});
+    }
+
+    static std::vector<TraceEvent> collect()
+    {
+        std::vector<TraceEvent> events;
+        for (const Local &local : locals)
+        {
+            events.insert(events.end(), local.events.begin(), local.events.end());
+        }
+        return events;
+    }
+
+    static std::string to_chrome_trace()
+    {
+        std::string json = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+        bool first = true;
+        auto append = [&](const std::string &event)
+        {
+            if (!first)
+            {
+                json += ",\n";
+            }
+            first = false;
+            json += event;
+        };
+        for (const Local &local : locals)
+        {
+            if (local.events.empty())
+            {
+                continue;
+            }
+            append(fmt::format(R"({{"ph":"M","name":"thread_name","pid":0,"tid":{0},"args":{{"name":"worker {0}"}}}})",
+                               local.thread));
+            for (const TraceEvent &event : local.events)
+            {
+                // timestamps are in microseconds
+                append(fmt::format(R"({{"ph":"X","name":"{}","cat":"{}","pid":0,"tid":{},"ts":{:.3f},"dur":{:.3f},"args":{{{}}}}})",
+                                   escape(event.name), escape(event.category), event.thread, event.begin_ns * 1e-3,
+                                   (event.end_ns - event.begin_ns) * 1e-3, event.args));
+            }
+        }
+        json += "]}\n";
+        return json;
+    }
+
+    static void write_chrome_trace(const std::string &path)
+    {
+        std::ofstream file(path, std::ios::binary);
+        if (!file)
+        {
+            throw std::runtime_error(fmt::format("cannot open trace file {}", path));
+        }
+        file << to_chrome_trace();
+    }
+
+    friend class TraceSpan;
+};
+
+// Records the lifetime of a scope as one span if tracing was active when it was entered.
+class TraceSpan
+{
+private:
+    const char *name;
+    const char *category;
+    bool recording;
+    int64_t begin_ns = 0;
+    std::string args;
+
+public:
+    TraceSpan(const char *name_, const char *category_)
+        : name(name_), category(category_), recording(Tracing::enabled())
+    {
+        if (recording)
+        {
+            begin_ns = Tracing::now_ns();
+        }
+    }
+
+    TraceSpan(const TraceSpan &) = delete;
+    TraceSpan &operator=(const TraceSpan &) = delete;
+
+    bool is_recording() const
+    {
+        return recording;
+    }
+
+    // Set the args of the span. make_args() returns the body of a JSON object and is only called while recording.
+    template <typename ArgsFn>
+    void set_args(ArgsFn &&make_args)
+    {
+        if (recording)
+        {
+            args = make_args();
+        }
+    }
+
+    ~TraceSpan()
+    {
+        if (recording)
+        {
+            Tracing::record(name, category, begin_ns, Tracing::now_ns(), std::move(args));
+        }
+    }
+};
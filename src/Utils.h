@@ -3,8 +3,14 @@
 #include "ForwardRayTracing.h"
 
 #include "Broyden.h"
+#include "SweepEvaluator.h"
+#include "SweepStream.h"
+#include "SweepFile.h"
+#include "SweepCache.h"
+#include "SweepCheckpoint.h"
 
 #include <optional>
+#include <unordered_map>
 #include <oneapi/tbb.h>
 #include <Eigen/Dense>
 
@@ -18,6 +24,7 @@ struct SweepResult
 {
     using PointVector = Eigen::Matrix<Real, Eigen::Dynamic, 2>;
     using Matrix = Eigen::Matrix<Real, Eigen::Dynamic, Eigen::Dynamic>;
+    using StatusMatrix = Eigen::Matrix<uint8_t, Eigen::Dynamic, Eigen::Dynamic>;
 
     Matrix theta;
     Matrix phi;
@@ -28,12 +35,20 @@ struct SweepResult
     Matrix delta_theta;
     Matrix delta_phi;
 
+    // RayStatus of every cell
+    StatusMatrix status;
+
     PointVector theta_roots;
     PointVector phi_roots;
 
     PointVector theta_roots_closest;
 
     std::vector<ForwardRayTracingResult<Real, Complex>> results;
+
+    // number of cells per RayStatus
+    std::array<size_t, RAY_STATUS_COUNT> status_count = {};
+    // number of cells whose status was decided by RayClassifier without tracing the ray
+    size_t classified_count = 0;
 };
 
 template <typename LReal, typename LComplex, typename Real, typename Complex>
@@ -46,9 +61,12 @@ SweepResult<LReal, LComplex> get_low_prec(const SweepResult<Real, Complex> &x)
     result.eta = x.eta.template cast<LReal>();
     result.delta_theta = x.delta_theta.template cast<LReal>();
     result.delta_phi = x.delta_phi.template cast<LReal>();
+    result.status = x.status;
     result.theta_roots = x.theta_roots.template cast<LReal>();
     result.phi_roots = x.phi_roots.template cast<LReal>();
     result.theta_roots_closest = x.theta_roots_closest.template cast<LReal>();
+    result.status_count = x.status_count;
+    result.classified_count = x.classified_count;
     result.results.reserve(x.results.size());
     for (auto &res : x.results)
     {
@@ -62,6 +80,10 @@ struct FindRootResult
 {
     bool success;
     std::string fail_reason;
+    // status of the last ray of the solve, NORMAL if it only failed on the residual
+    RayStatus ray_status = RayStatus::NORMAL;
+    // Broyden iterations, 0 if the seed already satisfied the tolerance
+    size_t iterations = 0;
     std::optional<ForwardRayTracingResult<Real, Complex>> root;
 };
 
@@ -107,6 +129,7 @@ public:
     {
         auto &rc = x[0];
         auto &log_abs_d = x[1];
+        INSTRUMENT_COUNT(function_evaluations);
         params.rc = rc;
         params.log_abs_d = log_abs_d;
         params.rc_d_to_lambda_q();
@@ -114,10 +137,8 @@ public:
 
         if (ray_tracing->ray_status != RayStatus::NORMAL)
         {
-            if (params.print_args_error || ray_tracing->ray_status != RayStatus::ARGUMENT_ERROR)
-            {
-                fmt::println("ray status: {}", ray_status_to_str(ray_tracing->ray_status));
-            }
+            Diagnostics::report(ray_tracing->ray_status, "RootFunctor", "ray_status", [&]
+                                { return fmt::format("rc: {}, log_abs_d: {}", rc, log_abs_d); });
             return Vector::Constant(std::numeric_limits<Real>::quiet_NaN());
         }
 
@@ -140,12 +161,6 @@ public:
     }
 };
 
-template <typename T>
-int sgn(T val)
-{
-    return (T(0) < val) - (val < T(0));
-}
-
 // move phi to [0, 2pi)
 template <typename T>
 void wrap_phi(T &phi)
@@ -153,7 +168,7 @@ void wrap_phi(T &phi)
     const T &two_pi = boost::math::constants::two_pi<T>();
     if (phi < 0 || phi >= two_pi)
     {
-        phi -= two_pi * MY_FLOOR<T>::convert(phi / two_pi);
+        phi -= two_pi * floor(phi / two_pi);
     }
 }
 
@@ -171,15 +186,36 @@ struct ForwardRayTracingUtils
     calc_ray_batch(const std::vector<ForwardRayTracingParams<Real>> &params_list)
     {
         std::vector<ForwardRayTracingResult<Real, Complex>> results(params_list.size());
+        if (params_list.empty())
+        {
+            return results;
+        }
+
+        // rays of a batch usually share the spin, calc_ray only rebuilds the background if it does not match
+        auto background = params_list.front().background;
+        if (!background || !background->matches(params_list.front().a))
+        {
+            background = KerrBackground<Real>::create(params_list.front().a);
+        }
+        oneapi::tbb::enumerable_thread_specific<CaseBinnedExecutor<Real, Complex>> executor_local;
         oneapi::tbb::parallel_for(oneapi::tbb::blocked_range<size_t>(0u, params_list.size()),
                                   [&](const oneapi::tbb::blocked_range<size_t> &r)
                                   {
+                                      auto ray_tracing = ForwardRayTracing<Real, Complex>::get_from_cache();
+                                      ray_tracing->background = background;
+                                      CaseBinnedExecutor<Real, Complex> &executor = executor_local.local();
                                       for (size_t i = r.begin(); i != r.end(); ++i)
                                       {
-                                          auto ray_tracing = ForwardRayTracing<Real, Complex>::get_from_cache();
-                                          ray_tracing->calc_ray(params_list[i]);
-                                          results[i] = ray_tracing->to_result();
+                                          if (executor.prepare(*ray_tracing, i, params_list[i]) != RayStatus::NORMAL)
+                                          {
+                                              results[i] = ray_tracing->to_result();
+                                          }
                                       }
+                                      executor.execute(*ray_tracing,
+                                                       [&](size_t i, ForwardRayTracing<Real, Complex> &rt)
+                                                       {
+                                                           results[i] = rt.to_result();
+                                                       });
                                   });
         return results;
     }
@@ -187,6 +223,8 @@ struct ForwardRayTracingUtils
     static FindRootResult<Real, Complex>
     find_root_period(const ForwardRayTracingParams<Real> &params, int period, Real theta_o, Real phi_o, Real tol)
     {
+        INSTRUMENT_STAGE(Stage::ROOT_SOLVE);
+        INSTRUMENT_COUNT(root_solves);
         wrap_phi(phi_o);
         ForwardRayTracingParams<Real> local_params(params);
 
@@ -208,11 +246,13 @@ struct ForwardRayTracingUtils
 
         auto residual = root_functor(x);
         FindRootResult<Real, Complex> result;
+        result.iterations = settings.opt_iter;
 
         if (root_functor.ray_tracing->ray_status != RayStatus::NORMAL)
         {
             result.success = false;
-            result.fail_reason = fmt::format("ray status: {}", ray_status_to_str(root_functor.ray_tracing->ray_status));
+            result.ray_status = root_functor.ray_tracing->ray_status;
+            result.fail_reason = fmt::format("ray status: {}", ray_status_to_str(result.ray_status));
             return result;
         }
 
@@ -234,6 +274,26 @@ struct ForwardRayTracingUtils
         return result;
     }
 
+    // The root find_root_period converged to at (rc, log_abs_d), rebuilt with the same last evaluation of the root
+    // function, so it matches the original solve bit for bit
+    static ForwardRayTracingResult<Real, Complex>
+    replay_root(const ForwardRayTracingParams<Real> &params, int period, Real theta_o, Real phi_o, const Real &rc,
+                const Real &log_abs_d)
+    {
+        wrap_phi(phi_o);
+        ForwardRayTracingParams<Real> local_params(params);
+        Eigen::Vector<Real, 2> x;
+        x << rc, log_abs_d;
+        RootFunctor<Real, Complex> root_functor(local_params, period, std::move(theta_o), std::move(phi_o));
+        root_functor(x);
+
+        auto root = root_functor.ray_tracing->to_result();
+        root.rc = x[0];
+        root.log_abs_d = x[1];
+        root.d_sign = local_params.d_sign;
+        return root;
+    }
+
     static FindRootResult<Real, Complex>
     find_root(const ForwardRayTracingParams<Real> &params, Real theta_o, Real phi_o, Real tol)
     {
@@ -273,10 +333,17 @@ struct ForwardRayTracingUtils
     }
 
     static SweepResult<Real, Complex>
-    sweep_rc_d(const ForwardRayTracingParams<Real> &params, Real theta_o, Real phi_o, const std::vector<Real> &rc_list,
+    sweep_rc_d(const ForwardRayTracingParams<Real> &params_, Real theta_o, Real phi_o, const std::vector<Real> &rc_list,
                const std::vector<Real> &lgd_list, size_t cutoff, Real tol)
     {
+        TraceSpan sweep_span("sweep_rc_d", "sweep");
+        sweep_span.set_args([&]
+                            { return fmt::format(R"("rc_size":{},"lgd_size":{},"cutoff":{})", rc_list.size(), lgd_list.size(), cutoff); });
         wrap_phi(phi_o);
+        // build the spin-only constants once, every copy of params below shares them
+        ForwardRayTracingParams<Real> params(params_);
+        params.get_background();
+
         size_t rc_size = rc_list.size();
         size_t lgd_size = lgd_list.size();
 
@@ -300,86 +367,588 @@ struct ForwardRayTracingUtils
         lambda.resize(lgd_size, rc_size);
         eta.resize(lgd_size, rc_size);
 
-        // rc and d
-        oneapi::tbb::parallel_for(oneapi::tbb::blocked_range2d<size_t>(0u, lgd_size, 0u, rc_size),
-                                  [&](const oneapi::tbb::blocked_range2d<size_t, size_t> &r)
+        sweep_result.status.resize(lgd_size, rc_size);
+
+        SweepEvaluator<Real, Complex> evaluator(params, theta_o, phi_o, rc_list, lgd_list);
+        evaluator.evaluate_rows(0u, lgd_size, sweep_result);
+        evaluator.collect(sweep_result.status_count, sweep_result.classified_count);
+
+        find_sweep_roots(sweep_result, params, theta_o, phi_o, rc_list, lgd_list, cutoff, tol);
+        return sweep_result;
+    }
+
+    // sweep_rc_d with the observer-independent maps taken from a SweepCache when the same sweep has been run before,
+    // for any observer. Only the delta maps, the candidates and the roots are computed then, classified_count stays 0.
+    static SweepResult<Real, Complex>
+    sweep_rc_d_cached(const ForwardRayTracingParams<Real> &params_, Real theta_o, Real phi_o,
+                      const std::vector<Real> &rc_list, const std::vector<Real> &lgd_list, size_t cutoff, Real tol,
+                      const SweepCache &cache)
+    {
+        wrap_phi(phi_o);
+        std::optional<SweepFile> sweep_file = cache.template load<Real>(params_, rc_list, lgd_list);
+        if (!sweep_file)
+        {
+            auto sweep_result = sweep_rc_d(params_, theta_o, phi_o, rc_list, lgd_list, cutoff, tol);
+            try
+            {
+                cache.store(params_, theta_o, phi_o, rc_list, lgd_list, sweep_result);
+            }
+            catch (const std::exception &e)
+            {
+                // a full disk or an unwritable directory costs the next caller a sweep, not this one its result
+                Diagnostics::report(RayStatus::INTERNAL_ERROR, "sweep_rc_d_cached", "cache", [&]
+                                    { return fmt::format("cannot store the sweep: {}", e.what()); }, true);
+            }
+            return sweep_result;
+        }
+
+        TraceSpan sweep_span("sweep_rc_d_cached", "sweep");
+        ForwardRayTracingParams<Real> params(params_);
+        params.get_background();
+
+        size_t rc_size = rc_list.size();
+        size_t lgd_size = lgd_list.size();
+        SweepResult<Real, Complex> sweep_result;
+        for (auto *map : {&sweep_result.theta, &sweep_result.phi, &sweep_result.lambda, &sweep_result.eta,
+                          &sweep_result.delta_theta, &sweep_result.delta_phi})
+        {
+            map->resize(lgd_size, rc_size);
+        }
+        sweep_result.status.resize(lgd_size, rc_size);
+        sweep_file->read_rows(sweep_result, 0, lgd_size);
+        observe_sweep(sweep_result, params, theta_o, phi_o, rc_list, lgd_list, cutoff, tol);
+        return sweep_result;
+    }
+
+    // Candidates and roots for an observer, from maps whose theta, phi, lambda, eta and status are filled: the delta
+    // maps and status counts are recomputed and earlier candidates and roots dropped first. phi_o must be wrapped.
+    static void observe_sweep(SweepResult<Real, Complex> &sweep_result, const ForwardRayTracingParams<Real> &params,
+                              const Real &theta_o, const Real &phi_o, const std::vector<Real> &rc_list,
+                              const std::vector<Real> &lgd_list, size_t cutoff, const Real &tol)
+    {
+        size_t rc_size = rc_list.size();
+        size_t lgd_size = lgd_list.size();
+        sweep_result.theta_roots.resize(0, 2);
+        sweep_result.phi_roots.resize(0, 2);
+        sweep_result.theta_roots_closest.resize(0, 2);
+        sweep_result.results.clear();
+        sweep_result.status_count = {};
+        // the same expressions as SweepEvaluator, so the maps match a fresh sweep bit for bit
+        auto &theta = sweep_result.theta;
+        auto &phi = sweep_result.phi;
+        oneapi::tbb::parallel_for(oneapi::tbb::blocked_range<size_t>(0u, lgd_size),
+                                  [&](const oneapi::tbb::blocked_range<size_t> &r)
                                   {
-                                      auto ray_tracing = ForwardRayTracing<Real, Complex>::get_from_cache();
-                                      Real two_pi = boost::math::constants::two_pi<Real>();
-                                      ForwardRayTracingParams<Real> local_params(params);
-                                      for (size_t i = r.rows().begin(); i != r.rows().end(); ++i)
+                                      for (size_t i = r.begin(); i != r.end(); ++i)
                                       {
-                                          for (size_t j = r.cols().begin(); j != r.cols().end(); ++j)
+                                          for (size_t j = 0; j < rc_size; ++j)
                                           {
-                                              local_params.rc = rc_list[j];
-                                              local_params.log_abs_d = lgd_list[i];
-                                              local_params.rc_d_to_lambda_q();
-                                              ray_tracing->calc_ray(local_params);
-                                              if (ray_tracing->ray_status == RayStatus::NORMAL)
-                                              {
-                                                  theta(i, j) = ray_tracing->theta_f;
-                                                  phi(i, j) = ray_tracing->phi_f;
-                                                  delta_theta(i, j) = theta(i, j) - theta_o;
-                                                  delta_phi(i, j) = sin((phi(i, j) - phi_o) * half<Real>());
-                                                  lambda(i, j) = ray_tracing->lambda;
-                                                  eta(i, j) = ray_tracing->eta;
-                                              }
-                                              else
-                                              {
-                                                  theta(i, j) = std::numeric_limits<Real>::quiet_NaN();
-                                                  phi(i, j) = std::numeric_limits<Real>::quiet_NaN();
-                                                  delta_theta(i, j) = std::numeric_limits<Real>::quiet_NaN();
-                                                  delta_phi(i, j) = std::numeric_limits<Real>::quiet_NaN();
-                                                  lambda(i, j) = std::numeric_limits<Real>::quiet_NaN();
-                                                  eta(i, j) = std::numeric_limits<Real>::quiet_NaN();
-                                              }
+                                              sweep_result.delta_theta(i, j) = theta(i, j) - theta_o;
+                                              sweep_result.delta_phi(i, j) = sin((phi(i, j) - phi_o) * half<Real>());
                                           }
                                       }
                                   });
+        for (size_t i = 0; i < lgd_size; ++i)
+        {
+            for (size_t j = 0; j < rc_size; ++j)
+            {
+                sweep_result.status_count[sweep_result.status(i, j)]++;
+            }
+        }
 
-        namespace bg = boost::geometry;
-        namespace bgi = boost::geometry::index;
-        using Point = bg::model::point<int, 2, bg::cs::cartesian>;
-        tbb::concurrent_vector<Point> theta_roots_index;
-        tbb::concurrent_vector<Point> phi_roots_index;
-        oneapi::tbb::parallel_for(oneapi::tbb::blocked_range2d<size_t>(1u, lgd_size, 1u, rc_size),
-                                  [&](const oneapi::tbb::blocked_range2d<size_t, size_t> &r)
+        find_sweep_roots(sweep_result, params, theta_o, phi_o, rc_list, lgd_list, cutoff, tol);
+    }
+
+    // For every value of to, the index of the same value in from, -1 if from does not have it
+    static std::vector<int> match_axis(const std::vector<Real> &from, const std::vector<Real> &to)
+    {
+        std::vector<size_t> order(from.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(), [&](size_t k1, size_t k2)
+                  { return from[k1] < from[k2]; });
+        std::vector<int> source(to.size(), -1);
+        for (size_t k = 0; k < to.size(); k++)
+        {
+            auto it = std::lower_bound(order.begin(), order.end(), to[k], [&](size_t index, const Real &value)
+                                       { return from[index] < value; });
+            if (it != order.end() && from[*it] == to[k])
+            {
+                source[k] = static_cast<int>(*it);
+            }
+        }
+        return source;
+    }
+
+    // call f(run_begin, run_end) for every maximal run of [begin, end) where pred holds
+    template <typename Pred, typename F>
+    static void for_each_run(size_t begin, size_t end, Pred &&pred, F &&f)
+    {
+        size_t k = begin;
+        while (k < end)
+        {
+            if (!pred(k))
+            {
+                k++;
+                continue;
+            }
+            size_t run_begin = k;
+            while (k < end && pred(k))
+            {
+                k++;
+            }
+            f(run_begin, k);
+        }
+    }
+
+    // sweep_rc_d over new axes, reusing a sweep over previous_rc_list and previous_lgd_list made with the same params,
+    // theta_o and phi_o. Nodes whose rc and log_abs_d are both in the previous axes are copied and only the others, new
+    // rows and columns or refinement nodes in between, are traced. Candidates are only detected in cells next to a
+    // new node or a new neighbour, the others are carried over, and only the pairs with a changed cell are solved,
+    // their roots are added to the previous ones. classified_count counts the cells traced by this call.
+    // The maps, candidates and status counts match sweep_rc_d over the new axes, the results need not: previous roots
+    // are kept even if the cutoff no longer reaches their pair on the new grid, so an extended sweep holds every root
+    // of a fresh one, up to tol, and can hold more, e.g. after appending rows.
+    static SweepResult<Real, Complex>
+    sweep_rc_d_extend(const ForwardRayTracingParams<Real> &params_, Real theta_o, Real phi_o,
+                      const std::vector<Real> &rc_list, const std::vector<Real> &lgd_list, size_t cutoff, Real tol,
+                      const SweepResult<Real, Complex> &previous, const std::vector<Real> &previous_rc_list,
+                      const std::vector<Real> &previous_lgd_list)
+    {
+        return extend_sweep(params_, theta_o, phi_o, rc_list, lgd_list, cutoff, tol, previous, previous_rc_list,
+                            previous_lgd_list, true);
+    }
+
+    // sweep_rc_d_extend from the maps of a sweep file, with its params and observer. The file holds no candidates or
+    // roots, so candidates are detected and solved on the whole new grid, only the tracing of reused nodes is saved.
+    static SweepResult<Real, Complex>
+    sweep_rc_d_extend(const SweepFile &previous, const std::vector<Real> &rc_list, const std::vector<Real> &lgd_list,
+                      size_t cutoff, Real tol)
+    {
+        if (previous.precision() != TypeName<Real>::Get())
+        {
+            throw std::invalid_argument(fmt::format("{} holds a {} sweep, not {}", previous.file_path(),
+                                                    previous.precision(), TypeName<Real>::Get()));
+        }
+        if (!previous.rows_written(0, previous.rows()))
+        {
+            throw std::invalid_argument(fmt::format("{} holds an unfinished sweep", previous.file_path()));
+        }
+        SweepResult<Real, Complex> previous_result;
+        for (auto *map : {&previous_result.theta, &previous_result.phi, &previous_result.lambda, &previous_result.eta,
+                          &previous_result.delta_theta, &previous_result.delta_phi})
+        {
+            map->resize(previous.rows(), previous.cols());
+        }
+        previous_result.status.resize(previous.rows(), previous.cols());
+        previous.read_rows(previous_result, 0, previous.rows());
+        return extend_sweep(previous.params<Real>(), previous.theta_o<Real>(), previous.phi_o<Real>(), rc_list,
+                            lgd_list, cutoff, tol, previous_result, previous.rc_list<Real>(),
+                            previous.lgd_list<Real>(), false);
+    }
+
+    static SweepResult<Real, Complex>
+    extend_sweep(const ForwardRayTracingParams<Real> &params_, Real theta_o, Real phi_o,
+                 const std::vector<Real> &rc_list, const std::vector<Real> &lgd_list, size_t cutoff, const Real &tol,
+                 const SweepResult<Real, Complex> &previous, const std::vector<Real> &previous_rc_list,
+                 const std::vector<Real> &previous_lgd_list, bool carry_candidates)
+    {
+        if (static_cast<size_t>(previous.theta.rows()) != previous_lgd_list.size() ||
+            static_cast<size_t>(previous.theta.cols()) != previous_rc_list.size())
+        {
+            throw std::invalid_argument(fmt::format("previous sweep is {}x{}, its axes are {}x{}",
+                                                    previous.theta.rows(), previous.theta.cols(),
+                                                    previous_lgd_list.size(), previous_rc_list.size()));
+        }
+
+        TraceSpan sweep_span("sweep_rc_d_extend", "sweep");
+        wrap_phi(phi_o);
+        ForwardRayTracingParams<Real> params(params_);
+        params.get_background();
+
+        size_t rc_size = rc_list.size();
+        size_t lgd_size = lgd_list.size();
+        std::vector<int> row_source = match_axis(previous_lgd_list, lgd_list);
+        std::vector<int> col_source = match_axis(previous_rc_list, rc_list);
+        auto reused_row = [&](size_t i)
+        { return row_source[i] >= 0; };
+        auto reused_col = [&](size_t j)
+        { return col_source[j] >= 0; };
+
+        SweepResult<Real, Complex> sweep_result;
+        for (auto *map : {&sweep_result.theta, &sweep_result.phi, &sweep_result.lambda, &sweep_result.eta,
+                          &sweep_result.delta_theta, &sweep_result.delta_phi})
+        {
+            map->resize(lgd_size, rc_size);
+        }
+        sweep_result.status.resize(lgd_size, rc_size);
+
+        oneapi::tbb::parallel_for(oneapi::tbb::blocked_range<size_t>(0u, lgd_size),
+                                  [&](const oneapi::tbb::blocked_range<size_t> &r)
                                   {
-                                      int d_row, d_col, d_row_lambda, d_col_lambda;
-                                      for (size_t i = r.rows().begin(); i != r.rows().end(); ++i)
+                                      for (size_t i = r.begin(); i != r.end(); ++i)
                                       {
-                                          for (size_t j = r.cols().begin(); j != r.cols().end(); ++j)
+                                          if (!reused_row(i))
                                           {
-                                              d_row = sgn(delta_theta(i, j)) * sgn(delta_theta(i, j - 1));
-                                              d_col = sgn(delta_theta(i, j)) * sgn(delta_theta(i - 1, j));
-                                              if (!isnan(delta_theta(i, j)) && !isnan(delta_theta(i, j - 1)) &&
-                                                  !isnan(delta_theta(i - 1, j)) &&
-                                                  (d_row <= 0 || d_col <= 0))
-                                              {
-                                                  theta_roots_index.emplace_back(i, j);
-                                              }
-                                              d_row = sgn(delta_phi(i, j)) * sgn(delta_phi(i, j - 1));
-                                              d_col = sgn(delta_phi(i, j)) * sgn(delta_phi(i - 1, j));
-                                              d_row_lambda = sgn(lambda(i, j)) * sgn(lambda(i, j - 1));
-                                              d_col_lambda = sgn(lambda(i, j)) * sgn(lambda(i - 1, j));
-                                              if (!isnan(delta_phi(i, j)) && !isnan(delta_phi(i, j - 1)) &&
-                                                  !isnan(delta_phi(i - 1, j)) &&
-                                                  !isnan(lambda(i, j)) && !isnan(lambda(i, j - 1)) &&
-                                                  !isnan(lambda(i - 1, j)) && d_row_lambda > 0 &&
-                                                  d_col_lambda > 0 &&
-                                                  (d_row <= 0 || d_col <= 0))
+                                              continue;
+                                          }
+                                          for (size_t j = 0; j < rc_size; ++j)
+                                          {
+                                              if (!reused_col(j))
                                               {
-                                                  phi_roots_index.emplace_back(i, j);
+                                                  continue;
                                               }
+                                              size_t si = row_source[i];
+                                              size_t sj = col_source[j];
+                                              sweep_result.theta(i, j) = previous.theta(si, sj);
+                                              sweep_result.phi(i, j) = previous.phi(si, sj);
+                                              sweep_result.lambda(i, j) = previous.lambda(si, sj);
+                                              sweep_result.eta(i, j) = previous.eta(si, sj);
+                                              sweep_result.delta_theta(i, j) = previous.delta_theta(si, sj);
+                                              sweep_result.delta_phi(i, j) = previous.delta_phi(si, sj);
+                                              sweep_result.status(i, j) = previous.status(si, sj);
                                           }
                                       }
                                   });
 
+        // new rows in full, then the new columns of the reused rows
+        {
+            SweepEvaluator<Real, Complex> evaluator(params, theta_o, phi_o, rc_list, lgd_list);
+            for_each_run(0u, lgd_size, [&](size_t i)
+                         { return !reused_row(i); },
+                         [&](size_t row_begin, size_t row_end)
+                         { evaluator.evaluate_rows(row_begin, row_end, sweep_result); });
+            for_each_run(0u, lgd_size, reused_row, [&](size_t row_begin, size_t row_end)
+                         { for_each_run(0u, rc_size, [&](size_t j)
+                                        { return !reused_col(j); },
+                                        [&](size_t col_begin, size_t col_end)
+                                        { evaluator.evaluate_block(row_begin, row_end, col_begin, col_end,
+                                                                   sweep_result); }); });
+            std::array<size_t, RAY_STATUS_COUNT> traced_count = {};
+            evaluator.collect(traced_count, sweep_result.classified_count);
+        }
+        for (size_t i = 0; i < lgd_size; ++i)
+        {
+            for (size_t j = 0; j < rc_size; ++j)
+            {
+                sweep_result.status_count[sweep_result.status(i, j)]++;
+            }
+        }
+
+        // a cell keeps its candidate flags if it and its upper and left neighbours are reused and were neighbours
+        auto kept_row = [&](size_t i)
+        { return carry_candidates && reused_row(i) && row_source[i - 1] == row_source[i] - 1; };
+        auto kept_col = [&](size_t j)
+        { return carry_candidates && reused_col(j) && col_source[j - 1] == col_source[j] - 1; };
+        auto changed = [&](const SweepPoint &p)
+        { return !kept_row(p.template get<0>()) || !kept_col(p.template get<1>()); };
+
+        tbb::concurrent_vector<SweepPoint> theta_roots_index;
+        tbb::concurrent_vector<SweepPoint> phi_roots_index;
+        INSTRUMENT_STAGE_START(candidates_timer, Stage::CANDIDATES);
+        for_each_run(1u, lgd_size, [&](size_t i)
+                     { return !kept_row(i); },
+                     [&](size_t row_begin, size_t row_end)
+                     { detect_sweep_candidates(sweep_result, row_begin, row_end, 0u, theta_roots_index,
+                                               phi_roots_index); });
+        for_each_run(1u, lgd_size, kept_row, [&](size_t row_begin, size_t row_end)
+                     { for_each_run(1u, rc_size, [&](size_t j)
+                                    { return !kept_col(j); },
+                                    [&](size_t col_begin, size_t col_end)
+                                    { detect_sweep_candidates(sweep_result, row_begin, row_end, 0u,
+                                                              theta_roots_index, phi_roots_index, col_begin,
+                                                              col_end); }); });
+        INSTRUMENT_STAGE_STOP(candidates_timer);
+
+        if (carry_candidates)
+        {
+            auto carry = [&](const typename SweepResult<Real, Complex>::PointVector &roots,
+                             tbb::concurrent_vector<SweepPoint> &roots_index)
+            {
+                std::vector<Real> roots_rc(roots.rows()), roots_lgd(roots.rows());
+                for (Eigen::Index k = 0; k < roots.rows(); k++)
+                {
+                    roots_rc[k] = roots(k, 0);
+                    roots_lgd[k] = roots(k, 1);
+                }
+                std::vector<int> rows = match_axis(lgd_list, roots_lgd);
+                std::vector<int> cols = match_axis(rc_list, roots_rc);
+                for (size_t k = 0; k < rows.size(); k++)
+                {
+                    if (rows[k] >= 1 && cols[k] >= 1 && !changed(SweepPoint(rows[k], cols[k])))
+                    {
+                        roots_index.emplace_back(rows[k], cols[k]);
+                    }
+                }
+            };
+            carry(previous.theta_roots, theta_roots_index);
+            carry(previous.phi_roots, phi_roots_index);
+            sweep_result.results = previous.results;
+        }
+
+        solve_candidates(sweep_result, params, theta_o, phi_o, rc_list, lgd_list, cutoff, tol, theta_roots_index,
+                         phi_roots_index, [&](size_t row, size_t col) -> const Real &
+                         { return sweep_result.phi(row, col); },
+                         nullptr, [&](const SweepPoint &theta_point, const SweepPoint &phi_point)
+                         { return changed(theta_point) || changed(phi_point); });
+        return sweep_result;
+    }
+
+    // candidates and roots of a sweep with all its maps in memory
+    static void find_sweep_roots(SweepResult<Real, Complex> &sweep_result, const ForwardRayTracingParams<Real> &params,
+                                 const Real &theta_o, const Real &phi_o, const std::vector<Real> &rc_list,
+                                 const std::vector<Real> &lgd_list, size_t cutoff, const Real &tol)
+    {
+        tbb::concurrent_vector<SweepPoint> theta_roots_index;
+        tbb::concurrent_vector<SweepPoint> phi_roots_index;
+        INSTRUMENT_STAGE_START(candidates_timer, Stage::CANDIDATES);
+        detect_sweep_candidates(sweep_result, 1u, lgd_list.size(), 0u, theta_roots_index, phi_roots_index);
+        INSTRUMENT_STAGE_STOP(candidates_timer);
+
+        solve_candidates(sweep_result, params, theta_o, phi_o, rc_list, lgd_list, cutoff, tol, theta_roots_index,
+                         phi_roots_index, [&](size_t row, size_t col) -> const Real &
+                         { return sweep_result.phi(row, col); });
+    }
+
+    // sweep_rc_d in row bands of settings.band_rows rows. Only the maps of one band are in memory at a time, the
+    // returned SweepResult has empty maps and the same candidates and results as sweep_rc_d. Bands are passed to
+    // settings.on_band as soon as they are done and written to the sweep file settings.spill_path if it is set.
+    // With settings.resume an interrupted run continues from its spill files, classified_count then only counts the
+    // bands traced by this run.
+    static SweepResult<Real, Complex>
+    sweep_rc_d_streaming(const ForwardRayTracingParams<Real> &params_, Real theta_o, Real phi_o,
+                         const std::vector<Real> &rc_list, const std::vector<Real> &lgd_list, size_t cutoff, Real tol,
+                         const SweepStreamSettings<Real> &settings = {})
+    {
+        TraceSpan sweep_span("sweep_rc_d_streaming", "sweep");
+        sweep_span.set_args([&]
+                            { return fmt::format(R"("rc_size":{},"lgd_size":{},"cutoff":{},"band_rows":{})", rc_list.size(), lgd_list.size(), cutoff, settings.band_rows); });
+        wrap_phi(phi_o);
+        ForwardRayTracingParams<Real> params(params_);
+        params.get_background();
+
+        size_t rc_size = rc_list.size();
+        size_t lgd_size = lgd_list.size();
+        size_t band_rows = std::max<size_t>(settings.band_rows, 1);
+
+        SweepResult<Real, Complex> sweep_result;
+        SweepEvaluator<Real, Complex> evaluator(params, theta_o, phi_o, rc_list, lgd_list);
+        std::optional<SweepFile> spill;
+        std::optional<SweepRootLog<Real>> root_log;
+        bool resume = false;
+        if (!settings.spill_path.empty())
+        {
+            boost::system::error_code ec;
+            if (settings.resume && boost::filesystem::exists(settings.spill_path, ec))
+            {
+                // a spill that cannot be mapped, e.g. one cut short by a full disk, is started over like one of
+                // another sweep
+                try
+                {
+                    SweepFile sweep_file(settings.spill_path, true);
+                    if (sweep_file.matches(params, rc_list, lgd_list) && sweep_file.theta_o<Real>() == theta_o &&
+                        sweep_file.phi_o<Real>() == phi_o)
+                    {
+                        spill = std::move(sweep_file);
+                        resume = true;
+                    }
+                }
+                catch (const std::exception &e)
+                {
+                    Diagnostics::report(RayStatus::INTERNAL_ERROR, "sweep_rc_d_streaming", "spill_path", [&]
+                                        { return fmt::format("cannot resume from {}: {}", settings.spill_path,
+                                                             e.what()); }, true);
+                }
+            }
+            if (!spill)
+            {
+                spill = SweepFile::create(settings.spill_path, params, theta_o, phi_o, rc_list, lgd_list, band_rows);
+            }
+            root_log.emplace(settings.spill_path + ".roots", cutoff, tol, resume);
+        }
+
+        SweepBand<Real> band;
+        band.resize(std::min(band_rows, lgd_size) + 1, rc_size);
+
+        tbb::concurrent_vector<SweepPoint> theta_roots_index;
+        tbb::concurrent_vector<SweepPoint> phi_roots_index;
+        // the root stage needs phi only at the phi candidates
+        std::unordered_map<size_t, Real> candidate_phi;
+
+        for (size_t row_begin = 0; row_begin < lgd_size; row_begin += band_rows)
+        {
+            if (row_begin > 0)
+            {
+                band.shift_halo();
+            }
+            band.row_begin = row_begin;
+            band.row_end = std::min(row_begin + band_rows, lgd_size);
+            bool resumed = resume && spill->rows_written(band.row_begin, band.row_end);
+            if (resumed)
+            {
+                spill->read_rows(band, band.row_begin, band.row_end, band.row_offset());
+                for (size_t i = band.row_begin; i < band.row_end; i++)
+                {
+                    for (size_t j = 0; j < rc_size; j++)
+                    {
+                        sweep_result.status_count[band.status(i - band.row_offset(), j)]++;
+                    }
+                }
+            }
+            else
+            {
+                evaluator.evaluate_rows(band.row_begin, band.row_end, band, band.row_offset());
+            }
+
+            INSTRUMENT_STAGE_START(candidates_timer, Stage::CANDIDATES);
+            tbb::concurrent_vector<SweepPoint> band_theta_roots;
+            tbb::concurrent_vector<SweepPoint> band_phi_roots;
+            detect_sweep_candidates(band, std::max<size_t>(band.row_begin, 1), band.row_end, band.row_offset(),
+                                    band_theta_roots, band_phi_roots);
+            INSTRUMENT_STAGE_STOP(candidates_timer);
+
+            band.theta_candidates.assign(band_theta_roots.begin(), band_theta_roots.end());
+            band.phi_candidates.assign(band_phi_roots.begin(), band_phi_roots.end());
+            theta_roots_index.grow_by(band_theta_roots.begin(), band_theta_roots.end());
+            phi_roots_index.grow_by(band_phi_roots.begin(), band_phi_roots.end());
+            for (const SweepPoint &point : band.phi_candidates)
+            {
+                size_t row = point.template get<0>();
+                size_t col = point.template get<1>();
+                candidate_phi.emplace(row * rc_size + col, band.phi(row - band.row_offset(), col));
+            }
+
+            if (spill && !resumed)
+            {
+                spill->write_rows(band, band.row_begin, band.row_end, band.row_offset());
+                spill->flush();
+            }
+            if (settings.on_band)
+            {
+                settings.on_band(band);
+            }
+        }
+        evaluator.collect(sweep_result.status_count, sweep_result.classified_count);
+
+        solve_candidates(sweep_result, params, theta_o, phi_o, rc_list, lgd_list, cutoff, tol, theta_roots_index,
+                         phi_roots_index, [&](size_t row, size_t col) -> const Real &
+                         { return candidate_phi.at(row * rc_size + col); },
+                         root_log ? &*root_log : nullptr);
+        return sweep_result;
+    }
+
+    // sweep_rc_d for callers that only need the candidates and roots. Column strips of strip_cols columns are traced
+    // in parallel, each row by row in a window of two rows, and candidates are detected as soon as a row is traced.
+    // The cells of a row are traced in parallel too, so a grid of few strips still uses every thread.
+    // Only the candidates and phi at the phi candidates are kept, the returned SweepResult has empty maps and the same
+    // candidates, results and counts as sweep_rc_d. The column left of a strip is traced again for its window.
+    static SweepResult<Real, Complex>
+    sweep_rc_d_sparse(const ForwardRayTracingParams<Real> &params_, Real theta_o, Real phi_o,
+                      const std::vector<Real> &rc_list, const std::vector<Real> &lgd_list, size_t cutoff, Real tol,
+                      size_t strip_cols = 64)
+    {
+        TraceSpan sweep_span("sweep_rc_d_sparse", "sweep");
+        sweep_span.set_args([&]
+                            { return fmt::format(R"("rc_size":{},"lgd_size":{},"cutoff":{},"strip_cols":{})", rc_list.size(), lgd_list.size(), cutoff, strip_cols); });
+        wrap_phi(phi_o);
+        ForwardRayTracingParams<Real> params(params_);
+        params.get_background();
+
+        size_t rc_size = rc_list.size();
+        size_t lgd_size = lgd_list.size();
+        strip_cols = std::max<size_t>(strip_cols, 1);
+        size_t strip_count = (rc_size + strip_cols - 1) / strip_cols;
+
+        SweepResult<Real, Complex> sweep_result;
+        SweepEvaluator<Real, Complex> evaluator(params, theta_o, phi_o, rc_list, lgd_list);
+        // the columns left of the strips, traced twice and not counted
+        SweepEvaluator<Real, Complex> halo_evaluator(params, theta_o, phi_o, rc_list, lgd_list);
+
+        tbb::concurrent_vector<SweepPoint> theta_roots_index;
+        tbb::concurrent_vector<SweepPoint> phi_roots_index;
+        tbb::concurrent_vector<std::pair<size_t, Real>> phi_values;
+        tbb::parallel_for(tbb::blocked_range<size_t>(0u, strip_count, 1u),
+                          [&](const tbb::blocked_range<size_t> &r)
+                          {
+                              for (size_t strip = r.begin(); strip != r.end(); ++strip)
+                              {
+                                  size_t col_begin = strip * strip_cols;
+                                  size_t col_end = std::min(col_begin + strip_cols, rc_size);
+                                  size_t halo_begin = col_begin > 0 ? col_begin - 1 : col_begin;
+                                  SweepWindow<Real> window(halo_begin, col_end);
+                                  tbb::concurrent_vector<SweepPoint> row_theta_roots;
+                                  tbb::concurrent_vector<SweepPoint> row_phi_roots;
+                                  for (size_t i = 0; i < lgd_size; ++i)
+                                  {
+                                      // row 0 of the grid goes to row 0 of the window, the others to row 1
+                                      size_t row_offset = i > 0 ? i - 1 : 0;
+                                      evaluator.evaluate_block(i, i + 1, col_begin, col_end, window, row_offset);
+                                      if (halo_begin < col_begin)
+                                      {
+                                          halo_evaluator.evaluate_block(i, i + 1, halo_begin, col_begin, window,
+                                                                        row_offset);
+                                      }
+                                      if (i == 0)
+                                      {
+                                          continue;
+                                      }
+
+                                      row_theta_roots.clear();
+                                      row_phi_roots.clear();
+                                      detect_sweep_candidates(window, i, i + 1, row_offset, row_theta_roots,
+                                                              row_phi_roots, std::max<size_t>(col_begin, 1),
+                                                              col_end);
+                                      theta_roots_index.grow_by(row_theta_roots.begin(), row_theta_roots.end());
+                                      phi_roots_index.grow_by(row_phi_roots.begin(), row_phi_roots.end());
+                                      for (const SweepPoint &point : row_phi_roots)
+                                      {
+                                          size_t col = point.template get<1>();
+                                          phi_values.emplace_back(i * rc_size + col, window.phi(1, col));
+                                      }
+                                      window.shift_row();
+                                  }
+                              }
+                          });
+        evaluator.collect(sweep_result.status_count, sweep_result.classified_count);
+
+        std::unordered_map<size_t, Real> candidate_phi(phi_values.begin(), phi_values.end());
+        solve_candidates(sweep_result, params, theta_o, phi_o, rc_list, lgd_list, cutoff, tol, theta_roots_index,
+                         phi_roots_index, [&](size_t row, size_t col) -> const Real &
+                         { return candidate_phi.at(row * rc_size + col); });
+        return sweep_result;
+    }
+
+    // Pair every theta candidate with the closest phi candidate, solve the cutoff closest pairs and drop duplicated
+    // roots. phi_at(row, col) is the phi of a phi candidate cell. The candidates are sorted first, so the pairs do not
+    // depend on the order in which the threads found them, and results are kept in the order of the pairs. Solves
+    // already in root_log are replayed instead of solved, new ones are appended to it. If solve_pair is set, only the
+    // pairs (theta candidate, phi candidate) it accepts are solved. The new results are appended to the results
+    // already in sweep_result before duplicates are dropped.
+    template <typename PhiAt>
+    static void solve_candidates(SweepResult<Real, Complex> &sweep_result, const ForwardRayTracingParams<Real> &params,
+                                 const Real &theta_o, const Real &phi_o, const std::vector<Real> &rc_list,
+                                 const std::vector<Real> &lgd_list, size_t cutoff, const Real &tol,
+                                 tbb::concurrent_vector<SweepPoint> &theta_roots_index,
+                                 tbb::concurrent_vector<SweepPoint> &phi_roots_index, PhiAt &&phi_at,
+                                 SweepRootLog<Real> *root_log = nullptr,
+                                 const std::function<bool(const SweepPoint &, const SweepPoint &)> &solve_pair = {})
+    {
+        namespace bg = boost::geometry;
+        namespace bgi = boost::geometry::index;
+        using Point = SweepPoint;
+
         if (theta_roots_index.empty() && phi_roots_index.empty())
         {
-            return sweep_result;
+            return;
         }
 
+        auto point_less = [](const Point &p1, const Point &p2)
+        {
+            return std::make_pair(p1.template get<0>(), p1.template get<1>()) <
+                   std::make_pair(p2.template get<0>(), p2.template get<1>());
+        };
+        std::sort(theta_roots_index.begin(), theta_roots_index.end(), point_less);
+        std::sort(phi_roots_index.begin(), phi_roots_index.end(), point_less);
+
         auto &theta_roots = sweep_result.theta_roots;
         theta_roots.resize(theta_roots_index.size(), 2);
         for (size_t i = 0; i < theta_roots_index.size(); i++)
@@ -390,7 +959,7 @@ struct ForwardRayTracingUtils
 
         if (phi_roots_index.empty())
         {
-            return sweep_result;
+            return;
         }
 
         auto &phi_roots = sweep_result.phi_roots;
@@ -401,6 +970,7 @@ struct ForwardRayTracingUtils
             phi_roots(i, 1) = lgd_list[phi_roots_index[i].template get<0>()];
         }
 
+        INSTRUMENT_STAGE_START(pairing_timer, Stage::PAIRING);
         std::vector<Point> theta_roots_closest_index;
         theta_roots_closest_index.reserve(theta_roots_index.size());
         std::vector<double> distances(theta_roots_index.size());
@@ -415,9 +985,10 @@ struct ForwardRayTracingUtils
         // sort rows of theta_roots_closest_index by distances
         std::vector<size_t> indices(theta_roots_index.size());
         std::iota(indices.begin(), indices.end(), 0);
-        std::sort(indices.begin(), indices.end(),
-                  [&distances](size_t i1, size_t i2)
-                  { return distances[i1] < distances[i2]; });
+        std::stable_sort(indices.begin(), indices.end(),
+                     [&distances](size_t i1, size_t i2)
+                     { return distances[i1] < distances[i2]; });
+        INSTRUMENT_STAGE_STOP(pairing_timer);
 
         auto &theta_roots_closest = sweep_result.theta_roots_closest;
         theta_roots_closest.resize(theta_roots_index.size(), 2);
@@ -427,38 +998,88 @@ struct ForwardRayTracingUtils
             theta_roots_closest(i, 1) = lgd_list[theta_roots_closest_index[indices[i]].template get<0>()];
         }
 
+        // the cutoff closest pairs, only those passing solve_pair if it is set
+        std::vector<size_t> solve_order;
+        solve_order.reserve(std::min(cutoff, indices.size()));
+        for (size_t index : indices)
+        {
+            if (solve_order.size() == cutoff)
+            {
+                break;
+            }
+            if (!solve_pair || solve_pair(theta_roots_index[index], theta_roots_closest_index[index]))
+            {
+                solve_order.push_back(index);
+            }
+        }
+
         // find results
         auto &results = sweep_result.results;
-        cutoff = std::min(cutoff, indices.size());
-        results.reserve(cutoff);
-        std::mutex results_mutex;
-        tbb::parallel_for(tbb::blocked_range<size_t>(0u, cutoff),
+        std::vector<std::optional<ForwardRayTracingResult<Real, Complex>>> roots(solve_order.size());
+        tbb::parallel_for(tbb::blocked_range<size_t>(0u, solve_order.size()),
                           [&](const tbb::blocked_range<size_t> &r)
                           {
                               ForwardRayTracingParams<Real> local_params(params);
                               Real two_pi = boost::math::constants::two_pi<Real>();
                               for (size_t i = r.begin(); i != r.end(); ++i)
                               {
-                                  size_t row = theta_roots_closest_index[indices[i]].template get<0>();
-                                  size_t col = theta_roots_closest_index[indices[i]].template get<1>();
+                                  size_t row = theta_roots_closest_index[solve_order[i]].template get<0>();
+                                  size_t col = theta_roots_closest_index[solve_order[i]].template get<1>();
                                   local_params.rc = rc_list[col];
                                   local_params.log_abs_d = lgd_list[row];
                                   local_params.rc_d_to_lambda_q();
-                                  int period = MY_FLOOR<Real>::convert(phi(row, col) / two_pi);
+                                  TraceSpan span("find_root", "root");
+                                  int period;
+                                  if (!floor_to_int(Real(phi_at(row, col) / two_pi), period))
+                                  {
+                                      Diagnostics::report(RayStatus::INTERNAL_ERROR, "sweep_rc_d", "period");
+                                      continue;
+                                  }
+                                  if (const auto *entry = root_log ? root_log->find(i, row, col) : nullptr)
+                                  {
+                                      if (entry->success)
+                                      {
+                                          roots[i] = replay_root(local_params, period, theta_o, phi_o, entry->rc,
+                                                                 entry->log_abs_d);
+                                      }
+                                      continue;
+                                  }
                                   auto root_res = find_root_period(local_params, period, theta_o, phi_o, tol);
+                                  span.set_args([&]
+                                                { return fmt::format(R"("row":{},"col":{},"rc":{},"log_abs_d":{},"period":{},"iterations":{},"success":{},"outcome":"{}")",
+                                                                     row, col, rc_list[col], lgd_list[row], period,
+                                                                     root_res.iterations, root_res.success,
+                                                                     Tracing::escape(root_res.success ? "converged" : root_res.fail_reason)); });
                                   if (root_res.success)
                                   {
-                                      auto root = *std::move(root_res.root);
-                                      std::lock_guard<std::mutex> lock(results_mutex);
-                                      results.push_back(std::move(root));
+                                      if (root_log)
+                                      {
+                                          root_log->record(i, row, col, true, root_res.root->rc,
+                                                           root_res.root->log_abs_d);
+                                      }
+                                      roots[i] = std::move(root_res.root);
                                   }
                                   else
                                   {
-                                      fmt::println("find root failed, rc = {}, log_abs_d = {}, reason: {}\n", rc_list[col], lgd_list[row], root_res.fail_reason);
+                                      if (root_log)
+                                      {
+                                          root_log->record(i, row, col, false, local_params.rc,
+                                                           local_params.log_abs_d);
+                                      }
+                                      Diagnostics::report(root_res.ray_status, "sweep_rc_d", "find_root", [&]
+                                                          { return fmt::format("find root failed, rc = {}, log_abs_d = {}, reason: {}", rc_list[col], lgd_list[row], root_res.fail_reason); });
                                   }
                               }
                           });
+        for (auto &root : roots)
+        {
+            if (root)
+            {
+                results.push_back(*std::move(root));
+            }
+        }
 
+        INSTRUMENT_STAGE(Stage::DEDUPE);
         std::vector<size_t> duplicated_index;
         for (size_t i = 0; i < results.size(); i++)
         {
@@ -472,13 +1093,13 @@ struct ForwardRayTracingUtils
                 }
             }
         }
-        // remove duplicated results
+        // remove duplicated results, a result close to two earlier ones is listed twice
         std::sort(duplicated_index.begin(), duplicated_index.end());
+        duplicated_index.erase(std::unique(duplicated_index.begin(), duplicated_index.end()), duplicated_index.end());
         for (size_t i = duplicated_index.size(); i > 0; i--)
         {
             results.erase(results.begin() + duplicated_index[i - 1]);
         }
 
-        return sweep_result;
     }
 };
\ No newline at end of file
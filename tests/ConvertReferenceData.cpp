@@ -0,0 +1,28 @@
+#include <iostream>
+
+#include "ReferenceData.h"
+
+// Converts the pp/pm/mp/mm.csv reference files of a directory into one binary file the tests can map.
+// usage: convert_reference_data <csv directory> <output file>
+int main(int argc, char *argv[]) {
+    if (argc != 3) {
+        std::cerr << "usage: " << argv[0] << " <csv directory> <output file>" << std::endl;
+        return 1;
+    }
+
+    ReferenceData data;
+    data.load_csv_directory(argv[1]);
+    if (data.empty()) {
+        std::cerr << "no csv files found in " << argv[1] << std::endl;
+        return 1;
+    }
+    data.write(argv[2]);
+
+    for (Sign nu_r: {Sign::POSITIVE, Sign::NEGATIVE}) {
+        for (Sign nu_theta: {Sign::POSITIVE, Sign::NEGATIVE}) {
+            fmt::println("nu_r: {}, nu_theta: {}, rows: {}", GET_SIGN(nu_r), GET_SIGN(nu_theta),
+                         data.rows(nu_r, nu_theta).size());
+        }
+    }
+    return 0;
+}
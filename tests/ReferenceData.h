@@ -0,0 +1,205 @@
+#pragma once
+
+#include "Common.h"
+#include "FloatExpansion.h"
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/lexical_cast.hpp>
+#include <oneapi/tbb/parallel_for.h>
+
+// Reference data of the forward tests in a binary file that is mapped instead of parsed.
+//
+// Every value is stored as a double expansion of REFERENCE_LIMBS parts (see FloatExpansion.h), about 265 bits, which
+// covers Float256. Each precision rebuilds its values with a few additions, so the tests do no string parsing at all.
+// The file is native little-endian:
+//   ReferenceFileHeader
+//   the rows of pp, pm, mp and mm (nu_r, nu_theta) one after another, REFERENCE_FIELD_COUNT values per row
+
+enum class ReferenceField : size_t {
+    A, R_S, THETA_S, R_O, LAMBDA, ETA, T_F, THETA_F, PHI_F
+};
+
+constexpr size_t REFERENCE_FIELD_COUNT = 9;
+constexpr size_t REFERENCE_LIMBS = 5;
+constexpr size_t REFERENCE_ROW_DOUBLES = REFERENCE_FIELD_COUNT * REFERENCE_LIMBS;
+
+constexpr char REFERENCE_MAGIC[8] = {'K', 'E', 'R', 'R', 'R', 'E', 'F', '\0'};
+constexpr uint32_t REFERENCE_VERSION = 1;
+
+struct ReferenceFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t field_count;
+    uint32_t limbs;
+    uint32_t reserved;
+    // rows of pp, pm, mp, mm
+    uint64_t row_count[4];
+};
+
+// pp, pm, mp, mm
+inline size_t reference_sign_index(Sign nu_r, Sign nu_theta) {
+    return (nu_r == Sign::NEGATIVE ? 2 : 0) + (nu_theta == Sign::NEGATIVE ? 1 : 0);
+}
+
+class ReferenceRows {
+private:
+    const double *data = nullptr;
+    size_t count = 0;
+
+public:
+    ReferenceRows() = default;
+
+    ReferenceRows(const double *data_, size_t count_) : data(data_), count(count_) {}
+
+    size_t size() const {
+        return count;
+    }
+
+    bool empty() const {
+        return count == 0;
+    }
+
+    const double *raw() const {
+        return data;
+    }
+
+    template<typename Real>
+    Real get(size_t row, ReferenceField field) const {
+        return from_double_expansion<Real, REFERENCE_LIMBS>(
+                data + row * REFERENCE_ROW_DOUBLES + static_cast<size_t>(field) * REFERENCE_LIMBS);
+    }
+};
+
+class ReferenceData {
+private:
+    // rows converted from csv
+    std::vector<double> owned;
+    // or a mapped file
+    boost::interprocess::file_mapping file;
+    boost::interprocess::mapped_region region;
+
+    std::array<ReferenceRows, 4> sign_rows;
+
+    static std::vector<std::string> read_lines(const boost::filesystem::path &file_path) {
+        std::vector<std::string> lines;
+        std::ifstream ifs(file_path.string());
+        std::string line;
+        while (std::getline(ifs, line)) {
+            if (!line.empty()) {
+                lines.push_back(std::move(line));
+            }
+        }
+        return lines;
+    }
+
+public:
+    bool empty() const {
+        for (const auto &rows: sign_rows) {
+            if (!rows.empty()) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    const ReferenceRows &rows(Sign nu_r, Sign nu_theta) const {
+        return sign_rows[reference_sign_index(nu_r, nu_theta)];
+    }
+
+    // Read pp.csv, pm.csv, mp.csv and mm.csv (a, r_s, theta_s, r_o, lambda, eta, t_f, theta_f, phi_f). Every field is
+    // parsed once, in Float256 and in parallel. Missing files give empty rows.
+    void load_csv_directory(const std::string &path) {
+        const std::array<const char *, 4> file_names = {"pp.csv", "pm.csv", "mp.csv", "mm.csv"};
+        std::array<std::vector<std::string>, 4> lines;
+        size_t total = 0;
+        for (size_t k = 0; k < 4; k++) {
+            lines[k] = read_lines(boost::filesystem::path(path) / file_names[k]);
+            total += lines[k].size();
+        }
+
+        region = boost::interprocess::mapped_region();
+        owned.assign(total * REFERENCE_ROW_DOUBLES, 0);
+        size_t offset = 0;
+        for (size_t k = 0; k < 4; k++) {
+            double *data = owned.data() + offset * REFERENCE_ROW_DOUBLES;
+            const auto &file_lines = lines[k];
+            oneapi::tbb::parallel_for(size_t(0), file_lines.size(), [&](size_t i) {
+                const std::string &line = file_lines[i];
+                size_t begin = 0;
+                for (size_t field = 0; field < REFERENCE_FIELD_COUNT; field++) {
+                    size_t end = std::min(line.find(',', begin), line.size());
+                    auto value = boost::lexical_cast<Float256>(line.substr(begin, end - begin));
+                    auto parts = to_double_expansion<REFERENCE_LIMBS>(value);
+                    std::copy(parts.begin(), parts.end(), data + i * REFERENCE_ROW_DOUBLES + field * REFERENCE_LIMBS);
+                    begin = end + 1;
+                }
+            });
+            sign_rows[k] = ReferenceRows(data, file_lines.size());
+            offset += file_lines.size();
+        }
+    }
+
+    // Map a file written by write(), throws std::runtime_error if it is not a reference file of this version.
+    void open(const std::string &path) {
+        using namespace boost::interprocess;
+        file = file_mapping(path.c_str(), read_only);
+        region = mapped_region(file, read_only);
+        owned.clear();
+
+        const auto *bytes = static_cast<const char *>(region.get_address());
+        if (region.get_size() < sizeof(ReferenceFileHeader)) {
+            throw std::runtime_error(fmt::format("{} is not a reference data file", path));
+        }
+        ReferenceFileHeader header;
+        std::memcpy(&header, bytes, sizeof(header));
+        if (std::memcmp(header.magic, REFERENCE_MAGIC, sizeof(REFERENCE_MAGIC)) != 0 ||
+            header.version != REFERENCE_VERSION || header.field_count != REFERENCE_FIELD_COUNT ||
+            header.limbs != REFERENCE_LIMBS) {
+            throw std::runtime_error(fmt::format("{} is not a reference data file of version {}", path,
+                                                 REFERENCE_VERSION));
+        }
+        uint64_t total = 0;
+        for (uint64_t count: header.row_count) {
+            total += count;
+        }
+        if (region.get_size() != sizeof(header) + total * REFERENCE_ROW_DOUBLES * sizeof(double)) {
+            throw std::runtime_error(fmt::format("{} is truncated", path));
+        }
+
+        const auto *data = reinterpret_cast<const double *>(bytes + sizeof(header));
+        for (size_t k = 0; k < 4; k++) {
+            sign_rows[k] = ReferenceRows(data, header.row_count[k]);
+            data += header.row_count[k] * REFERENCE_ROW_DOUBLES;
+        }
+    }
+
+    void write(const std::string &path) const {
+        std::ofstream ofs(path, std::ios::binary);
+        if (!ofs) {
+            throw std::runtime_error(fmt::format("cannot open {}", path));
+        }
+        ReferenceFileHeader header{};
+        std::memcpy(header.magic, REFERENCE_MAGIC, sizeof(REFERENCE_MAGIC));
+        header.version = REFERENCE_VERSION;
+        header.field_count = REFERENCE_FIELD_COUNT;
+        header.limbs = REFERENCE_LIMBS;
+        for (size_t k = 0; k < 4; k++) {
+            header.row_count[k] = sign_rows[k].size();
+        }
+        ofs.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        for (const auto &rows: sign_rows) {
+            ofs.write(reinterpret_cast<const char *>(rows.raw()),
+                      static_cast<std::streamsize>(rows.size() * REFERENCE_ROW_DOUBLES * sizeof(double)));
+        }
+    }
+};
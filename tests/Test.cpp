@@ -1,12 +1,16 @@
+#include <random>
 #include <tuple>
 
+#include "GeodesicIntegrator.h"
+#include "QueryBatch.h"
+#include "QueryServer.h"
 #include "TestData.h"
 #include <oneapi/tbb.h>
 
 using std::string;
 
 template<typename Real, typename Complex>
-void test_case(std::vector<std::array<std::string, 9>> &test_data, Sign nu_r, Sign nu_theta) {
+void test_case(const ReferenceRows &test_data, Sign nu_r, Sign nu_theta) {
     using Vector = Eigen::Matrix<Real, Eigen::Dynamic, 1>;
 
     const Real error_limit = ErrorLimit<Real>::Value * 100000000;
@@ -28,16 +32,15 @@ void test_case(std::vector<std::array<std::string, 9>> &test_data, Sign nu_r, Si
         ForwardRayTracingParams<Real> params;
         auto forward = ForwardRayTracing<Real, Complex>::get_from_cache();
         for (size_t i = range.begin(); i < range.end(); ++i) {
-            const auto &item = test_data[i];
-            params.a = boost::lexical_cast<Real>(item[0]);
-            params.r_s = boost::lexical_cast<Real>(item[1]);
-            params.theta_s = boost::lexical_cast<Real>(item[2]);
-            params.r_o = boost::lexical_cast<Real>(item[3]);
+            params.a = test_data.get<Real>(i, ReferenceField::A);
+            params.r_s = test_data.get<Real>(i, ReferenceField::R_S);
+            params.theta_s = test_data.get<Real>(i, ReferenceField::THETA_S);
+            params.r_o = test_data.get<Real>(i, ReferenceField::R_O);
             params.nu_r = nu_r;
             params.nu_theta = nu_theta;
 
-            params.lambda = boost::lexical_cast<Real>(item[4]);
-            params.q = sqrt(boost::lexical_cast<Real>(item[5]));
+            params.lambda = test_data.get<Real>(i, ReferenceField::LAMBDA);
+            params.q = sqrt(test_data.get<Real>(i, ReferenceField::ETA));
             params.calc_t_f = true;
 
             try {
@@ -51,9 +54,9 @@ void test_case(std::vector<std::array<std::string, 9>> &test_data, Sign nu_r, Si
                     theta_f_vec[i] = std::numeric_limits<Real>::quiet_NaN();
                     phi_f_vec[i] = std::numeric_limits<Real>::quiet_NaN();
                 } else {
-                    t_f_vec[i] = abs(forward->t_f - boost::lexical_cast<Real>(item[6]));
-                    theta_f_vec[i] = abs(forward->theta_f - boost::lexical_cast<Real>(item[7]));
-                    phi_f_vec[i] = abs(forward->phi_f - boost::lexical_cast<Real>(item[8]));
+                    t_f_vec[i] = abs(forward->t_f - test_data.get<Real>(i, ReferenceField::T_F));
+                    theta_f_vec[i] = abs(forward->theta_f - test_data.get<Real>(i, ReferenceField::THETA_F));
+                    phi_f_vec[i] = abs(forward->phi_f - test_data.get<Real>(i, ReferenceField::PHI_F));
 
                     if (t_f_vec[i] > 10 * error_limit || theta_f_vec[i] > 10 * error_limit || phi_f_vec[i] > 10 * error_limit) {
                         possible_error_indices.push_back(i);
@@ -101,19 +104,1232 @@ TEMPLATE_TEST_CASE("Forward Function", "[forward]", TEST_TYPES) {
     fmt::println("[{}, {}] Error limit: {}", TypeName<Real>::Get(), TypeName<Complex>::Get(), ErrorLimit<Real>::Value);
 
     SECTION("nu_r = POSITIVE, nu_theta = POSITIVE") {
-        test_case<Real, Complex>(TEST_DATA_PP, Sign::POSITIVE, Sign::POSITIVE);
+        test_case<Real, Complex>(TEST_DATA.rows(Sign::POSITIVE, Sign::POSITIVE), Sign::POSITIVE, Sign::POSITIVE);
     }
     SECTION("nu_r = POSITIVE, nu_theta = NEGATIVE") {
-        test_case<Real, Complex>(TEST_DATA_PM, Sign::POSITIVE, Sign::NEGATIVE);
+        test_case<Real, Complex>(TEST_DATA.rows(Sign::POSITIVE, Sign::NEGATIVE), Sign::POSITIVE, Sign::NEGATIVE);
     }
     SECTION("nu_r = NEGATIVE, nu_theta = POSITIVE") {
-        test_case<Real, Complex>(TEST_DATA_MP, Sign::NEGATIVE, Sign::POSITIVE);
+        test_case<Real, Complex>(TEST_DATA.rows(Sign::NEGATIVE, Sign::POSITIVE), Sign::NEGATIVE, Sign::POSITIVE);
     }
     SECTION("nu_r = NEGATIVE, nu_theta = NEGATIVE") {
-        test_case<Real, Complex>(TEST_DATA_MM, Sign::NEGATIVE, Sign::NEGATIVE);
+        test_case<Real, Complex>(TEST_DATA.rows(Sign::NEGATIVE, Sign::NEGATIVE), Sign::NEGATIVE, Sign::NEGATIVE);
     }
 }
 
+TEST_CASE("Numerical Integration", "[forward][ode]") {
+    // random rays integrated numerically, independent of the reference data
+    std::mt19937 gen(42);
+    std::uniform_real_distribution<double> unit(0, 1);
+
+    ForwardRayTracingParams<double> params;
+    params.a = 0.8;
+    params.r_s = 10;
+    params.theta_s = 85 * boost::math::constants::pi<double>() / 180;
+    params.r_o = 1000;
+    params.calc_t_f = true;
+    params.print_args_error = false;
+    auto [rc_min, rc_max] = get_rc_range(params.a);
+
+    std::vector<ForwardRayTracingParams<double>> params_list;
+    for (int i = 0; i < 256; i++) {
+        params.nu_r = unit(gen) < 0.5 ? Sign::POSITIVE : Sign::NEGATIVE;
+        params.nu_theta = unit(gen) < 0.5 ? Sign::POSITIVE : Sign::NEGATIVE;
+        params.d_sign = unit(gen) < 0.5 ? Sign::POSITIVE : Sign::NEGATIVE;
+        params.rc = rc_min + (rc_max - rc_min) * unit(gen);
+        params.log_abs_d = -4 + 5 * unit(gen);
+        params.rc_d_to_lambda_q();
+        params_list.push_back(params);
+    }
+
+    GeodesicIntegratorSettings<double> settings;
+    settings.abs_tol = 1e-13;
+    settings.rel_tol = 1e-13;
+    auto results = GeodesicIntegrator<double, std::complex<double>>::integrate_batch(params_list, settings);
+
+    auto forward = ForwardRayTracing<double, std::complex<double>>::get_from_cache();
+    for (size_t i = 0; i < params_list.size(); i++) {
+        forward->calc_ray(params_list[i]);
+        REQUIRE(forward->ray_status == results[i].ray_status);
+        if (forward->ray_status != RayStatus::NORMAL) {
+            continue;
+        }
+        CHECK(std::abs(forward->theta_f - results[i].theta_f) < 1e-6);
+        CHECK(std::abs(forward->phi_f - results[i].phi_f) < 1e-6);
+        CHECK(std::abs(forward->t_f - results[i].t_f) < 1e-6 * std::abs(forward->t_f));
+    }
+
+    // a tolerance no step can meet and an end that is never refined are failures, not endless loops
+    size_t normal = std::find_if(results.begin(), results.end(), [](const auto &result) {
+        return result.ray_status == RayStatus::NORMAL;
+    }) - results.begin();
+    REQUIRE(normal < results.size());
+    auto failing = settings;
+    failing.abs_tol = 0;
+    failing.rel_tol = 0;
+    failing.max_rejected_steps = 1000;
+    auto rejected = GeodesicIntegrator<double, std::complex<double>>::integrate(*forward, params_list[normal], failing);
+    CHECK(rejected.ray_status == RayStatus::INTERNAL_ERROR);
+    CHECK(rejected.rejected_steps == failing.max_rejected_steps + 1);
+    failing = settings;
+    failing.max_newton_iterations = 0;
+    auto unrefined = GeodesicIntegrator<double, std::complex<double>>::integrate(*forward, params_list[normal], failing);
+    CHECK(unrefined.ray_status == RayStatus::INTERNAL_ERROR);
+}
+
+TEMPLATE_TEST_CASE("Special Function Errors", "[forward]", TEST_TYPES) {
+    using Real = std::tuple_element_t<0u, TestType>;
+    // errors are counted on the calling thread instead of thrown, also when errno was set before
+    errno = EDOM;
+    size_t errors = special_function_errors;
+    CHECK(isfinite(ellint_1(Real(0.5))));
+    CHECK(isfinite(ellint_rj(Real(1), Real(2), Real(3), Real(4))));
+    CHECK(special_function_errors == errors);
+    CHECK(isnan(ellint_1(Real(2))));
+    CHECK(special_function_errors == errors + 1);
+    CHECK(isnan(ellint_rf(Real(-1), Real(1), Real(1))));
+    CHECK(special_function_errors == errors + 2);
+}
+
+TEMPLATE_TEST_CASE("Ray Classifier", "[classifier]", TEST_TYPES) {
+    using Real = std::tuple_element_t<0u, TestType>;
+    using Complex = std::tuple_element_t<1u, TestType>;
+    const Real pi = boost::math::constants::pi<Real>();
+
+    ForwardRayTracingParams<Real> params;
+    params.a = boost::lexical_cast<Real>("0.8");
+    params.r_s = 10;
+    params.theta_s = 85 * pi / 180;
+    params.r_o = 1000;
+    params.print_args_error = false;
+    auto forward = ForwardRayTracing<Real, Complex>::get_from_cache();
+
+    // every status the classifier decides is the status calc_ray gives the ray
+    std::array<size_t, RAY_STATUS_COUNT> classified{};
+    auto check_ray = [&](const Real &lambda, const Real &q) {
+        params.lambda = lambda;
+        params.q = q;
+        for (Sign nu_r: {Sign::POSITIVE, Sign::NEGATIVE}) {
+            params.nu_r = nu_r;
+            RayStatus status = RayClassifier<Real>(params).classify(lambda, q);
+            if (status == RayStatus::NORMAL) {
+                continue;
+            }
+            classified[static_cast<size_t>(status)]++;
+            forward->calc_ray(params);
+            INFO("lambda = " << lambda << ", q = " << q << ", nu_r = " << GET_SIGN(nu_r));
+            CHECK(ray_status_to_str(forward->ray_status) == std::string(ray_status_to_str(status)));
+        }
+    };
+
+    // (lambda, q) plane around the shadow, with lambda = 0 and q = 0
+    for (int i = -25; i <= 25; i++) {
+        for (int k = 0; k <= 25; k++) {
+            check_ray(Real(i), Real(k));
+        }
+    }
+
+    // rays on either side of Theta(theta_s) = 0 and of R(r_s) = 0, down to where the classifier defers to tracing
+    const Real a2 = params.a * params.a;
+    const Real cos2 = cos(params.theta_s) * cos(params.theta_s);
+    const Real cot2 = cos2 / (sin(params.theta_s) * sin(params.theta_s));
+    const Real r2_a2 = params.r_s * params.r_s + a2;
+    const Real delta = r2_a2 - 2 * params.r_s;
+    for (int i = -40; i <= 40; i++) {
+        Real lambda = Real(i) / 2;
+        Real eta_theta = lambda * lambda * cot2 - a2 * cos2;
+        Real eta_r = (r2_a2 - params.a * lambda) * (r2_a2 - params.a * lambda) / delta -
+                     (lambda - params.a) * (lambda - params.a);
+        for (const Real &eta: {eta_theta, eta_r}) {
+            if (eta <= 0) {
+                continue;
+            }
+            Real q = sqrt(eta);
+            for (int bits: {8, 16, 24, 40, std::numeric_limits<Real>::digits - 4}) {
+                Real offset = q * pow(Real(2), -bits);
+                check_ray(lambda, q + offset);
+                check_ray(lambda, q - offset);
+            }
+        }
+    }
+
+    // the cells of a sweep grid on both sides of the critical curve, down to d = 1e-30
+    std::vector<Real> rc_list(16);
+    std::vector<Real> lgd_list;
+    auto [rc_down, rc_up] = get_rc_range(params.a);
+    for (size_t j = 0; j < rc_list.size(); j++) {
+        rc_list[j] = rc_down + (rc_up - rc_down) * int(j + 1) / int(rc_list.size() + 1);
+    }
+    for (int i = -30; i <= 2; i++) {
+        lgd_list.push_back(Real(i));
+    }
+    for (Sign d_sign: {Sign::POSITIVE, Sign::NEGATIVE}) {
+        SweepGrid<Real> grid(params.get_background(), d_sign, rc_list, lgd_list);
+        for (Sign nu_r: {Sign::POSITIVE, Sign::NEGATIVE}) {
+            params.nu_r = nu_r;
+            std::vector<RayStatus> status;
+            RayClassifier<Real>(params).classify_tile(grid, 0, lgd_list.size(), 0, rc_list.size(), status);
+            for (size_t i = 0; i < lgd_list.size(); i++) {
+                for (size_t j = 0; j < rc_list.size(); j++) {
+                    RayStatus cell = status[i * rc_list.size() + j];
+                    if (!grid.valid(i, j) || cell == RayStatus::NORMAL) {
+                        continue;
+                    }
+                    classified[static_cast<size_t>(cell)]++;
+                    grid.cell_lambda_q(i, j, params.lambda, params.q);
+                    forward->calc_ray(params);
+                    INFO("rc = " << rc_list[j] << ", log_abs_d = " << lgd_list[i] << ", nu_r = " << GET_SIGN(nu_r));
+                    CHECK(ray_status_to_str(forward->ray_status) == std::string(ray_status_to_str(cell)));
+                }
+            }
+        }
+    }
+
+    for (RayStatus status: {RayStatus::ARGUMENT_ERROR, RayStatus::ETA_OUT_OF_RANGE, RayStatus::THETA_OUT_OF_RANGE,
+                            RayStatus::R_OUT_OF_RANGE, RayStatus::FALLS_IN}) {
+        INFO(ray_status_to_str(status));
+        CHECK(classified[static_cast<size_t>(status)] > 0);
+    }
+}
+
+TEST_CASE("Diagnostics", "[diagnostics]") {
+    Diagnostics::clear();
+    // equal names at different addresses are one counter, on every thread
+    static const char source[] = "test_source";
+    static const char same_source[] = "test_source";
+    oneapi::tbb::parallel_for(0, 1000, [](int i) {
+        Diagnostics::report(RayStatus::INTERNAL_ERROR, i % 2 ? source : same_source, "x");
+        Diagnostics::report(RayStatus::ETA_OUT_OF_RANGE, source, i % 3 ? "x" : "y");
+    });
+    auto report = Diagnostics::collect();
+    CHECK(report.total(RayStatus::INTERNAL_ERROR) == 1000);
+    CHECK(report.total(RayStatus::ETA_OUT_OF_RANGE) == 1000);
+    REQUIRE(report.counts.size() == 3);
+    for (const auto &count: report.counts) {
+        CHECK(count.source == "test_source");
+    }
+    Diagnostics::clear();
+}
+
+TEST_CASE("Tracing", "[diagnostics]") {
+    CHECK(Tracing::escape("plain") == "plain");
+    CHECK(Tracing::escape("a \"b\" \\ c\n\t\x01") == R"(a \"b\" \\ c\n\t\u0001)");
+
+    // strings in the args of a span end up escaped in the trace
+    Tracing::start();
+    {
+        TraceSpan span("span", "test");
+        span.set_args([] { return fmt::format(R"("outcome":"{}")", Tracing::escape("residual \"nan\"\n")); });
+    }
+    Tracing::stop();
+    std::string json = Tracing::to_chrome_trace();
+    Tracing::clear();
+    CHECK(json.find(R"("args":{"outcome":"residual \"nan\"\n"})") != std::string::npos);
+}
+
+TEST_CASE("Query Batch Backgrounds", "[query]") {
+    using Batch = QueryBatch<double, std::complex<double>>;
+    const double theta_s = 85 * boost::math::constants::pi<double>() / 180;
+    std::vector<double> rays, roots;
+    for (int k = 0; k < 64; k++) {
+        double d_sign = k % 2 == 0 ? 1 : -1;
+        rays.insert(rays.end(), {0.8, 10, theta_s, 1000, -1, -1, -2 + 0.08 * k, -3 + 0.05 * k, d_sign});
+    }
+    for (int k = 0; k < 4; k++) {
+        roots.insert(roots.end(), {0.8, 10, theta_s, 1000, -1, -1, 2.5 + 0.1 * k, -6. + k, 1, 0.3, 0.8});
+    }
+
+    // without a cached background a batch of one spin builds one
+    QueryTable<double> table;
+    size_t builds = kerr_background_builds;
+    Batch::run(QueryKind::RAY, rays.data(), 64, 0, {}, {}, table);
+    CHECK(kerr_background_builds - builds == 1);
+
+    // with the background of context.prepare none is built
+    auto background = KerrBackground<double>::create(0.8);
+    QueryContext<double, std::complex<double>> context;
+    context.prepare = [&](ForwardRayTracingParams<double> &params) { params.background = background; };
+    for (QueryKind kind: {QueryKind::RAY, QueryKind::ROOT}) {
+        const std::vector<double> &values = kind == QueryKind::RAY ? rays : roots;
+        QueryTable<double> kind_table;
+        builds = kerr_background_builds;
+        Batch::run(kind, values.data(), values.size() / query_record_fields(kind), 0, {}, context, kind_table);
+        CHECK(kerr_background_builds - builds == 0);
+    }
+}
+
+// the tutorial sweep on a coarse grid of rc_size x lgd_size nodes
+struct TutorialSweep {
+    ForwardRayTracingParams<double> params;
+    double theta_o = 17 * boost::math::constants::pi<double>() / 180;
+    double phi_o = boost::math::constants::pi<double>() / 4;
+    std::vector<double> rc_list;
+    std::vector<double> lgd_list;
+
+    TutorialSweep(size_t rc_size, size_t lgd_size) : rc_list(rc_size), lgd_list(lgd_size) {
+        params.a = 0.8;
+        params.r_s = 10;
+        params.theta_s = 85 * boost::math::constants::pi<double>() / 180;
+        params.r_o = 1000;
+        params.nu_r = Sign::NEGATIVE;
+        params.nu_theta = Sign::NEGATIVE;
+        params.d_sign = Sign::POSITIVE;
+        params.print_args_error = false;
+        auto [rc_down, rc_up] = get_rc_range(params.a);
+        for (size_t j = 0; j < rc_size; j++) {
+            rc_list[j] = rc_down + 0.05 + (rc_up - rc_down - 0.1) * j / (rc_size - 1.);
+        }
+        for (size_t i = 0; i < lgd_size; i++) {
+            lgd_list[i] = -10 + 12 * i / (lgd_size - 1.);
+        }
+    }
+};
+
+bool same_bits(double x, double y) {
+    return std::memcmp(&x, &y, sizeof(double)) == 0;
+}
+
+// candidates and status counts of two sweeps agree bit for bit
+void check_same_candidates(const SweepResult<double, std::complex<double>> &sweep,
+                           const SweepResult<double, std::complex<double>> &reference) {
+    for (auto [points, reference_points]: {std::make_pair(&sweep.theta_roots, &reference.theta_roots),
+                                           std::make_pair(&sweep.phi_roots, &reference.phi_roots),
+                                           std::make_pair(&sweep.theta_roots_closest,
+                                                          &reference.theta_roots_closest)}) {
+        REQUIRE(points->rows() == reference_points->rows());
+        for (Eigen::Index k = 0; k < points->size(); k++) {
+            CHECK(same_bits((*points)(k), (*reference_points)(k)));
+        }
+    }
+    CHECK(sweep.status_count == reference.status_count);
+}
+
+// candidates, roots and counts of two sweeps agree bit for bit
+void check_same_roots(const SweepResult<double, std::complex<double>> &sweep,
+                      const SweepResult<double, std::complex<double>> &reference) {
+    check_same_candidates(sweep, reference);
+    REQUIRE(sweep.results.size() == reference.results.size());
+    for (size_t k = 0; k < sweep.results.size(); k++) {
+        const auto &result = sweep.results[k];
+        const auto &reference_result = reference.results[k];
+        CHECK(result.ray_status == reference_result.ray_status);
+        CHECK(same_bits(result.rc, reference_result.rc));
+        CHECK(same_bits(result.log_abs_d, reference_result.log_abs_d));
+        CHECK(same_bits(result.theta_f, reference_result.theta_f));
+        CHECK(same_bits(result.phi_f, reference_result.phi_f));
+    }
+}
+
+// two values with the same expansion, so the same value, sign of zero and NaN
+template<typename Real>
+bool same_expansion(const Real &x, const Real &y) {
+    constexpr size_t N = double_expansion_size<Real>;
+    auto x_parts = to_double_expansion<N>(x);
+    auto y_parts = to_double_expansion<N>(y);
+    for (size_t i = 0; i < N; i++) {
+        if (!same_bits(x_parts[i], y_parts[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+TEMPLATE_TEST_CASE("Float Expansions", "[conversion]", TEST_TYPES) {
+    using Real = std::tuple_element_t<0u, TestType>;
+    constexpr size_t N = double_expansion_size<Real>;
+    const Real pi = boost::math::constants::pi<Real>();
+    const Real tiny = std::ldexp(1.0, -1000);
+    const Real huge = std::ldexp(1.0, 1000);
+    // zeros, infinities, NaN, values of more than one part and values whose tails are subnormal
+    std::vector<Real> values = {Real(0), -Real(0), std::numeric_limits<Real>::infinity(),
+                                -std::numeric_limits<Real>::infinity(), std::numeric_limits<Real>::quiet_NaN(),
+                                Real(1), Real(-3.5), pi, -pi / 3, Real(1) + Real(std::ldexp(1.0, -100)),
+                                pi * tiny, -pi * huge, Real(std::numeric_limits<double>::denorm_min())};
+
+    for (const Real &x: values) {
+        auto parts = to_double_expansion<N>(x);
+        CHECK(same_expansion(from_double_expansion<Real, N>(parts), x));
+        if (parts[0] == 0 || !std::isfinite(parts[0])) {
+            continue;
+        }
+        // as mpmath pairs
+        BinaryFraction fraction = to_binary_fraction(parts);
+        CHECK(fraction.negative == (x < 0));
+        CHECK((fraction.magnitude.front() & 1) == 1);
+        CHECK(same_expansion(from_binary_fraction<Real>(fraction), x));
+        auto split = split_binary_fraction<N>(fraction);
+        for (size_t i = 0; i < N; i++) {
+            CHECK(same_bits(split[i], parts[i]));
+        }
+        auto bytes = magnitude_to_bytes(fraction.magnitude);
+        CHECK(magnitude_from_bytes(reinterpret_cast<const unsigned char *>(bytes.data()), bytes.size()) ==
+              fraction.magnitude);
+    }
+
+    SECTION("pairs") {
+        BinaryFraction fraction = to_binary_fraction(Real(-3.5));
+        CHECK(fraction.negative);
+        CHECK(fraction.magnitude == std::vector<uint64_t>{7});
+        CHECK(fraction.exponent == -1);
+        if constexpr (N > 1) {
+            // 2^100 + 1 over 2^100
+            fraction = to_binary_fraction(Real(1) + Real(std::ldexp(1.0, -100)));
+            CHECK(fraction.magnitude == std::vector<uint64_t>{1, uint64_t(1) << 36});
+            CHECK(fraction.exponent == -100);
+        }
+        // beyond the range of double
+        CHECK(from_binary_fraction<Real>({false, {1}, 1100}) == std::numeric_limits<Real>::infinity());
+        CHECK(same_expansion(from_binary_fraction<Real>({true, {1}, -1100}), -Real(0)));
+        // more bits than Real holds round to nearest: 1 + 2^-300 to 1 and 2 - 2^-300 to 2. A double-double holds both
+        // exactly, as two parts.
+        if constexpr (!std::is_same_v<Real, DoubleDouble>) {
+            CHECK(from_binary_fraction<Real>({false, {1, 0, 0, 0, uint64_t(1) << 44}, -300}) == 1);
+            std::vector<uint64_t> ones(4, ~uint64_t(0));
+            ones.push_back((uint64_t(1) << 45) - 1);
+            CHECK(from_binary_fraction<Real>({false, ones, -300}) == 2);
+        }
+    }
+
+#ifdef FLOAT128_NATIVE
+    if constexpr (std::is_same_v<Real, Float128>) {
+        SECTION("binary128") {
+            std::array<char, BINARY128_SIZE> bytes{};
+            for (const Real &x: values) {
+                to_binary128(x, bytes.data());
+                Real y = from_binary128(bytes.data());
+                CHECK(std::memcmp(&x.backend().value(), &y.backend().value(), BINARY128_SIZE) == 0);
+            }
+            // sign, 15 exponent bits and 112 fraction bits, little-endian
+            to_binary128(Real(1), bytes.data());
+            CHECK(static_cast<unsigned char>(bytes[15]) == 0x3f);
+            CHECK(static_cast<unsigned char>(bytes[14]) == 0xff);
+            to_binary128(-Real(0), bytes.data());
+            CHECK(static_cast<unsigned char>(bytes[15]) == 0x80);
+            CHECK(std::all_of(bytes.begin(), bytes.begin() + 15, [](char byte) { return byte == 0; }));
+        }
+    }
+#endif
+}
+
+// the exact value of a double-double, Float128 holds the 106 bits of hi + lo
+Float128 to_float128(const DoubleDouble &x) {
+    return Float128(x.backend().hi) + Float128(x.backend().lo);
+}
+
+TEST_CASE("Double-Double Arithmetic", "[conversion]") {
+    using namespace double_double_detail;
+    std::mt19937_64 gen(7);
+    std::uniform_real_distribution<double> unit(-1, 1);
+    std::uniform_int_distribution<int> exponent(-60, 60);
+    const Float128 ulp = pow(Float128(2), -104);
+
+    // error-free transformations of doubles of similar magnitude, exact in Float128
+    for (int k = 0; k < 1000; k++) {
+        double a = std::ldexp(unit(gen), exponent(gen) / 4);
+        double b = std::ldexp(unit(gen), exponent(gen) / 4);
+        double s, err;
+        two_sum(a, b, s, err);
+        CHECK(Float128(s) + Float128(err) == Float128(a) + Float128(b));
+        CHECK(s == a + b);
+        if (std::abs(a) < std::abs(b)) {
+            std::swap(a, b);
+        }
+        quick_two_sum(a, b, s, err);
+        CHECK(Float128(s) + Float128(err) == Float128(a) + Float128(b));
+        two_prod(a, b, s, err);
+        CHECK(Float128(s) + Float128(err) == Float128(a) * Float128(b));
+        CHECK(s == a * b);
+    }
+
+    // operations on full double-doubles against Float128, within a few units of 2^-106
+    auto random_double_double = [&]() {
+        Float128 x = (Float128(unit(gen)) + Float128(unit(gen)) * pow(Float128(2), -53)) *
+                     pow(Float128(2), exponent(gen));
+        double hi = x.convert_to<double>();
+        return DoubleDouble(DoubleDoubleBackend(hi, (x - hi).convert_to<double>()));
+    };
+    for (int k = 0; k < 1000; k++) {
+        DoubleDouble x = random_double_double();
+        DoubleDouble y = random_double_double();
+        Float128 x128 = to_float128(x);
+        Float128 y128 = to_float128(y);
+        CHECK(abs(to_float128(x + y) - (x128 + y128)) <= ulp * (abs(x128) + abs(y128)));
+        CHECK(abs(to_float128(x - y) - (x128 - y128)) <= ulp * (abs(x128) + abs(y128)));
+        CHECK(abs(to_float128(x * y) - x128 * y128) <= ulp * abs(x128 * y128));
+        CHECK(abs(to_float128(x / y) - x128 / y128) <= ulp * abs(x128 / y128));
+        CHECK(abs(to_float128(x * y.backend().hi) - x128 * y.backend().hi) <= ulp * abs(x128 * y.backend().hi));
+        CHECK(abs(to_float128(x / y.backend().hi) - x128 / y.backend().hi) <= ulp * abs(x128 / y.backend().hi));
+        // Karp's trick corrects the double reciprocal square root once, which leaves a few more units
+        CHECK(abs(to_float128(sqrt(abs(x))) - sqrt(abs(x128))) <= 4 * ulp * sqrt(abs(x128)));
+
+        // comparisons follow the exact values, also when only the low parts differ
+        DoubleDouble z = x + DoubleDouble(std::ldexp(x.backend().hi, -80));
+        for (auto [u, v]: {std::make_pair(x, y), std::make_pair(x, z), std::make_pair(z, x), std::make_pair(x, x)}) {
+            CHECK((u < v) == (to_float128(u) < to_float128(v)));
+            CHECK((u > v) == (to_float128(u) > to_float128(v)));
+            CHECK((u == v) == (to_float128(u) == to_float128(v)));
+            CHECK((u <= v) == (to_float128(u) <= to_float128(v)));
+        }
+
+        // conversions to double round to nearest. A double-double can hold more than 106 bits when lo is far below
+        // hi, so strings of max_digits10 digits read back to within 2^-106 instead of exactly.
+        CHECK(x.convert_to<double>() == x128.convert_to<double>());
+        std::string str = x.str(std::numeric_limits<DoubleDouble>::max_digits10, std::ios_base::scientific);
+        CHECK(abs(to_float128(DoubleDouble(str)) - x128) <= ulp / 4 * abs(x128));
+    }
+
+    CHECK(abs(to_float128(DoubleDouble("0.1")) - Float128("0.1")) <= ulp * Float128("0.1"));
+    CHECK(DoubleDouble((1LL << 62) + 1).convert_to<long long>() == (1LL << 62) + 1);
+    CHECK(to_float128(DoubleDouble((1LL << 62) + 1)) == Float128((1LL << 62) + 1));
+    CHECK(isnan(sqrt(DoubleDouble(-1))));
+    CHECK(sqrt(DoubleDouble(0)) == 0);
+    CHECK(isinf(DoubleDouble(1) / DoubleDouble(0)));
+}
+
+TEMPLATE_TEST_CASE("Case Binned Executor", "[forward]", TEST_TYPES) {
+    using Real = std::tuple_element_t<0u, TestType>;
+    using Complex = std::tuple_element_t<1u, TestType>;
+    const Real pi = boost::math::constants::pi<Real>();
+
+    // every radial case, early exits and argument errors mixed in one batch
+    ForwardRayTracingParams<Real> params;
+    params.a = boost::lexical_cast<Real>("0.8");
+    params.r_s = 10;
+    params.theta_s = 85 * pi / 180;
+    params.r_o = 1000;
+    params.calc_t_f = true;
+    params.print_args_error = false;
+    auto [rc_down, rc_up] = get_rc_range(params.a);
+    std::vector<ForwardRayTracingParams<Real>> batch;
+    for (int k = 0; k < 96; k++) {
+        params.nu_r = k % 2 ? Sign::POSITIVE : Sign::NEGATIVE;
+        params.nu_theta = k % 3 ? Sign::POSITIVE : Sign::NEGATIVE;
+        params.d_sign = k % 5 < 2 ? Sign::NEGATIVE : Sign::POSITIVE;
+        params.rc = rc_down + (rc_up - rc_down) * (k % 11 + 1) / 12;
+        params.log_abs_d = Real(-6) + Real(k % 7);
+        params.rc_d_to_lambda_q();
+        batch.push_back(params);
+        if (k % 16 == 0) {
+            params.lambda = Real(3 + k / 16);
+            params.q = 0;
+            batch.push_back(params);
+            params.lambda = Real(25);
+            params.q = Real(1);
+            batch.push_back(params);
+            params.lambda = std::numeric_limits<Real>::quiet_NaN();
+            batch.push_back(params);
+        }
+    }
+
+    auto ray_tracing = ForwardRayTracing<Real, Complex>::get_from_cache();
+    std::vector<ForwardRayTracingResult<Real, Complex>> expected;
+    for (const auto &ray_params: batch) {
+        ray_tracing->calc_ray(ray_params);
+        expected.push_back(ray_tracing->to_result());
+    }
+
+    // two tiles through one executor, so the second reuses the storage of the first
+    CaseBinnedExecutor<Real, Complex> executor;
+    std::vector<ForwardRayTracingResult<Real, Complex>> results(batch.size());
+    std::array<size_t, RADIAL_CASE_COUNT> binned{};
+    size_t split = batch.size() / 3;
+    for (auto [begin, end]: {std::make_pair(size_t(0), split), std::make_pair(split, batch.size())}) {
+        for (size_t i = begin; i < end; i++) {
+            if (executor.prepare(*ray_tracing, i, batch[i]) != RayStatus::NORMAL) {
+                results[i] = ray_tracing->to_result();
+            }
+        }
+        for (RadialCase radial_case: {RadialCase::I2_PLUS, RadialCase::I2_MINUS, RadialCase::I3}) {
+            binned[static_cast<size_t>(radial_case)] += executor.bin_size(radial_case);
+        }
+        executor.execute(*ray_tracing, [&](size_t i, ForwardRayTracing<Real, Complex> &finished) {
+            CHECK(i >= begin);
+            CHECK(i < end);
+            results[i] = finished.to_result();
+        });
+        CHECK(executor.bin_size(RadialCase::I3) == 0);
+    }
+    for (RadialCase radial_case: {RadialCase::I2_PLUS, RadialCase::I2_MINUS, RadialCase::I3}) {
+        CHECK(binned[static_cast<size_t>(radial_case)] > 0);
+    }
+
+    std::array<size_t, RAY_STATUS_COUNT> status_count{};
+    for (size_t i = 0; i < batch.size(); i++) {
+        INFO("ray " << i);
+        status_count[static_cast<size_t>(expected[i].ray_status)]++;
+        CHECK(results[i].ray_status == expected[i].ray_status);
+        CHECK(same_expansion(results[i].theta_f, expected[i].theta_f));
+        CHECK(same_expansion(results[i].phi_f, expected[i].phi_f));
+        CHECK(same_expansion(results[i].t_f, expected[i].t_f));
+        CHECK(results[i].m == expected[i].m);
+        CHECK(same_expansion(results[i].n_half, expected[i].n_half));
+    }
+    for (RayStatus status: {RayStatus::NORMAL, RayStatus::FALLS_IN, RayStatus::ARGUMENT_ERROR,
+                            RayStatus::ETA_OUT_OF_RANGE, RayStatus::THETA_OUT_OF_RANGE}) {
+        INFO(ray_status_to_str(status));
+        CHECK(status_count[static_cast<size_t>(status)] > 0);
+    }
+}
+
+TEMPLATE_TEST_CASE("Sweep File", "[sweep]", TEST_TYPES) {
+    using Real = std::tuple_element_t<0u, TestType>;
+    using Complex = std::tuple_element_t<1u, TestType>;
+    using Maps = SweepResult<Real, Complex>;
+    const size_t rows = 10;
+    const size_t cols = 6;
+    const Real pi = boost::math::constants::pi<Real>();
+
+    ForwardRayTracingParams<Real> params;
+    params.a = boost::lexical_cast<Real>("0.8");
+    params.r_s = 10;
+    params.theta_s = 85 * pi / 180;
+    params.r_o = 1000;
+    params.nu_r = Sign::NEGATIVE;
+    params.nu_theta = Sign::POSITIVE;
+    params.d_sign = Sign::POSITIVE;
+    Real theta_o = 17 * pi / 180;
+    Real phi_o = pi / 3;
+    std::vector<Real> rc_list(cols);
+    std::vector<Real> lgd_list(rows);
+    for (size_t j = 0; j < cols; j++) {
+        rc_list[j] = 2 + pi * int(j) / 7;
+    }
+    for (size_t i = 0; i < rows; i++) {
+        lgd_list[i] = -10 + pi * int(i) / 3;
+    }
+
+    // values of every bit of Real, and -0, infinities and NaN in the first rows
+    Maps maps;
+    int scale = 1;
+    for (auto *map: {&maps.theta, &maps.phi, &maps.lambda, &maps.eta, &maps.delta_theta, &maps.delta_phi}) {
+        map->resize(rows, cols);
+        for (size_t i = 0; i < rows; i++) {
+            for (size_t j = 0; j < cols; j++) {
+                (*map)(i, j) = ((i + j) % 2 ? -pi : pi) * int(i + 1) / int(j + 3) / scale;
+            }
+        }
+        scale++;
+        (*map)(0, 0) = -Real(0);
+        (*map)(0, 1) = std::numeric_limits<Real>::quiet_NaN();
+        (*map)(1, 0) = -std::numeric_limits<Real>::infinity();
+    }
+    maps.status.resize(rows, cols);
+    for (size_t i = 0; i < rows; i++) {
+        for (size_t j = 0; j < cols; j++) {
+            maps.status(i, j) = static_cast<uint8_t>((i * cols + j) % RAY_STATUS_COUNT);
+        }
+    }
+    auto check_rows = [&](const SweepFile &sweep_file, size_t row_end) {
+        Maps read;
+        for (auto *map: {&read.theta, &read.phi, &read.lambda, &read.eta, &read.delta_theta, &read.delta_phi}) {
+            map->resize(rows, cols);
+        }
+        read.status.resize(rows, cols);
+        sweep_file.read_rows(read, 0, row_end);
+        for (auto [map, read_map]: {std::make_pair(&maps.theta, &read.theta), std::make_pair(&maps.phi, &read.phi),
+                                    std::make_pair(&maps.lambda, &read.lambda), std::make_pair(&maps.eta, &read.eta),
+                                    std::make_pair(&maps.delta_theta, &read.delta_theta),
+                                    std::make_pair(&maps.delta_phi, &read.delta_phi)}) {
+            for (size_t i = 0; i < row_end; i++) {
+                for (size_t j = 0; j < cols; j++) {
+                    CHECK(same_expansion((*read_map)(i, j), (*map)(i, j)));
+                }
+            }
+        }
+        CHECK(read.status.topRows(row_end) == maps.status.topRows(row_end));
+    };
+
+    boost::filesystem::path directory =
+        boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("kerrp2p-file-%%%%-%%%%");
+    boost::filesystem::create_directories(directory);
+    std::string path = (directory / "sweep").string();
+
+    // a run that wrote the first rows before it stopped
+    {
+        SweepFile sweep_file = SweepFile::create(path, params, theta_o, phi_o, rc_list, lgd_list, 4);
+        sweep_file.write_rows(maps, 0, 4);
+        sweep_file.flush();
+    }
+    {
+        SweepFile sweep_file(path);
+        CHECK(sweep_file.precision() == TypeName<Real>::Get());
+        CHECK(sweep_file.limbs() == double_expansion_size<Real>);
+        CHECK(sweep_file.tile_count() == 3);
+        CHECK(sweep_file.matches(params, rc_list, lgd_list));
+        CHECK(same_expansion(sweep_file.template theta_o<Real>(), theta_o));
+        CHECK(same_expansion(sweep_file.template phi_o<Real>(), phi_o));
+        CHECK(sweep_file.rows_written(0, 4));
+        CHECK(!sweep_file.rows_written(4, rows));
+        CHECK(sweep_file.status()(4, 0) == SWEEP_CELL_PENDING);
+        CHECK(std::isnan(sweep_file.map(SweepMap::THETA)(rows - 1, cols - 1)));
+        check_rows(sweep_file, 4);
+    }
+
+    // resumed from the first pending row, with the remaining rows held in a band of their own
+    {
+        Maps band;
+        band.theta = maps.theta.bottomRows(rows - 4);
+        band.phi = maps.phi.bottomRows(rows - 4);
+        band.lambda = maps.lambda.bottomRows(rows - 4);
+        band.eta = maps.eta.bottomRows(rows - 4);
+        band.delta_theta = maps.delta_theta.bottomRows(rows - 4);
+        band.delta_phi = maps.delta_phi.bottomRows(rows - 4);
+        band.status = maps.status.bottomRows(rows - 4);
+        SweepFile sweep_file(path, true);
+        sweep_file.write_rows(band, 4, rows, 4);
+        sweep_file.flush();
+    }
+    {
+        SweepFile sweep_file(path);
+        CHECK(sweep_file.rows_written(0, rows));
+        check_rows(sweep_file, rows);
+        CHECK(same_bits(sweep_file.map(SweepMap::PHI)(2, 3), static_cast<double>(maps.phi(2, 3))));
+
+        // maps of another precision are rejected
+        using OtherTypes = std::conditional_t<std::is_same_v<Real, double>, TestDoubleDouble, Test64>;
+        SweepResult<std::tuple_element_t<0u, OtherTypes>, std::tuple_element_t<1u, OtherTypes>> other;
+        CHECK_THROWS_AS(sweep_file.read_rows(other, 0, rows), std::invalid_argument);
+        CHECK_THROWS_AS(SweepFile(path, true).write_rows(other, 0, rows), std::invalid_argument);
+    }
+
+    // creating leaves nothing but the file
+    CHECK(std::distance(boost::filesystem::directory_iterator(directory), boost::filesystem::directory_iterator()) ==
+          1);
+    boost::filesystem::remove_all(directory);
+}
+
+TEST_CASE("Streaming Sweep", "[sweep]") {
+    using Utils = ForwardRayTracingUtils<double, std::complex<double>>;
+    TutorialSweep grid(40, 96);
+    auto reference = Utils::sweep_rc_d(grid.params, grid.theta_o, grid.phi_o, grid.rc_list, grid.lgd_list, 50, 1e-6);
+    REQUIRE(!reference.results.empty());
+
+    // single rows, bands that do not divide the 96 rows, one band and a band larger than the grid
+    for (size_t band_rows: {1, 7, 40, 96, 200}) {
+        INFO("band_rows = " << band_rows);
+        SweepStreamSettings<double> settings;
+        settings.band_rows = band_rows;
+        size_t next_row = 0;
+        settings.on_band = [&](const SweepBand<double> &band) {
+            CHECK(band.row_begin == next_row);
+            CHECK(band.halo == (band.row_begin > 0 ? 1 : 0));
+            next_row = band.row_end;
+            for (size_t i = band.row_begin; i < band.row_end; i++) {
+                size_t row = i - band.row_offset();
+                for (size_t j = 0; j < grid.rc_list.size(); j++) {
+                    CHECK(same_bits(band.theta(row, j), reference.theta(i, j)));
+                    CHECK(same_bits(band.phi(row, j), reference.phi(i, j)));
+                    CHECK(band.status(row, j) == reference.status(i, j));
+                }
+            }
+        };
+        auto streamed = Utils::sweep_rc_d_streaming(grid.params, grid.theta_o, grid.phi_o, grid.rc_list,
+                                                    grid.lgd_list, 50, 1e-6, settings);
+        CHECK(next_row == grid.lgd_list.size());
+        check_same_roots(streamed, reference);
+        CHECK(streamed.classified_count == reference.classified_count);
+    }
+}
+
+TEST_CASE("Streaming Sweep Resume", "[sweep]") {
+    using Utils = ForwardRayTracingUtils<double, std::complex<double>>;
+    TutorialSweep grid(40, 96);
+    auto reference = Utils::sweep_rc_d(grid.params, grid.theta_o, grid.phi_o, grid.rc_list, grid.lgd_list, 50, 1e-6);
+    REQUIRE(!reference.results.empty());
+
+    boost::filesystem::path spill_path =
+        boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("kerrp2p-%%%%-%%%%.swp");
+    SweepStreamSettings<double> settings;
+    settings.band_rows = 16;
+    settings.spill_path = spill_path.string();
+    settings.resume = true;
+
+    // a run killed after three bands is finished from its spill
+    size_t bands = 0;
+    settings.on_band = [&](const SweepBand<double> &) {
+        if (++bands == 3) {
+            throw std::runtime_error("interrupted");
+        }
+    };
+    CHECK_THROWS_AS(Utils::sweep_rc_d_streaming(grid.params, grid.theta_o, grid.phi_o, grid.rc_list, grid.lgd_list,
+                                                50, 1e-6, settings), std::runtime_error);
+    settings.on_band = nullptr;
+    auto resumed = Utils::sweep_rc_d_streaming(grid.params, grid.theta_o, grid.phi_o, grid.rc_list, grid.lgd_list, 50,
+                                               1e-6, settings);
+    check_same_roots(resumed, reference);
+    CHECK(resumed.classified_count <= reference.classified_count);
+
+    // a spill that cannot be mapped is reported and started over
+    Diagnostics::clear();
+    {
+        std::ofstream ofs(spill_path.string(), std::ios::binary | std::ios::trunc);
+        ofs << "not a sweep file";
+    }
+    auto restarted = Utils::sweep_rc_d_streaming(grid.params, grid.theta_o, grid.phi_o, grid.rc_list, grid.lgd_list,
+                                                 50, 1e-6, settings);
+    check_same_roots(restarted, reference);
+    CHECK(Diagnostics::collect().total(RayStatus::INTERNAL_ERROR) == 1);
+    CHECK(SweepFile(spill_path.string()).rows_written(0, grid.lgd_list.size()));
+
+    boost::filesystem::remove(spill_path);
+    boost::filesystem::remove(spill_path.string() + ".roots");
+}
+
+TEST_CASE("Sweep Cache", "[sweep]") {
+    using Utils = ForwardRayTracingUtils<double, std::complex<double>>;
+    TutorialSweep grid(24, 32);
+    auto reference = Utils::sweep_rc_d(grid.params, grid.theta_o, grid.phi_o, grid.rc_list, grid.lgd_list, 50, 1e-6);
+    REQUIRE(!reference.results.empty());
+
+    boost::filesystem::path directory =
+        boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("kerrp2p-cache-%%%%-%%%%");
+    SweepCache cache(directory.string());
+
+    // a miss stores the sweep and a hit serves it from the entry
+    auto stored = Utils::sweep_rc_d_cached(grid.params, grid.theta_o, grid.phi_o, grid.rc_list, grid.lgd_list, 50,
+                                           1e-6, cache);
+    check_same_roots(stored, reference);
+    uintmax_t entry_bytes = cache.size_bytes();
+    CHECK(entry_bytes > 0);
+    auto loaded = Utils::sweep_rc_d_cached(grid.params, grid.theta_o, grid.phi_o, grid.rc_list, grid.lgd_list, 50,
+                                           1e-6, cache);
+    check_same_roots(loaded, reference);
+
+    // temporary files take space until they are stale
+    auto write_temp = [&](const std::string &name, std::time_t age) {
+        boost::filesystem::path path = directory / name;
+        {
+            std::ofstream ofs(path.string(), std::ios::binary);
+            ofs << std::string(1000, 'x');
+        }
+        boost::filesystem::last_write_time(path, std::time(nullptr) - age);
+        return path;
+    };
+    auto live = write_temp("live.tmp", 0);
+    auto stale = write_temp("stale.tmp", 2 * SweepCache::STALE_TEMP_SECONDS);
+    CHECK(cache.size_bytes() == entry_bytes + 1000);
+    CHECK(boost::filesystem::exists(live));
+    CHECK(!boost::filesystem::exists(stale));
+
+    // a cache that cannot be written is reported and the sweep still returned
+    Diagnostics::clear();
+    boost::filesystem::remove_all(directory);
+    auto unstored = Utils::sweep_rc_d_cached(grid.params, grid.theta_o, grid.phi_o, grid.rc_list, grid.lgd_list, 50,
+                                             1e-6, cache);
+    check_same_roots(unstored, reference);
+    CHECK(Diagnostics::collect().total(RayStatus::INTERNAL_ERROR) == 1);
+}
+
+TEST_CASE("Sparse Sweep", "[sweep]") {
+    using Utils = ForwardRayTracingUtils<double, std::complex<double>>;
+    TutorialSweep grid(40, 96);
+    auto reference = Utils::sweep_rc_d(grid.params, grid.theta_o, grid.phi_o, grid.rc_list, grid.lgd_list, 50, 1e-6);
+    REQUIRE(!reference.results.empty());
+
+    // strips of single columns, uneven strips, a last strip of one column and one strip for the whole grid, with
+    // more threads than strips so rows are split too
+    oneapi::tbb::task_arena arena(4);
+    for (size_t strip_cols: {1, 7, 39, 64}) {
+        CAPTURE(strip_cols);
+        auto sparse = arena.execute([&] {
+            return Utils::sweep_rc_d_sparse(grid.params, grid.theta_o, grid.phi_o, grid.rc_list, grid.lgd_list, 50,
+                                            1e-6, strip_cols);
+        });
+        check_same_roots(sparse, reference);
+        CHECK(sparse.classified_count == reference.classified_count);
+        CHECK(sparse.theta.size() == 0);
+    }
+}
+
+// the maps of two sweeps agree bit for bit, NaN included
+void check_same_maps(const SweepResult<double, std::complex<double>> &sweep,
+                     const SweepResult<double, std::complex<double>> &reference) {
+    for (auto [map, reference_map]: {std::make_pair(&sweep.theta, &reference.theta),
+                                     std::make_pair(&sweep.phi, &reference.phi),
+                                     std::make_pair(&sweep.lambda, &reference.lambda),
+                                     std::make_pair(&sweep.eta, &reference.eta),
+                                     std::make_pair(&sweep.delta_theta, &reference.delta_theta),
+                                     std::make_pair(&sweep.delta_phi, &reference.delta_phi)}) {
+        REQUIRE(map->rows() == reference_map->rows());
+        REQUIRE(map->cols() == reference_map->cols());
+        for (Eigen::Index k = 0; k < map->size(); k++) {
+            CHECK(same_bits((*map)(k), (*reference_map)(k)));
+        }
+    }
+    CHECK(sweep.status == reference.status);
+}
+
+TEST_CASE("Extend Sweep", "[sweep]") {
+    using Utils = ForwardRayTracingUtils<double, std::complex<double>>;
+    const double tol = 1e-6;
+    TutorialSweep grid(40, 96);
+    auto fresh = Utils::sweep_rc_d(grid.params, grid.theta_o, grid.phi_o, grid.rc_list, grid.lgd_list, 50, tol);
+    REQUIRE(!fresh.results.empty());
+
+    auto sweep = [&](const std::vector<double> &rc_list, const std::vector<double> &lgd_list) {
+        return Utils::sweep_rc_d(grid.params, grid.theta_o, grid.phi_o, rc_list, lgd_list, 50, tol);
+    };
+    auto extend = [&](const SweepResult<double, std::complex<double>> &previous,
+                      const std::vector<double> &previous_rc_list, const std::vector<double> &previous_lgd_list) {
+        return Utils::sweep_rc_d_extend(grid.params, grid.theta_o, grid.phi_o, grid.rc_list, grid.lgd_list, 50, tol,
+                                        previous, previous_rc_list, previous_lgd_list);
+    };
+    // Roots of earlier pairs are kept even if the cutoff drops their pair on the new grid, so an extended sweep finds
+    // every root of the fresh one, up to the tolerance duplicates are dropped with, and may keep more.
+    auto check_has_roots = [&](const SweepResult<double, std::complex<double>> &extended) {
+        CHECK(extended.results.size() >= fresh.results.size());
+        for (const auto &root: fresh.results) {
+            CAPTURE(root.rc, root.log_abs_d);
+            CHECK(std::any_of(extended.results.begin(), extended.results.end(), [&](const auto &result) {
+                return std::abs(result.rc - root.rc) < tol && std::abs(result.log_abs_d - root.log_abs_d) < tol;
+            }));
+        }
+    };
+
+    // every other node of the grid, the last column and row are new
+    std::vector<double> coarse_rc_list, coarse_lgd_list;
+    for (size_t j = 0; j < grid.rc_list.size(); j += 2) {
+        coarse_rc_list.push_back(grid.rc_list[j]);
+    }
+    for (size_t i = 0; i < grid.lgd_list.size(); i += 2) {
+        coarse_lgd_list.push_back(grid.lgd_list[i]);
+    }
+    auto coarse = sweep(coarse_rc_list, coarse_lgd_list);
+
+    SECTION("identity") {
+        auto extended = extend(fresh, grid.rc_list, grid.lgd_list);
+        check_same_maps(extended, fresh);
+        check_same_roots(extended, fresh);
+        CHECK(extended.classified_count == 0);
+    }
+
+    SECTION("refine") {
+        auto extended = extend(coarse, coarse_rc_list, coarse_lgd_list);
+        check_same_maps(extended, fresh);
+        check_same_candidates(extended, fresh);
+        check_has_roots(extended);
+    }
+
+    SECTION("append") {
+        std::vector<double> first_rows(grid.lgd_list.begin(), grid.lgd_list.begin() + 64);
+        auto extended = extend(sweep(grid.rc_list, first_rows), grid.rc_list, first_rows);
+        check_same_maps(extended, fresh);
+        check_same_candidates(extended, fresh);
+        check_has_roots(extended);
+    }
+
+    SECTION("overlapping results") {
+        // each fresh root twice among the earlier results, 0.6 tol to either side. Both are duplicates of a root
+        // solved again near the fresh one, which is dropped once, and neither is a duplicate of the other.
+        auto previous = coarse;
+        previous.results.clear();
+        for (const auto &root: fresh.results) {
+            for (double offset: {0.6 * tol, -0.6 * tol}) {
+                previous.results.push_back(root);
+                previous.results.back().rc += offset;
+            }
+        }
+        auto extended = extend(previous, coarse_rc_list, coarse_lgd_list);
+        check_same_maps(extended, fresh);
+        check_same_candidates(extended, fresh);
+        check_has_roots(extended);
+        for (const auto &root: previous.results) {
+            CAPTURE(root.rc, root.log_abs_d);
+            CHECK(std::count_if(extended.results.begin(), extended.results.end(), [&](const auto &result) {
+                return same_bits(result.rc, root.rc) && same_bits(result.log_abs_d, root.log_abs_d);
+            }) == 1);
+        }
+    }
+
+    SECTION("file") {
+        // a file holds no candidates or roots, every pair is solved again as in a fresh sweep
+        boost::filesystem::path path =
+            boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("kerrp2p-%%%%-%%%%.sweep");
+        write_sweep_file(path.string(), coarse, grid.params, grid.theta_o, grid.phi_o, coarse_rc_list,
+                         coarse_lgd_list);
+        auto extended = Utils::sweep_rc_d_extend(SweepFile(path.string()), grid.rc_list, grid.lgd_list, 50, tol);
+        check_same_maps(extended, fresh);
+        check_same_roots(extended, fresh);
+        boost::filesystem::remove(path);
+    }
+}
+
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+template<typename Real>
+void check_same_table(const QueryTable<Real> &served, const QueryTable<Real> &local) {
+    REQUIRE(served.rows == local.rows);
+    REQUIRE(served.columns.size() == local.columns.size());
+    for (size_t c = 0; c < local.columns.size(); c++) {
+        const auto &column = local.columns[c];
+        REQUIRE(served.columns[c].name == column.name);
+        REQUIRE(served.columns[c].kind == column.kind);
+        CHECK(served.columns[c].integers == column.integers);
+        for (size_t k = 0; k < column.reals.size(); k++) {
+            const Real &value = served.columns[c].reals[k];
+            CHECK((value == column.reals[k] || (isnan(value) && isnan(column.reals[k]))));
+        }
+    }
+}
+
+TEST_CASE("Query Server", "[query]") {
+    using Batch = QueryBatch<double, std::complex<double>>;
+    using Protocol = boost::asio::local::stream_protocol;
+    const double theta_s = 85 * boost::math::constants::pi<double>() / 180;
+    std::string socket_path =
+        (boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("kerrp2p-%%%%-%%%%.sock")).string();
+
+    QueryServer server(socket_path, 2);
+    std::thread server_thread([&] { server.run(); });
+    // a live server is not replaced
+    CHECK_THROWS_AS(QueryServer(socket_path), std::runtime_error);
+
+    QueryClient client(socket_path);
+    client.ping();
+
+    // rays, roots and sweeps come back as the batch computes them locally
+    std::vector<double> rays, roots, sweeps;
+    for (int k = 0; k < 8; k++) {
+        rays.insert(rays.end(), {0.8, 10, theta_s, 1000, -1, -1, -2 + 0.6 * k, -3 + 0.4 * k, k % 2 == 0 ? 1. : -1.});
+    }
+    for (int k = 0; k < 2; k++) {
+        roots.insert(roots.end(), {0.8, 10, theta_s, 1000, -1, -1, 2.5 + 0.1 * k, -6. + k, 1, 0.3, 0.8});
+    }
+    QueryOptions<double> options;
+    options.calc_t_f = true;
+    options.rc_count = 12;
+    options.lgd_count = 12;
+    QueryContext<double, std::complex<double>> context;
+    context.sweep = ForwardRayTracingUtils<double, std::complex<double>>::sweep_rc_d;
+    for (QueryKind kind: {QueryKind::RAY, QueryKind::ROOT}) {
+        const std::vector<double> &values = kind == QueryKind::RAY ? rays : roots;
+        QueryTable<double> local;
+        Batch::run(kind, values.data(), values.size() / query_record_fields(kind), 0, options, context, local);
+        check_same_table(client.query(kind, values, options), local);
+    }
+    // the second observer reuses the maps of the first
+    for (double phi_o: {0.8, 2.1}) {
+        sweeps = {0.8, 10, theta_s, 1000, -1, -1, 1, 0.3, phi_o};
+        QueryTable<double> local;
+        Batch::run(QueryKind::SWEEP, sweeps.data(), 1, 0, options, context, local);
+        check_same_table(client.query(QueryKind::SWEEP, sweeps, options), local);
+    }
+
+    // a request whose options or spin are rejected is answered and the connection stays usable
+    auto send = [](Protocol::socket &socket, QueryKind kind, uint32_t count, const std::vector<double> &payload) {
+        QueryRequestHeader header{};
+        std::memcpy(header.magic, QUERY_MAGIC, sizeof(QUERY_MAGIC));
+        header.kind = static_cast<uint8_t>(kind);
+        header.precision = static_cast<uint8_t>(QueryPrecision::DOUBLE);
+        header.count = count;
+        boost::asio::write(socket, boost::asio::buffer(&header, sizeof(header)));
+        boost::asio::write(socket, boost::asio::buffer(payload));
+    };
+    auto read_status = [](Protocol::socket &socket) {
+        QueryResponseHeader response_header;
+        boost::asio::read(socket, boost::asio::buffer(&response_header, sizeof(response_header)));
+        // only the message of a failure is read, a table ends the exchange
+        if (response_header.status != 0) {
+            std::string message(response_header.message_size, '\0');
+            boost::asio::read(socket, boost::asio::buffer(message));
+        }
+        return response_header.status;
+    };
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    boost::asio::io_context io_context;
+    Protocol::socket socket(io_context);
+    socket.connect(Protocol::endpoint(socket_path));
+    std::vector<double> ray(rays.begin(), rays.begin() + 9);
+    for (const std::vector<double> &bad_options: {std::vector<double>{0, 1e-6, 50, nan, 0.05, -10, 2, 12},
+                                                  std::vector<double>{0, 1e-6, 50, 12.5, 0.05, -10, 2, 12},
+                                                  std::vector<double>{0, 1e-6, -1, 12, 0.05, -10, 2, 12},
+                                                  std::vector<double>{0, nan, 50, 12, 0.05, -10, 2, 12}}) {
+        std::vector<double> payload(bad_options);
+        payload.insert(payload.end(), ray.begin(), ray.end());
+        send(socket, QueryKind::RAY, 1, payload);
+        CHECK(read_status(socket) == 1);
+    }
+    std::vector<double> payload{0, 1e-6, 50, 12, 0.05, -10, 2, 12};
+    std::vector<double> nan_spin(ray);
+    nan_spin[0] = nan;
+    payload.insert(payload.end(), nan_spin.begin(), nan_spin.end());
+    send(socket, QueryKind::RAY, 1, payload);
+    CHECK(read_status(socket) == 1);
+    payload = {0, 1e-6, 50, 4096, 0.05, -10, 2, 4096};
+    payload.insert(payload.end(), sweeps.begin(), sweeps.end());
+    send(socket, QueryKind::SWEEP, 1, payload);
+    CHECK(read_status(socket) == 1);
+    payload.resize(8);
+    payload.insert(payload.end(), ray.begin(), ray.end());
+    payload[3] = payload[7] = 12;
+    send(socket, QueryKind::RAY, 1, payload);
+    CHECK(read_status(socket) == 0);
+
+    // a malformed header or a payload over the limit closes the connection before anything is read
+    auto closed_after = [&](const QueryRequestHeader &header) {
+        Protocol::socket raw(io_context);
+        raw.connect(Protocol::endpoint(socket_path));
+        boost::asio::write(raw, boost::asio::buffer(&header, sizeof(header)));
+        char byte;
+        boost::system::error_code ec;
+        boost::asio::read(raw, boost::asio::buffer(&byte, 1), ec);
+        return ec == boost::asio::error::eof;
+    };
+    QueryRequestHeader header{};
+    std::memcpy(header.magic, QUERY_MAGIC, sizeof(QUERY_MAGIC));
+    header.kind = static_cast<uint8_t>(QueryKind::RAY);
+    header.count = 1;
+    QueryRequestHeader bad_magic = header;
+    bad_magic.magic[3] = '0';
+    CHECK(closed_after(bad_magic));
+    QueryRequestHeader bad_kind = header;
+    bad_kind.kind = 9;
+    CHECK(closed_after(bad_kind));
+    QueryRequestHeader bad_precision = header;
+    bad_precision.precision = 7;
+    CHECK(closed_after(bad_precision));
+    QueryRequestHeader too_many = header;
+    too_many.count = QUERY_MAX_RECORDS + 1;
+    CHECK(closed_after(too_many));
+    QueryRequestHeader too_large = header;
+    too_large.count = QUERY_MAX_RECORDS;
+    CHECK(closed_after(too_large));
+
+    client.ping();
+    server.stop();
+    server_thread.join();
+}
+
+#ifdef KERRP2P_PATH
+// the kerrp2p executable: records parsed from a file, computed in batches and written in input order
+TEST_CASE("Command Line", "[cli]") {
+    using Batch = QueryBatch<double, std::complex<double>>;
+    const double theta_s = 85 * boost::math::constants::pi<double>() / 180;
+    boost::filesystem::path directory =
+        boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("kerrp2p-cli-%%%%-%%%%");
+    boost::filesystem::create_directories(directory);
+    std::string input = (directory / "rays.txt").string();
+    std::string output = (directory / "out").string();
+    std::string errors = (directory / "errors.txt").string();
+    auto kerrp2p = [&](const std::string &args) {
+        return std::system(fmt::format("{} {} 2> {}", KERRP2P_PATH, args, errors).c_str());
+    };
+    auto read_file = [](const std::string &path) {
+        std::ifstream ifs(path, std::ios::binary);
+        return std::string(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+    };
+
+    // rays of both d signs with comments, blank lines and commas between the fields, over several batches
+    std::vector<double> values;
+    {
+        std::ofstream ofs(input);
+        ofs << "# a, r_s, theta_s, r_o, nu_r, nu_theta, rc, log_abs_d, d_sign\n\n";
+        for (int k = 0; k < 10; k++) {
+            std::vector<double> record = {0.8, 10, theta_s, 1000, -1, k % 3 == 0 ? 1. : -1., -2 + 0.5 * k,
+                                          -3 + 0.4 * k, k % 2 == 0 ? 1. : -1.};
+            values.insert(values.end(), record.begin(), record.end());
+            ofs << fmt::format("{}\n", fmt::join(record, k % 2 == 0 ? " " : ","));
+        }
+    }
+    QueryOptions<double> options;
+    options.calc_t_f = true;
+    QueryTable<double> expected;
+    Batch::run(QueryKind::RAY, values.data(), 10, 0, options, {}, expected);
+
+    SECTION("csv") {
+        REQUIRE(kerrp2p(fmt::format("ray --t-f --batch 3 -o {} {}", output, input)) == 0);
+        std::istringstream csv(read_file(output));
+        std::string line;
+        std::vector<std::string> names;
+        for (const auto &column: expected.columns) {
+            names.push_back(column.name);
+        }
+        REQUIRE(std::getline(csv, line));
+        CHECK(line == fmt::format("{}", fmt::join(names, ",")));
+        for (size_t k = 0; k < expected.rows; k++) {
+            std::vector<std::string> cells;
+            for (const auto &column: expected.columns) {
+                if (column.kind == QueryTable<double>::Kind::REAL) {
+                    cells.push_back(fmt::format("{}", column.reals[k]));
+                } else if (column.name == "status") {
+                    cells.emplace_back(ray_status_to_str(static_cast<RayStatus>(column.integers[k])));
+                } else {
+                    cells.push_back(fmt::format("{}", column.integers[k]));
+                }
+            }
+            REQUIRE(std::getline(csv, line));
+            CHECK(line == fmt::format("{}", fmt::join(cells, ",")));
+        }
+        CHECK(!std::getline(csv, line));
+    }
+
+    SECTION("binary") {
+        REQUIRE(kerrp2p(fmt::format("ray --t-f --batch 3 --format binary -o {} {}", output, input)) == 0);
+        std::string data = read_file(output);
+        size_t pos = 0;
+        auto read = [&](auto &value) {
+            REQUIRE(pos + sizeof(value) <= data.size());
+            std::memcpy(&value, data.data() + pos, sizeof(value));
+            pos += sizeof(value);
+        };
+        char magic[8];
+        uint32_t version, limbs, column_count;
+        read(magic);
+        read(version);
+        read(limbs);
+        read(column_count);
+        CHECK(std::string(magic, 8) == "KERRCOLS");
+        CHECK(version == 1);
+        CHECK(limbs == 1);
+        REQUIRE(column_count == expected.columns.size());
+        for (const auto &column: expected.columns) {
+            uint8_t kind;
+            uint32_t length;
+            read(kind);
+            read(length);
+            CHECK(kind == static_cast<uint8_t>(column.kind));
+            CHECK(data.substr(pos, length) == column.name);
+            pos += length;
+        }
+        // blocks of rows, each column after another
+        size_t row = 0;
+        while (pos < data.size()) {
+            uint64_t rows;
+            read(rows);
+            REQUIRE(row + rows <= expected.rows);
+            for (const auto &column: expected.columns) {
+                for (size_t k = row; k < row + rows; k++) {
+                    if (column.kind == QueryTable<double>::Kind::REAL) {
+                        double value;
+                        read(value);
+                        CHECK(same_bits(value, column.reals[k]));
+                    } else {
+                        int64_t value;
+                        read(value);
+                        CHECK(value == column.integers[k]);
+                    }
+                }
+            }
+            row += rows;
+        }
+        CHECK(row == expected.rows);
+    }
+
+    SECTION("errors") {
+        {
+            std::ofstream ofs(input, std::ios::app);
+            ofs << "0.8 10 1.4 1000 -1 -1 2.5 x 1\n";
+        }
+        CHECK(kerrp2p(fmt::format("ray -o {} {}", output, input)) != 0);
+        CHECK(read_file(errors).find(input + ":13: cannot parse \"x\"") != std::string::npos);
+        CHECK(kerrp2p("ray --format text") != 0);
+        CHECK(kerrp2p(fmt::format("ray -o {} {}", output, (directory / "missing.txt").string())) != 0);
+    }
+
+    boost::filesystem::remove_all(directory);
+}
+#endif
+#endif
+
 //TEMPLATE_TEST_CASE("Find Root Function", "[root]", TEST_TYPES) {
 //  using Real = std::tuple_element_t<0u, TestType>;
 //  using Complex = std::tuple_element_t<1u, TestType>;
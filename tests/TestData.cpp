@@ -4,33 +4,24 @@
 
 #include <boost/filesystem.hpp>
 
-void read_csv(std::vector<std::array<std::string, 9>> &data, const boost::filesystem::path &file_path) {
-    std::ifstream ifs(file_path.string());
-    if (!ifs.is_open()) {
+// data_path is a reference data file, a directory with reference.bin, or a directory with the csv files
+void get_test_data(std::string &data_path) {
+    using namespace boost::filesystem;
+
+    path dir(data_path);
+    if (is_regular_file(dir)) {
+        TEST_DATA.open(data_path);
         return;
     }
-    std::string line;
-    std::array<std::string, 9> row;
-    while (std::getline(ifs, line)) {
-        std::stringstream ss(line);
-        std::string cell;
-        int i = 0;
-        while (std::getline(ss, cell, ',')) {
-            row[i++] = cell;
-        }
-        data.emplace_back(row);
-    }
-}
 
-void get_test_data(std::string &path) {
-    using namespace boost::filesystem;
+    if (!is_directory(dir) || !exists(dir)) {
+        return;
+    }
 
-    if (!is_directory(path) || !exists(path)) {
+    if (is_regular_file(dir / "reference.bin")) {
+        TEST_DATA.open((dir / "reference.bin").string());
         return;
     }
 
-    read_csv(TEST_DATA_PP, path / "pp.csv");
-    read_csv(TEST_DATA_PM, path / "pm.csv");
-    read_csv(TEST_DATA_MP, path / "mp.csv");
-    read_csv(TEST_DATA_MM, path / "mm.csv");
+    TEST_DATA.load_csv_directory(data_path);
 }
@@ -0,0 +1,178 @@
+# Tests of the Python module, run with the built pykerrp2p on the path:
+#   PYTHONPATH=<build directory> python -m pytest tests/test_pybind.py
+import math
+
+import numpy as np
+import pytest
+
+kp = pytest.importorskip("pykerrp2p")
+
+A = 0.8
+R_S = 10.0
+THETA_S = 85 * math.pi / 180
+R_O = 1000.0
+
+
+def to_sign(value):
+    return kp.Sign.POSITIVE if value > 0 else kp.Sign.NEGATIVE
+
+
+def batch_results(arguments, from_rc_d, calc_t_f):
+    """calc_ray_batch on the broadcast arguments, as the fields of calc_ray_*_array"""
+    arrays = np.broadcast_arrays(*[np.asarray(argument, dtype=np.float64) for argument in arguments])
+    params_list = []
+    for values in zip(*[array.ravel() for array in arrays]):
+        params = kp.ForwardRayTracingParams()
+        params.a, params.r_s, params.theta_s, params.r_o = (float(value) for value in values[:4])
+        params.nu_r = to_sign(values[4])
+        params.nu_theta = to_sign(values[5])
+        params.calc_t_f = calc_t_f
+        params.print_args_error = False
+        if from_rc_d:
+            params.rc = float(values[6])
+            params.log_abs_d = float(values[7])
+            params.d_sign = to_sign(values[8])
+            params.rc_d_to_lambda_q()
+        else:
+            params.lam = float(values[6])
+            params.q = float(values[7])
+        params_list.append(params)
+
+    results = kp.calc_ray_batch(params_list)
+    shape = arrays[0].shape
+    fields = {
+        "theta_f": np.array([result.theta_f for result in results], dtype=np.float64),
+        "phi_f": np.array([result.phi_f for result in results], dtype=np.float64),
+        "t_f": np.array([result.t_f for result in results], dtype=np.float64),
+        "n_half": np.array([result.n_half for result in results], dtype=np.float64),
+        "m": np.array([result.m for result in results], dtype=np.int32),
+        "status": np.array([int(result.ray_status) for result in results], dtype=np.uint8),
+    }
+    return {name: values.reshape(shape) for name, values in fields.items()}
+
+
+def check_same_fields(arrays, reference):
+    assert set(arrays) == set(reference)
+    for name, values in reference.items():
+        assert arrays[name].shape == values.shape, name
+        assert arrays[name].dtype == values.dtype, name
+        # NaN where a ray has no result, at the same places
+        np.testing.assert_array_equal(arrays[name], values, err_msg=name)
+
+
+RC_DOWN, RC_UP = kp.KerrBackground(A).rc_down, kp.KerrBackground(A).rc_up
+RC = np.linspace(RC_DOWN + 0.05, RC_UP - 0.05, 7)
+LOG_ABS_D = np.linspace(-4, 1, 5)
+
+RC_D_CASES = {
+    "scalar": (A, R_S, THETA_S, R_O, -1, -1, RC[3], LOG_ABS_D[2], 1),
+    "1d": (A, R_S, THETA_S, R_O, -1, 1, RC, -1.5, np.where(np.arange(RC.size) % 2 == 0, 1.0, -1.0)),
+    "2d": (A, R_S, THETA_S, R_O, -1, -1, RC[None, :], LOG_ABS_D[:, None], 1),
+    # runs of spins within one chunk, each needs its own background
+    "spins": (np.array([0.5, 0.8, 0.8, 0.3, 0.3, 0.8, 0.5]), R_S, THETA_S, R_O, -1, -1, RC, -1.5, 1),
+}
+
+
+@pytest.mark.parametrize("case", sorted(RC_D_CASES))
+@pytest.mark.parametrize("calc_t_f", [False, True])
+def test_calc_ray_rc_d_array_matches_batch(case, calc_t_f):
+    arguments = RC_D_CASES[case]
+    arrays = kp.calc_ray_rc_d_array(*arguments, calc_t_f=calc_t_f)
+    check_same_fields(arrays, batch_results(arguments, True, calc_t_f))
+
+
+@pytest.mark.parametrize("case", ["scalar", "1d", "2d"])
+def test_calc_ray_lambda_q_array_matches_batch(case):
+    lam = np.linspace(-5, 5, 6)
+    q = np.linspace(1, 40, 4)
+    arguments = {
+        "scalar": (A, R_S, THETA_S, R_O, 1, -1, lam[2], q[1]),
+        "1d": (A, R_S, THETA_S, R_O, 1, -1, lam, q[2]),
+        "2d": (A, R_S, THETA_S, R_O, 1, -1, lam[None, :], q[:, None]),
+    }[case]
+    arrays = kp.calc_ray_lambda_q_array(*arguments, calc_t_f=True)
+    check_same_fields(arrays, batch_results(arguments, False, True))
+
+
+# Values of the precisions without a numpy dtype, as the float64 parts of their expansions. Zeros, infinities and NaN
+# have no lower parts, and the tails of the last cases are subnormal.
+EXPANSION_CASES = [
+    [0.0], [-0.0], [math.inf], [-math.inf], [math.nan],
+    [1.0], [-3.5], [1.0, 2.0 ** -60], [-1.0, 2.0 ** -60], [1.0, -2.0 ** -70],
+    [math.pi, 1.2246467991473532e-16, -2.9947698097183397e-33, 1.1124542208633653e-49, 5.67187223737787e-66],
+    [1 / 3, 1 / 3 * 2.0 ** -54, 1 / 3 * 2.0 ** -108, 1 / 3 * 2.0 ** -162, 1 / 3 * 2.0 ** -216],
+    [2.0 ** -1000, 2.0 ** -1074], [-2.0 ** -1000, 2.0 ** -1074], [2.0 ** -990, -2.0 ** -1074], [2.0 ** -1060],
+]
+
+PRECISIONS = {"DoubleDouble": 2, "Float128": 3, "Float256": 5}
+
+
+def assert_same_bits(x, y):
+    x = np.asarray(x, dtype=np.float64)
+    y = np.asarray(y, dtype=np.float64)
+    assert x.shape == y.shape
+    nan = np.isnan(x)
+    np.testing.assert_array_equal(nan, np.isnan(y))
+    np.testing.assert_array_equal(x[~nan].view(np.uint64), y[~nan].view(np.uint64))
+
+
+def canonical_expansion(precision):
+    """the cases as values of precision and their expansions as to_expansion writes them"""
+    limbs = PRECISIONS[precision]
+    parts = np.zeros((len(EXPANSION_CASES), limbs))
+    for k, case in enumerate(EXPANSION_CASES):
+        parts[k, :min(limbs, len(case))] = case[:limbs]
+    values = getattr(kp, "from_expansion_" + precision)(parts)
+    return values, getattr(kp, "to_expansion_" + precision)(values)
+
+
+@pytest.mark.parametrize("precision", sorted(PRECISIONS))
+def test_expansion_round_trip(precision):
+    values, expansion = canonical_expansion(precision)
+    assert expansion.shape == (len(EXPANSION_CASES), PRECISIONS[precision])
+    assert_same_bits(expansion[:, 0], [case[0] for case in EXPANSION_CASES])
+    back = getattr(kp, "from_expansion_" + precision)(expansion)
+    assert_same_bits(getattr(kp, "to_expansion_" + precision)(back), expansion)
+    assert_same_bits(getattr(kp, "to_float64_" + precision)(values), expansion[:, 0])
+
+
+@pytest.mark.parametrize("precision", sorted(PRECISIONS))
+def test_mpmath_round_trip(precision):
+    mpmath = pytest.importorskip("mpmath")
+    to_expansion = getattr(kp, "to_expansion_" + precision)
+    from_mpmath = getattr(kp, "from_mpmath_" + precision)
+    values, expansion = canonical_expansion(precision)
+    pairs = getattr(kp, "to_mpmath_" + precision)(values)
+
+    # the pairs are exact, -0 and the values without a pair stay floats
+    assert_same_bits(to_expansion(from_mpmath(pairs)), expansion)
+    with mpmath.workprec(1200):
+        mpfs = [mpmath.mpf(pair) for pair in pairs]
+        for mpf, parts in zip(mpfs, expansion):
+            if np.isfinite(parts[0]):
+                assert mpf == mpmath.fsum(mpmath.mpf(float(part)) for part in parts)
+        # mpmath has no -0
+        expected = expansion.copy()
+        expected[np.signbit(expected[:, 0]) & (expected[:, 0] == 0)] = 0.0
+        assert_same_bits(to_expansion(from_mpmath(mpfs)), expected)
+
+    # exponents beyond double round to inf or to zero, however large
+    far = [(1, 5000), (-1, 5000), (1, -5000), (-1, -5000), (3, 10 ** 30), (-3, -10 ** 30), (0, 10 ** 30),
+           mpmath.mpf(2) ** 5000, -mpmath.mpf(2) ** 5000, mpmath.mpf(2) ** -5000, -mpmath.mpf(2) ** -5000]
+    assert_same_bits(to_expansion(from_mpmath(far))[:, 0],
+                     [math.inf, -math.inf, 0.0, -0.0, math.inf, -0.0, 0.0, math.inf, -math.inf, 0.0, -0.0])
+    # below the normal range the parts keep only the bits a subnormal has
+    assert_same_bits(to_expansion(from_mpmath([(3, -1076), ((1 << 60) + 1, -1130)]))[:, 0],
+                     [2.0 ** -1074, 2.0 ** -1070])
+
+
+def test_binary128_round_trip():
+    if not hasattr(kp, "to_binary128"):
+        pytest.skip("built without FLOAT128_NATIVE")
+    values, expansion = canonical_expansion("Float128")
+    binary = kp.to_binary128(values)
+    assert binary.dtype.itemsize == 16 and binary.shape == (len(EXPANSION_CASES),)
+    # 1.0 is the biased exponent 0x3fff and an empty fraction, little-endian
+    one = kp.to_binary128(kp.from_expansion_Float128(np.array([[1.0, 0.0, 0.0]])))
+    assert one.tobytes() == bytes(14) + b"\xff\x3f"
+    assert_same_bits(kp.to_expansion_Float128(kp.from_binary128(binary)), expansion)